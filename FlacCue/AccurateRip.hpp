@@ -245,6 +245,31 @@ static std::string calculateARDataURL(const TableOfContents& toc) {
 class ChecksumGenerator {
     using Checksums = std::vector<TrackCRC>;
     
+    // Sample accessors: the checksums work on a stereo sample packed as right << 16 | left.
+    struct PlanarSamples {
+        int32_t const * const * buffer;
+        
+        uint32_t operator()(uint32_t i) const {
+            return ((uint16_t)buffer[1][i] << 16) | (uint16_t)buffer[0][i];
+        }
+    };
+    
+    // Interleaved 16-bit stereo, as CD audio is laid out in WAV files and raw images.
+    // Little-endian data is the packed sample itself.
+    template<bool IsBigEndian>
+    struct InterleavedSamples {
+        const uint8_t* data;
+        
+        uint32_t operator()(uint32_t i) const {
+            auto sample = data + 4 * (size_t)i;
+            if (IsBigEndian) {
+                return (uint32_t)sample[1] | (uint32_t)sample[0] << 8 | (uint32_t)sample[3] << 16 | (uint32_t)sample[2] << 24;
+            } else {
+                return (uint32_t)sample[0] | (uint32_t)sample[1] << 8 | (uint32_t)sample[2] << 16 | (uint32_t)sample[3] << 24;
+            }
+        }
+    };
+    
     const TableOfContents _toc;
     
     class V1ChecksumGenerator {
@@ -293,10 +318,11 @@ class ChecksumGenerator {
             return _checksums[track].at(offset - _minimumOffset);
         }
         
-        void processSamples(int32_t const * const buffer[2], uint32_t count) {
+        template<typename Samples>
+        void processSamples(const Samples& sampleAt, uint32_t count) {
         
             for (auto i = 0; i < count; ++i) {
-                uint32_t samples = (((uint16_t)buffer[1][i] << 16) | (uint16_t)buffer[0][i]);
+                uint32_t samples = sampleAt(i);
                 
                 auto numberOfTracks = _checksums.size();
                 
@@ -370,11 +396,12 @@ class ChecksumGenerator {
             return _checksums[track];
         }
         
-        void processSamples(int32_t const * const buffer[2], uint32_t count) {
+        template<typename Samples>
+        void processSamples(const Samples& sampleAt, uint32_t count) {
             
             for (auto i = 0; i < count; ++i) {
                 if (_sampleIndex >= _firstSampleIndexes[_track] && _sampleIndex <= _lastSampleIndexes[_track]) {
-                    uint32_t samples = (((uint16_t)buffer[1][i] << 16) | (uint16_t)buffer[0][i]);
+                    uint32_t samples = sampleAt(i);
                     uint32_t multiplier = _firstSampleMultipliers[_track] + _sampleIndex - _firstSampleIndexes[_track];
                     _checksums[_track] += fold((uint64_t)multiplier * (uint64_t)samples);
                 }
@@ -464,6 +491,18 @@ class ChecksumGenerator {
         return calculateFirstSampleMultipliersForV1Checksum(toc);
     }
     
+    template<typename Samples>
+    void processPackedSamples(const Samples& sampleAt, uint32_t count) {
+        _samplesProcessed += count;
+        if (_samplesProcessed > _toc.totalLength().samples) {
+            throw std::runtime_error("Received more samples (" + std::to_string(_samplesProcessed) + ") "
+                                     "than the TOC indicated (" + std::to_string(_toc.totalLength().samples) + ")");
+        }
+        _v1ChecksumGenerator.processSamples(sampleAt, count);
+        _v1Frame450ChecksumGenerator.processSamples(sampleAt, count);
+        _v2ChecksumGenerator.processSamples(sampleAt, count);
+    }
+    
     void ensureDone() const {
         if (_samplesProcessed != _toc.totalLength().samples) {
             throw std::runtime_error("Received samples (" + std::to_string(_samplesProcessed) + ") "
@@ -528,14 +567,16 @@ public:
     }
     
     void processSamples(int32_t const * const buffer[2], uint32_t count) {
-        _samplesProcessed += count;
-        if (_samplesProcessed > _toc.totalLength().samples) {
-            throw std::runtime_error("Received more samples (" + std::to_string(_samplesProcessed) + ") "
-                                     "than the TOC indicated (" + std::to_string(_toc.totalLength().samples) + ")");
+        processPackedSamples(PlanarSamples { buffer }, count);
+    }
+    
+    // `count` samples of interleaved 16-bit stereo, e.g. straight from a mapped WAV file.
+    void processInterleavedSamples(const uint8_t* data, uint32_t count, bool isBigEndian = false) {
+        if (isBigEndian) {
+            processPackedSamples(InterleavedSamples<true> { data }, count);
+        } else {
+            processPackedSamples(InterleavedSamples<false> { data }, count);
         }
-        _v1ChecksumGenerator.processSamples(buffer, count);
-        _v1Frame450ChecksumGenerator.processSamples(buffer, count);
-        _v2ChecksumGenerator.processSamples(buffer, count);
     }
 };
     
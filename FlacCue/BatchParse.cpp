@@ -0,0 +1,89 @@
+//
+//  BatchParse.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "BatchParse.hpp"
+
+#include <fstream>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <boost/algorithm/string.hpp>
+
+namespace cue {
+
+bool BatchParser::isCueSheet(const std::string& fileName) {
+    return boost::iends_with(fileName, ".cue");
+}
+
+void BatchParser::report(const std::string& path, std::shared_ptr<Disc> disc, std::exception_ptr error, const ResultHandler& handler) {
+    std::lock_guard<std::mutex> lock(_handlerMutex);
+    handler(path, disc, error);
+}
+
+void BatchParser::parseFile(const std::string& path, const ResultHandler& handler) {
+    std::shared_ptr<Disc> disc;
+    std::exception_ptr error;
+    try {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::runtime_error("Failed to open '" + path + "'");
+        }
+        disc = std::make_shared<Disc>(input);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    report(path, disc, error, handler);
+}
+
+void BatchParser::walkDirectory(flaccue::TaskGroup& tasks, const std::string& path, const ResultHandler& handler) {
+    auto dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        auto error = std::make_exception_ptr(std::runtime_error("Failed to open directory '" + path + "': " + strerror(errno)));
+        report(path, nullptr, error, handler);
+        return;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+
+        std::string entryPath = path + "/" + ent->d_name;
+        auto type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat entryStat;
+            if (lstat(entryPath.c_str(), &entryStat) != 0) {
+                continue;
+            }
+            type = S_ISDIR(entryStat.st_mode) ? DT_DIR : (S_ISREG(entryStat.st_mode) ? DT_REG : DT_UNKNOWN);
+        }
+
+        if (type == DT_DIR) {
+            tasks.run([this, &tasks, entryPath, &handler]() {
+                walkDirectory(tasks, entryPath, handler);
+            });
+        } else if (type == DT_REG && isCueSheet(ent->d_name)) {
+            tasks.run([this, entryPath, &handler]() {
+                parseFile(entryPath, handler);
+            });
+        }
+    }
+    closedir(dir);
+}
+
+void BatchParser::parseTree(const std::string& root, const ResultHandler& handler) {
+    flaccue::TaskGroup tasks(_pool);
+    tasks.run([this, &tasks, root, &handler]() {
+        walkDirectory(tasks, root, handler);
+    });
+    tasks.wait();
+}
+
+}
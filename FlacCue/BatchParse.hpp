@@ -0,0 +1,50 @@
+//
+//  BatchParse.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef BatchParse_h
+#define BatchParse_h
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "CueParse.hpp"
+#include "ThreadPool.hpp"
+
+namespace cue {
+
+// Finds every cue sheet below a root directory and parses them on a thread pool.
+// Directories are walked in parallel as well; symbolic links are not followed.
+class BatchParser {
+public:
+    // Exactly one of `disc` and `error` is set. Calls are serialized, but come from
+    // arbitrary worker threads in no particular order.
+    using ResultHandler = std::function<void(const std::string& path, std::shared_ptr<Disc> disc, std::exception_ptr error)>;
+
+private:
+    flaccue::ThreadPool& _pool;
+    std::mutex _handlerMutex;
+
+    void walkDirectory(flaccue::TaskGroup& tasks, const std::string& path, const ResultHandler& handler);
+    void parseFile(const std::string& path, const ResultHandler& handler);
+    void report(const std::string& path, std::shared_ptr<Disc> disc, std::exception_ptr error, const ResultHandler& handler);
+
+public:
+    explicit BatchParser(flaccue::ThreadPool& pool) : _pool(pool) {}
+
+    // Blocks until the whole tree has been processed.
+    void parseTree(const std::string& root, const ResultHandler& handler);
+
+    static bool isCueSheet(const std::string& fileName);
+};
+
+}
+
+#endif /* BatchParse_h */
@@ -0,0 +1,302 @@
+//
+//  CompactDisc.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "CompactDisc.hpp"
+
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace cue {
+
+// CompactDisc stores numbers and counts as narrow as real discs allow. Anything wider is
+// rejected: wrapped around, it would silently describe a different disc.
+template<typename T> static T checkedNumber(int number, const char* command) {
+    if (number < 0 || number > std::numeric_limits<T>::max()) {
+        throw ParseError(std::string(command) + " number out of range: " + std::to_string(number));
+    }
+    return (T)number;
+}
+
+template<typename T> static T checkedCount(size_t count, const char* what) {
+    if (count > std::numeric_limits<T>::max()) {
+        throw std::length_error(std::string("Too many ") + what + ": " + std::to_string(count));
+    }
+    return (T)count;
+}
+
+template<typename T> static void increment(T& count, const char* what) {
+    count = checkedCount<T>((size_t)count + 1, what);
+}
+
+class CompactDiscBuilder : public ParseVisitor {
+    CompactDisc& _disc;
+    std::unordered_multimap<size_t, CompactDisc::String> _interned;
+
+    CompactDisc::Track& currentTrack(const char* command) {
+        if (_disc._tracks.empty()) {
+            throw ParseError(std::string(command) + " must be used within a TRACK!");
+        }
+        return _disc._tracks.back();
+    }
+
+public:
+    CompactDiscBuilder(CompactDisc& disc) : _disc(disc) {}
+
+    CompactDisc::String intern(std::string_view string) {
+        auto hash = std::hash<std::string_view>()(string);
+        auto candidates = _interned.equal_range(hash);
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+            if (_disc.string(candidate->second) == string) {
+                return candidate->second;
+            }
+        }
+
+        // The last offset means no string at all.
+        if (_disc._strings.size() + string.size() >= CompactDisc::String::None) {
+            throw std::length_error("Too much text in the cue sheet");
+        }
+        CompactDisc::String result;
+        result.offset = (uint32_t)_disc._strings.size();
+        result.length = (uint32_t)string.size();
+        _disc._strings.append(string.data(), string.size());
+        _interned.emplace(hash, result);
+        return result;
+    }
+
+    CompactDisc::String intern(const std::optional<std::string>& string) {
+        return string ? intern(std::string_view(*string)) : CompactDisc::String();
+    }
+
+    uint32_t addComments(const std::vector<std::string>& comments) {
+        checkedCount<uint32_t>(_disc._comments.size() + comments.size(), "comments");
+        auto first = (uint32_t)_disc._comments.size();
+        for (auto& comment : comments) {
+            _disc._comments.push_back(intern(std::string_view(comment)));
+        }
+        return first;
+    }
+
+    void build(const Disc& disc) {
+        _disc._numberOfDiscComments = checkedCount<uint32_t>(disc.comments.size(), "disc comments");
+        addComments(disc.comments);
+        _disc._catalog = intern(disc.catalog);
+        _disc._cdTextFile = intern(disc.cdTextFile);
+        _disc._performer = intern(disc.performer);
+        _disc._title = intern(disc.title);
+        _disc._songwriter = intern(disc.songwriter);
+
+        // Indexes refer to their files by a 16-bit number.
+        checkedCount<uint16_t>(disc.filesCend() - disc.filesCbegin(), "files");
+        _disc._files.reserve(disc.filesCend() - disc.filesCbegin());
+        for (auto file = disc.filesCbegin(); file != disc.filesCend(); ++file) {
+            _disc._files.push_back({ intern(std::string_view(file->path)), intern(std::string_view(file->fileType)) });
+        }
+
+        _disc._tracks.reserve(disc.tracksCend() - disc.tracksCbegin());
+        for (auto track = disc.tracksCbegin(); track != disc.tracksCend(); ++track) {
+            CompactDisc::Track compactTrack;
+            compactTrack.dataType = intern(std::string_view(track->dataType));
+            compactTrack.performer = intern(track->performer);
+            compactTrack.title = intern(track->title);
+            compactTrack.songwriter = intern(track->songwriter);
+            compactTrack.isrc = intern(track->isrc);
+            compactTrack.flags = intern(track->flags);
+            compactTrack.pregap = track->pregap ? track->pregap->samples : -1;
+            compactTrack.postgap = track->postgap ? track->postgap->samples : -1;
+            compactTrack.number = checkedNumber<uint8_t>(track->number, "TRACK");
+            compactTrack.numberOfComments = checkedCount<uint16_t>(track->comments.size(), "comments in a track");
+            compactTrack.firstComment = addComments(track->comments);
+            compactTrack.numberOfIndexes = checkedCount<uint16_t>(track->indexesCend() - track->indexesCbegin(), "indexes in a track");
+            checkedCount<uint32_t>(_disc._indexes.size() + compactTrack.numberOfIndexes, "indexes");
+            compactTrack.firstIndex = (uint32_t)_disc._indexes.size();
+
+            for (auto index = track->indexesCbegin(); index != track->indexesCend(); ++index) {
+                CompactDisc::Index compactIndex;
+                compactIndex.begin = index->begin;
+                compactIndex.index = checkedNumber<uint8_t>(index->index, "INDEX");
+                compactIndex.file = (uint16_t)(&index->file() - &*disc.filesCbegin());
+                compactIndex.numberOfComments = checkedCount<uint16_t>(index->comments.size(), "comments in an index");
+                compactIndex.firstComment = addComments(index->comments);
+                _disc._indexes.push_back(compactIndex);
+            }
+
+            _disc._tracks.push_back(compactTrack);
+        }
+
+        finish();
+    }
+
+    void finish() {
+        _disc._strings.shrink_to_fit();
+        _disc._comments.shrink_to_fit();
+        _disc._files.shrink_to_fit();
+        _disc._indexes.shrink_to_fit();
+        _disc._tracks.shrink_to_fit();
+    }
+
+    virtual void onCatalog(std::string_view catalog) override {
+        _disc._catalog = intern(catalog);
+    }
+
+    virtual void onCdTextFile(std::string_view cdTextFile) override {
+        _disc._cdTextFile = intern(cdTextFile);
+    }
+
+    virtual void onFile(std::string_view path, std::string_view fileType) override {
+        checkedCount<uint16_t>(_disc._files.size() + 1, "files");
+        _disc._files.push_back({ intern(path), intern(fileType) });
+    }
+
+    virtual void onFlags(std::string_view flags) override {
+        currentTrack("FLAGS").flags = intern(flags);
+    }
+
+    virtual void onIndex(int indexNumber, Time begin) override {
+        if (_disc._files.empty()) {
+            throw ParseError("INDEX can only be used after specifying a FILE!");
+        }
+        CompactDisc::Index index;
+        index.begin = begin;
+        index.index = checkedNumber<uint8_t>(indexNumber, "INDEX");
+        index.file = (uint16_t)(_disc._files.size() - 1);
+        index.firstComment = checkedCount<uint32_t>(_disc._comments.size(), "comments");
+        checkedCount<uint32_t>(_disc._indexes.size() + 1, "indexes");
+        increment(currentTrack("INDEX").numberOfIndexes, "indexes in a track");
+        index.numberOfComments = 0;
+        _disc._indexes.push_back(index);
+    }
+
+    virtual void onIsrc(std::string_view isrc) override {
+        currentTrack("ISRC").isrc = intern(isrc);
+    }
+
+    virtual void onPerformer(std::string_view performer) override {
+        (_disc._tracks.empty() ? _disc._performer : _disc._tracks.back().performer) = intern(performer);
+    }
+
+    virtual void onPostgap(Time postgap) override {
+        currentTrack("POSTGAP").postgap = postgap.samples;
+    }
+
+    virtual void onPregap(Time pregap) override {
+        currentTrack("PREGAP").pregap = pregap.samples;
+    }
+
+    virtual void onRem(std::string_view comment) override {
+        checkedCount<uint32_t>(_disc._comments.size() + 1, "comments");
+        if (_disc._tracks.empty()) {
+            increment(_disc._numberOfDiscComments, "disc comments");
+        } else if (_disc._tracks.back().numberOfIndexes == 0) {
+            increment(_disc._tracks.back().numberOfComments, "comments in a track");
+        } else {
+            increment(_disc._indexes.back().numberOfComments, "comments in an index");
+        }
+        _disc._comments.push_back(intern(comment));
+    }
+
+    virtual void onSongwriter(std::string_view songwriter) override {
+        (_disc._tracks.empty() ? _disc._songwriter : _disc._tracks.back().songwriter) = intern(songwriter);
+    }
+
+    virtual void onTitle(std::string_view title) override {
+        (_disc._tracks.empty() ? _disc._title : _disc._tracks.back().title) = intern(title);
+    }
+
+    virtual void onTrack(int number, std::string_view dataType) override {
+        CompactDisc::Track track;
+        track.dataType = intern(dataType);
+        track.pregap = -1;
+        track.postgap = -1;
+        track.number = checkedNumber<uint8_t>(number, "TRACK");
+        track.firstIndex = checkedCount<uint32_t>(_disc._indexes.size(), "indexes");
+        track.numberOfIndexes = 0;
+        track.firstComment = checkedCount<uint32_t>(_disc._comments.size(), "comments");
+        track.numberOfComments = 0;
+        _disc._tracks.push_back(track);
+    }
+};
+
+CompactDisc::CompactDisc(const Disc& disc) {
+    CompactDiscBuilder(*this).build(disc);
+}
+
+CompactDisc::CompactDisc(std::istream& input) noexcept(false) {
+    CompactDiscBuilder builder(*this);
+    parse(input, builder);
+    builder.finish();
+}
+
+size_t CompactDisc::memoryUsage() const {
+    return sizeof(*this) +
+    _strings.capacity() +
+    _comments.capacity() * sizeof(String) +
+    _files.capacity() * sizeof(File) +
+    _indexes.capacity() * sizeof(Index) +
+    _tracks.capacity() * sizeof(Track);
+}
+
+static std::optional<std::string> toOptionalString(const std::optional<std::string_view>& string) {
+    if (string) {
+        return std::string(*string);
+    } else {
+        return std::nullopt;
+    }
+}
+
+std::shared_ptr<Disc> CompactDisc::toDisc() const {
+    auto disc = std::make_shared<Disc>();
+    for (auto& comment : comments()) {
+        disc->comments.push_back(std::string(string(comment)));
+    }
+    disc->catalog = toOptionalString(catalog());
+    disc->cdTextFile = toOptionalString(cdTextFile());
+    disc->performer = toOptionalString(performer());
+    disc->title = toOptionalString(title());
+    disc->songwriter = toOptionalString(songwriter());
+
+    for (auto& file : files()) {
+        auto& discFile = disc->addFile();
+        discFile.path = string(file.path);
+        discFile.fileType = string(file.fileType);
+    }
+
+    for (auto& track : tracks()) {
+        auto& discTrack = disc->addTrack();
+        discTrack.dataType = string(track.dataType);
+        discTrack.number = track.number;
+        discTrack.performer = toOptionalString(optionalString(track.performer));
+        discTrack.title = toOptionalString(optionalString(track.title));
+        discTrack.songwriter = toOptionalString(optionalString(track.songwriter));
+        discTrack.isrc = toOptionalString(optionalString(track.isrc));
+        discTrack.flags = toOptionalString(optionalString(track.flags));
+        if (track.pregap >= 0) {
+            discTrack.pregap = Time(track.pregap);
+        }
+        if (track.postgap >= 0) {
+            discTrack.postgap = Time(track.postgap);
+        }
+        for (auto& comment : comments(track)) {
+            discTrack.comments.push_back(std::string(string(comment)));
+        }
+        for (auto& index : indexes(track)) {
+            auto& discIndex = discTrack.addIndex();
+            discIndex.begin = index.begin;
+            discIndex.index = index.index;
+            discIndex.setFile(*(disc->filesBegin() + index.file));
+            for (auto& comment : comments(index)) {
+                discIndex.comments.push_back(std::string(string(comment)));
+            }
+        }
+    }
+
+    return disc;
+}
+
+}
@@ -0,0 +1,145 @@
+//
+//  CompactDisc.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef CompactDisc_h
+#define CompactDisc_h
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CueParse.hpp"
+
+namespace cue {
+
+// Read-only, memory-lean counterpart of Disc for keeping many parsed sheets resident.
+// All strings of a disc live in one deduplicated pool; tracks, indexes and files
+// refer to them (and to each other) by small offsets instead of owning heap objects.
+class CompactDisc {
+public:
+    struct String {
+        static constexpr uint32_t None = UINT32_MAX;
+        uint32_t offset = None;
+        uint32_t length = 0;
+
+        bool hasValue() const { return offset != None; }
+    };
+
+    template<typename T> class Range {
+        const T* _begin;
+        const T* _end;
+    public:
+        Range(const T* begin, const T* end) : _begin(begin), _end(end) {}
+        const T* begin() const { return _begin; }
+        const T* end() const { return _end; }
+        size_t size() const { return _end - _begin; }
+        bool empty() const { return _begin == _end; }
+        const T& operator[](size_t i) const { return _begin[i]; }
+    };
+
+    struct File {
+        String path;
+        String fileType;
+    };
+
+    struct Index {
+        Time begin;
+        uint32_t firstComment;
+        uint16_t numberOfComments;
+        uint16_t file;
+        uint8_t index;
+    };
+
+    struct Track {
+        String dataType;
+        String performer;
+        String title;
+        String songwriter;
+        String isrc;
+        String flags;
+        int64_t pregap; // in samples, -1 if absent
+        int64_t postgap; // in samples, -1 if absent
+        uint32_t firstIndex;
+        uint32_t firstComment;
+        uint16_t numberOfIndexes;
+        uint16_t numberOfComments;
+        uint8_t number;
+    };
+
+private:
+    std::string _strings;
+    std::vector<String> _comments;
+    std::vector<File> _files;
+    std::vector<Index> _indexes;
+    std::vector<Track> _tracks;
+    uint32_t _numberOfDiscComments = 0;
+    String _catalog;
+    String _cdTextFile;
+    String _performer;
+    String _title;
+    String _songwriter;
+
+    friend class CompactDiscBuilder;
+    friend class SnapshotCodec;
+
+public:
+    CompactDisc() = default;
+    explicit CompactDisc(const Disc& disc);
+    explicit CompactDisc(std::istream& input) noexcept(false);
+
+    std::string_view string(const String& string) const {
+        return string.hasValue() ? std::string_view(_strings.data() + string.offset, string.length) : std::string_view();
+    }
+
+    std::optional<std::string_view> optionalString(const String& string) const {
+        if (string.hasValue()) {
+            return this->string(string);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    Range<String> comments() const { return { _comments.data(), _comments.data() + _numberOfDiscComments }; }
+    std::optional<std::string_view> catalog() const { return optionalString(_catalog); }
+    std::optional<std::string_view> cdTextFile() const { return optionalString(_cdTextFile); }
+    std::optional<std::string_view> performer() const { return optionalString(_performer); }
+    std::optional<std::string_view> title() const { return optionalString(_title); }
+    std::optional<std::string_view> songwriter() const { return optionalString(_songwriter); }
+
+    Range<File> files() const { return { _files.data(), _files.data() + _files.size() }; }
+    Range<Track> tracks() const { return { _tracks.data(), _tracks.data() + _tracks.size() }; }
+
+    Range<Index> indexes(const Track& track) const {
+        auto first = _indexes.data() + track.firstIndex;
+        return { first, first + track.numberOfIndexes };
+    }
+
+    Range<String> comments(const Track& track) const {
+        auto first = _comments.data() + track.firstComment;
+        return { first, first + track.numberOfComments };
+    }
+
+    Range<String> comments(const Index& index) const {
+        auto first = _comments.data() + index.firstComment;
+        return { first, first + index.numberOfComments };
+    }
+
+    const File& file(const Index& index) const { return _files[index.file]; }
+
+    // Approximate number of heap bytes owned by this disc.
+    size_t memoryUsage() const;
+
+    std::shared_ptr<Disc> toDisc() const;
+};
+
+}
+
+#endif /* CompactDisc_h */
@@ -7,20 +7,27 @@
 //
 
 #include "CueParse.hpp"
+#include "Timeline.hpp"
 
+#include <algorithm>
 #include <sstream>
+#include <exception>
 #include <iomanip>
+#include <charconv>
+#include <system_error>
 #include <math.h>
-#include <boost/format.hpp>
-#include <boost/algorithm/string.hpp>
+#include <errno.h>
+#include <unistd.h>
 
 extern "C" {
     #include "cue.h"
     #include "cue.tab.h"
         
+    #define YY_DECL int cue_lex(CUE_STYPE* yylval_param, CUE_LTYPE* llocp, yyscan_t yyscanner)
     #define YYSTYPE CUE_STYPE
     #define YYLTYPE CUE_LTYPE
     #include "cue.lex.h"
+    extern YY_DECL;
 }
 
 namespace cue {
@@ -70,147 +77,285 @@ void Index::setFile(const File& file) {
     _file = static_cast<int>(&file - &(*_disc->filesBegin()));
 }
     
-Disc::Disc(std::istream& input) noexcept(false) {
+struct CueParserCommandCallbackContext {
+    ParseVisitor& visitor;
+    std::exception_ptr error;
+};
+    
+static void dispatchCommand(ParseVisitor& visitor, const CueCommand& command) {
+    switch (command.type) {
+        case CueCommandTypeCatalog: visitor.onCatalog(command.catalog); break;
+        case CueCommandTypeCdTextFile: visitor.onCdTextFile(command.cdTextFile); break;
+        case CueCommandTypeFile: visitor.onFile(command.file.path, command.file.fileType); break;
+        case CueCommandTypeFlags: visitor.onFlags(command.flags); break;
+        case CueCommandTypeIndex: {
+            auto time = Time(command.index.time.minutes, command.index.time.seconds, command.index.time.frames);
+            visitor.onIndex(command.index.index, time);
+        } break;
+        case CueCommandTypeIsrc: visitor.onIsrc(command.isrc); break;
+        case CueCommandTypePerformer: visitor.onPerformer(command.performer); break;
+        case CueCommandTypePostgap: visitor.onPostgap(Time(command.postGap.minutes, command.postGap.seconds, command.postGap.frames)); break;
+        case CueCommandTypePregap: visitor.onPregap(Time(command.preGap.minutes, command.preGap.seconds, command.preGap.frames)); break;
+        case CueCommandTypeRem: visitor.onRem(command.rem); break;
+        case CueCommandTypeSongwriter: visitor.onSongwriter(command.songwriter); break;
+        case CueCommandTypeTitle: visitor.onTitle(command.title); break;
+        case CueCommandTypeTrack: visitor.onTrack(command.track.number, command.track.dataType); break;
+    }
+}
     
-    struct CueCommandList result;
-    CueCommandListInit(&result);
-    char* error;
-    int errorLine;
+static int CueParserCommandCallback(void * context, const CueCommand* command, int line) {
+    CueParserCommandCallbackContext* callbackContext = (CueParserCommandCallbackContext*)context;
+    try {
+        dispatchCommand(callbackContext->visitor, *command);
+        return 0;
+    } catch (const ParseError& e) {
+        callbackContext->error = std::make_exception_ptr(ParseError("Line " + std::to_string(line) + ": " + e.what()));
+    } catch (...) {
+        callbackContext->error = std::current_exception();
+    }
+    return 1;
+}
+    
+void parse(std::istream& input, ParseVisitor& visitor) noexcept(false) {
+    char* error = nullptr;
+    int errorLine = 0;
     
     struct CueParserExtra extra;
     CueParserReadCallbackContext context { input, false };
     extra.context  = &context;
     extra.readCallback = CueParserReadCallback;
     
+    CueParserCommandCallbackContext commandContext { visitor, nullptr };
+    struct CueParserCallbacks callbacks;
+    callbacks.context = &commandContext;
+    callbacks.commandCallback = CueParserCommandCallback;
+    
     yyscan_t scanner;
     cue_lex_init(&scanner);
     cue_set_extra(&extra, scanner);
-    auto status = cue_parse(scanner, &result, &error, &errorLine);
+    auto status = cue_parse(scanner, &callbacks, &error, &errorLine);
     cue_lex_destroy(scanner);
     
-    if (status == 0) {
-        CueCommandListItem* item = result.head;
-        
-        while (item != NULL) {
-            auto command = item->command;
-            switch (command.type) {
-                case CueCommandTypeCatalog: catalog = command.catalog; break;
-                case CueCommandTypeCdTextFile: cdTextFile = command.cdTextFile; break;
-                case CueCommandTypeFile: {
-                    auto& file = addFile();
-                    file.path = command.file.path;
-                    file.fileType = command.file.fileType;
-                } break;
-                case CueCommandTypeFlags: {
-                    if (tracksBegin() == tracksEnd()) {
-                        throw ParseError("FLAGS must be used within a TRACK!");
-                    }
-                    (tracksEnd() - 1)->flags = command.flags;
-                } break;
-                case CueCommandTypeIndex: {
-                    if (filesBegin() == filesEnd()) {
-                        throw ParseError("INDEX can only be used after specifying a FILE!");
-                    }
-                    auto time = Time(command.index.time.minutes, command.index.time.seconds, command.index.time.frames);
-                    
-                    auto& index = (tracksEnd() - 1)->addIndex();
-                    index.index = command.index.index;
-                    index.begin = time;
-                    index.setFile(*(filesEnd() - 1));
-                } break;
-                case CueCommandTypeIsrc: {
-                    if (tracksBegin() == tracksEnd()) {
-                        throw ParseError("ISRC must be used within a TRACK!");
-                    }
-                    (tracksEnd() - 1)->isrc = command.isrc;
-                } break;
-                case CueCommandTypePerformer:  {
-                    if (tracksBegin() == tracksEnd()) {
-                        performer = command.performer;
-                    } else {
-                        (tracksEnd() - 1)->performer = command.performer;
-                    }
-                } break;
-                case CueCommandTypePostgap: {
-                    if (tracksBegin() == tracksEnd()) {
-                        throw ParseError("POSTGAP must be used within a TRACK!");
-                    }
-                    (tracksEnd() - 1)->postgap = Time(command.postGap.minutes, command.postGap.seconds, command.postGap.frames);
-                } break;
-                case CueCommandTypePregap: {
-                    if (tracksBegin() == tracksEnd()) {
-                        throw ParseError("PREGAP must be used within a TRACK!");
-                    }
-                    (tracksEnd() - 1)->pregap = Time(command.preGap.minutes, command.preGap.seconds, command.preGap.frames);
-                } break;
-                case CueCommandTypeRem: {
-                    if (tracksBegin() == tracksEnd()) {
-                        comments.push_back(command.rem);
-                    } else {
-                        auto& lastTrack = *(tracksEnd() - 1);
-                        if (lastTrack.indexesBegin() == lastTrack.indexesEnd()) {
-                            lastTrack.comments.push_back(command.rem);
-                        } else {
-                            auto& lastIndex = *(lastTrack.indexesEnd() - 1);
-                            lastIndex.comments.push_back(command.rem);
-                        }
-                    }
-                } break;
-                case CueCommandTypeSongwriter: {
-                    if (tracksBegin() == tracksEnd()) {
-                        songwriter = command.songwriter;
-                    } else {
-                        (tracksEnd() - 1)->songwriter = command.songwriter;
-                    }
-                } break;
-                case CueCommandTypeTitle: {
-                    if (tracksBegin() == tracksEnd()) {
-                        title = command.title;
-                    } else {
-                        (tracksEnd() - 1)->title = command.title;
-                    }
-                } break;
-                case CueCommandTypeTrack: {
-                    auto& track = addTrack();
-                    track.number = command.track.number;
-                    track.dataType = command.track.dataType;
-                } break;
-            }
-            item = item->next;
-        }
-        CueCommandListDestroy(&result);
-    } else {
-        CueCommandListDestroy(&result);
-        std::string errorString(error);
+    if (commandContext.error) {
+        free(error);
+        std::rethrow_exception(commandContext.error);
+    } else if (status != 0) {
+        std::string errorString(error != nullptr ? error : "parse error");
         free(error);
         throw ParseError("Line " + std::to_string(errorLine) + ": " + errorString);
     }
 }
+    
+static void destroyToken(int token, CUE_STYPE& value) {
+    switch (token) {
+        case INVALID_COMMAND: free(value.invalidCommand); return;
+        case CATALOG_COMMAND: value.command.type = CueCommandTypeCatalog; break;
+        case CDTEXTFILE_COMMAND: value.command.type = CueCommandTypeCdTextFile; break;
+        case FLAGS_COMMAND: value.command.type = CueCommandTypeFlags; break;
+        case PERFORMER_COMMAND: value.command.type = CueCommandTypePerformer; break;
+        case ISRC_COMMAND: value.command.type = CueCommandTypeIsrc; break;
+        case SONGWRITER_COMMAND: value.command.type = CueCommandTypeSongwriter; break;
+        case TITLE_COMMAND: value.command.type = CueCommandTypeTitle; break;
+        case REM_COMMAND: value.command.type = CueCommandTypeRem; break;
+        case FILE_COMMAND: value.command.type = CueCommandTypeFile; break;
+        case TRACK_COMMAND: value.command.type = CueCommandTypeTrack; break;
+        default: return;
+    }
+    CueCommandDestroy(&value.command);
+}
+    
+size_t tokenize(std::istream& input) {
+    struct CueParserExtra extra;
+    CueParserReadCallbackContext context { input, false };
+    extra.context  = &context;
+    extra.readCallback = CueParserReadCallback;
+    
+    yyscan_t scanner;
+    cue_lex_init(&scanner);
+    cue_set_extra(&extra, scanner);
+    
+    size_t numberOfTokens = 0;
+    CUE_STYPE value;
+    CUE_LTYPE location;
+    int token;
+    while ((token = cue_lex(&value, &location, scanner)) > 0) {
+        destroyToken(token, value);
+        ++numberOfTokens;
+    }
+    cue_lex_destroy(scanner);
+    return numberOfTokens;
+}
+    
+class DiscBuilder : public ParseVisitor {
+    Disc& _disc;
+    
+    Track& currentTrack(const char* command) {
+        if (_disc.tracksBegin() == _disc.tracksEnd()) {
+            throw ParseError(std::string(command) + " must be used within a TRACK!");
+        }
+        return *(_disc.tracksEnd() - 1);
+    }
+    
+public:
+    DiscBuilder(Disc& disc) : _disc(disc) {}
+    
+    virtual void onCatalog(std::string_view catalog) override {
+        _disc.catalog = std::string(catalog);
+    }
+    
+    virtual void onCdTextFile(std::string_view cdTextFile) override {
+        _disc.cdTextFile = std::string(cdTextFile);
+    }
+    
+    virtual void onFile(std::string_view path, std::string_view fileType) override {
+        auto& file = _disc.addFile();
+        file.path = path;
+        file.fileType = fileType;
+    }
+    
+    virtual void onFlags(std::string_view flags) override {
+        currentTrack("FLAGS").flags = std::string(flags);
+    }
+    
+    virtual void onIndex(int indexNumber, Time begin) override {
+        if (_disc.filesBegin() == _disc.filesEnd()) {
+            throw ParseError("INDEX can only be used after specifying a FILE!");
+        }
+        auto& index = currentTrack("INDEX").addIndex();
+        index.index = indexNumber;
+        index.begin = begin;
+        index.setFile(*(_disc.filesEnd() - 1));
+    }
+    
+    virtual void onIsrc(std::string_view isrc) override {
+        currentTrack("ISRC").isrc = std::string(isrc);
+    }
+    
+    virtual void onPerformer(std::string_view performer) override {
+        if (_disc.tracksBegin() == _disc.tracksEnd()) {
+            _disc.performer = std::string(performer);
+        } else {
+            (_disc.tracksEnd() - 1)->performer = std::string(performer);
+        }
+    }
+    
+    virtual void onPostgap(Time postgap) override {
+        currentTrack("POSTGAP").postgap = postgap;
+    }
+    
+    virtual void onPregap(Time pregap) override {
+        currentTrack("PREGAP").pregap = pregap;
+    }
+    
+    virtual void onRem(std::string_view comment) override {
+        if (_disc.tracksBegin() == _disc.tracksEnd()) {
+            _disc.comments.emplace_back(comment);
+        } else {
+            auto& lastTrack = *(_disc.tracksEnd() - 1);
+            if (lastTrack.indexesBegin() == lastTrack.indexesEnd()) {
+                lastTrack.comments.emplace_back(comment);
+            } else {
+                auto& lastIndex = *(lastTrack.indexesEnd() - 1);
+                lastIndex.comments.emplace_back(comment);
+            }
+        }
+    }
+    
+    virtual void onSongwriter(std::string_view songwriter) override {
+        if (_disc.tracksBegin() == _disc.tracksEnd()) {
+            _disc.songwriter = std::string(songwriter);
+        } else {
+            (_disc.tracksEnd() - 1)->songwriter = std::string(songwriter);
+        }
+    }
+    
+    virtual void onTitle(std::string_view title) override {
+        if (_disc.tracksBegin() == _disc.tracksEnd()) {
+            _disc.title = std::string(title);
+        } else {
+            (_disc.tracksEnd() - 1)->title = std::string(title);
+        }
+    }
+    
+    virtual void onTrack(int number, std::string_view dataType) override {
+        auto& track = _disc.addTrack();
+        track.number = number;
+        track.dataType = dataType;
+    }
+};
+    
+Disc::Disc(std::istream& input) noexcept(false) {
+    DiscBuilder builder(*this);
+    parse(input, builder);
+}
+
+static void appendEscaped(std::string& buffer, const std::string& s) {
+    buffer += '"';
+    for (auto c : s) {
+        if (c == '"') {
+            buffer += '\\';
+        }
+        buffer += c;
+    }
+    buffer += '"';
+}
+
+static void appendTwoDigits(std::string& buffer, long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    if (result.ptr - digits < 2) {
+        buffer += '0';
+    }
+    buffer.append(digits, result.ptr);
+}
+
+static void appendTime(std::string& buffer, const Time& time) {
+    auto components = time.cueTime();
+    appendTwoDigits(buffer, std::get<0>(components));
+    buffer += ':';
+    appendTwoDigits(buffer, std::get<1>(components));
+    buffer += ':';
+    appendTwoDigits(buffer, std::get<2>(components));
+}
 
-static std::string escape(const std::string& s) {
-    auto result = s;
-    boost::replace_all(result, "\"", "\\\"");
-    return '"' + result + '"';
+static void appendLine(std::string& buffer, const char* command, const std::string& argument) {
+    buffer += command;
+    buffer += argument;
+    buffer += '\n';
+}
+
+static void appendEscapedLine(std::string& buffer, const char* command, const std::string& argument) {
+    buffer += command;
+    appendEscaped(buffer, argument);
+    buffer += '\n';
+}
+
+static void appendFileLine(std::string& buffer, const File& file) {
+    buffer += "FILE ";
+    appendEscaped(buffer, file.path);
+    buffer += ' ';
+    buffer += file.fileType;
+    buffer += '\n';
 }
     
-std::ostream& operator<<(std::ostream& o, const Disc& disc) {
-    for (auto comment : disc.comments) {
-        o << "REM " << comment << std::endl;
+void serialize(const Disc& disc, std::string& buffer) {
+    for (auto& comment : disc.comments) {
+        appendLine(buffer, "REM ", comment);
     }
     if (disc.cdTextFile) {
-        o << "CDTEXTFILE " << escape(disc.cdTextFile.value()) << std::endl;
+        appendEscapedLine(buffer, "CDTEXTFILE ", disc.cdTextFile.value());
     }
     if (disc.catalog) {
-        o << "CATALOG " << disc.catalog.value() << std::endl;
+        appendLine(buffer, "CATALOG ", disc.catalog.value());
     }
     if (disc.performer) {
-        o << "PERFORMER " << escape(disc.performer.value()) << std::endl;
+        appendEscapedLine(buffer, "PERFORMER ", disc.performer.value());
     }
     if (disc.songwriter) {
-        o << "SONGWRITER " << escape(disc.songwriter.value()) << std::endl;
+        appendEscapedLine(buffer, "SONGWRITER ", disc.songwriter.value());
     }
     if (disc.title) {
-        o << "TITLE " << escape(disc.title.value()) << std::endl;
+        appendEscapedLine(buffer, "TITLE ", disc.title.value());
     }
     
     File const * currentFile = nullptr;
@@ -218,51 +363,107 @@ std::ostream& operator<<(std::ostream& o, const Disc& disc) {
         auto firstIndexFile = &track->indexesCbegin()->file();
         if (currentFile != firstIndexFile) {
             currentFile = firstIndexFile;
-            o << "FILE " << escape(currentFile->path) << " " << currentFile->fileType << std::endl;
+            appendFileLine(buffer, *currentFile);
         }
         
-        o << "  TRACK " << boost::io::group(std::setw(2), std::setfill('0'), track->number) << " " << track->dataType << std::endl;
+        buffer += "  TRACK ";
+        appendTwoDigits(buffer, track->number);
+        buffer += ' ';
+        buffer += track->dataType;
+        buffer += '\n';
         
-        for (auto comment : track->comments) {
-            o << "    REM " << comment << std::endl;
+        for (auto& comment : track->comments) {
+            appendLine(buffer, "    REM ", comment);
         }
         if (track->performer) {
-            o << "    PERFORMER " << escape(track->performer.value()) << std::endl;
+            appendEscapedLine(buffer, "    PERFORMER ", track->performer.value());
         }
         if (track->songwriter) {
-            o << "    SONGWRITER " << escape(track->songwriter.value()) << std::endl;
+            appendEscapedLine(buffer, "    SONGWRITER ", track->songwriter.value());
         }
         if (track->title) {
-            o << "    TITLE " << escape(track->title.value()) << std::endl;
+            appendEscapedLine(buffer, "    TITLE ", track->title.value());
         }
         if (track->isrc) {
-            o << "    ISRC " << track->isrc.value() << std::endl;
+            appendLine(buffer, "    ISRC ", track->isrc.value());
         }
         if (track->flags) {
-            o << "    FLAGS " << track->flags.value() << std::endl;
+            appendLine(buffer, "    FLAGS ", track->flags.value());
         }
         if (track->pregap) {
-            o << "    PREGAP " << track->pregap.value() << std::endl;
+            buffer += "    PREGAP ";
+            appendTime(buffer, track->pregap.value());
+            buffer += '\n';
         }
         if (track->postgap) {
-            o << "    POSTGAP " << track->postgap.value() << std::endl;
+            buffer += "    POSTGAP ";
+            appendTime(buffer, track->postgap.value());
+            buffer += '\n';
         }
         
         for (auto index = track->indexesCbegin(); index != track->indexesCend(); ++index) {
             if (currentFile != &index->file()) {
                 currentFile = &index->file();
-                o << "FILE " << escape(currentFile->path) << " " << currentFile->fileType << std::endl;
+                appendFileLine(buffer, *currentFile);
             }
-            o << "    INDEX " << boost::io::group(std::setw(2), std::setfill('0'), index->index) << " " << index->begin << std::endl;
+            buffer += "    INDEX ";
+            appendTwoDigits(buffer, index->index);
+            buffer += ' ';
+            appendTime(buffer, index->begin);
+            buffer += '\n';
             
-            for (auto comment : index->comments) {
-                o << "      REM " << comment << std::endl;
+            for (auto& comment : index->comments) {
+                appendLine(buffer, "      REM ", comment);
             }
         }
     }
-    return o;
 }
     
+std::ostream& operator<<(std::ostream& o, const Disc& disc) {
+    std::string buffer;
+    serialize(disc, buffer);
+    return o.write(buffer.data(), buffer.size());
+}
+    
+void write(const Disc& disc, int fileDescriptor) noexcept(false) {
+    std::string buffer;
+    serialize(disc, buffer);
+    
+    size_t written = 0;
+    while (written < buffer.size()) {
+        auto result = ::write(fileDescriptor, buffer.data() + written, buffer.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Failed to write cue sheet");
+        }
+        written += result;
+    }
+}
+    
+std::vector<SplitPass> planSplitPasses(const Split& split, std::vector<size_t> outputs) {
+    std::sort(outputs.begin(), outputs.end());
+    std::vector<SplitPass> passes;
+    const SplitInputSegment* previous = nullptr;
+    for (auto output : outputs) {
+        auto& segments = split.outputFiles.at(output).inputSegments;
+        for (size_t segment = 0; segment < segments.size(); ++segment) {
+            auto& inputSegment = segments[segment];
+            auto continuesPass = previous
+                && previous->inputFile == inputSegment.inputFile
+                && previous->end
+                && !(inputSegment.begin < *previous->end);
+            if (!continuesPass) {
+                passes.push_back(SplitPass { inputSegment.inputFile, {} });
+            }
+            passes.back().segments.emplace_back(output, segment);
+            previous = &inputSegment;
+        }
+    }
+    return passes;
+}
+
 Split GapsAppendedSplitGenerator::split(const cue::Disc &disc) const {
     Split result;
     result.outputSheet = std::make_shared<Disc>();
@@ -278,6 +479,8 @@ Split GapsAppendedSplitGenerator::split(const cue::Disc &disc) const {
         return result;
     }
     
+    Timeline timeline(disc, _inputFileDurationHandler);
+    
     bool hasHTOA = firstTrack->indexesCbegin()->index == 0;
     if (hasHTOA) {
         auto htoaIndex = firstTrack->indexesCbegin();
@@ -353,6 +556,7 @@ Split GapsAppendedSplitGenerator::split(const cue::Disc &disc) const {
         } else {
             SplitOutput currentOutput;
             currentOutput.outputFile = _outputFileNameHandler(&*track);
+            Time currentOutputDuration = 0;
             
             auto& outputSheetFile = result.outputSheet->addFile();
             outputSheetFile.path = currentOutput.outputFile;
@@ -432,11 +636,10 @@ Split GapsAppendedSplitGenerator::split(const cue::Disc &disc) const {
                 outputSheetIndex.comments = index->comments;
                 outputSheetIndex.index = index->index;
                 outputSheetIndex.setFile(outputSheetFile);
-                outputSheetIndex.begin = 0;
-                for (auto inputSegment : currentOutput.inputSegments) {
-                    outputSheetIndex.begin = outputSheetIndex.begin + (inputSegment.end.value_or(_inputFileDurationHandler(inputSegment.inputFile)) - inputSegment.begin);
-                }
+                outputSheetIndex.begin = currentOutputDuration;
                 
+                auto fileDuration = timeline.fileDuration(&file - &*disc.filesCbegin());
+                currentOutputDuration = currentOutputDuration + (inputSegment.end.value_or(fileDuration) - inputSegment.begin);
                 currentOutput.inputSegments.push_back(inputSegment);
                 
                 if (isNextTracksZeroIndex) {
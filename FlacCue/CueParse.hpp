@@ -11,7 +11,9 @@
 
 #include <iostream>
 #include <tuple>
+#include <utility>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 
@@ -160,8 +162,41 @@ public:
     }
 };
     
+// Receives cue sheet commands in input order, as the parser recognizes them.
+// Strings are only valid for the duration of the call. Throwing aborts parsing;
+// a ParseError thrown from a callback gets the offending line number prepended.
+class ParseVisitor {
+public:
+    virtual ~ParseVisitor() = default;
+    
+    virtual void onCatalog(std::string_view catalog) {}
+    virtual void onCdTextFile(std::string_view cdTextFile) {}
+    virtual void onFile(std::string_view path, std::string_view fileType) {}
+    virtual void onFlags(std::string_view flags) {}
+    virtual void onIndex(int index, Time begin) {}
+    virtual void onIsrc(std::string_view isrc) {}
+    virtual void onPerformer(std::string_view performer) {}
+    virtual void onPostgap(Time postgap) {}
+    virtual void onPregap(Time pregap) {}
+    virtual void onRem(std::string_view comment) {}
+    virtual void onSongwriter(std::string_view songwriter) {}
+    virtual void onTitle(std::string_view title) {}
+    virtual void onTrack(int number, std::string_view dataType) {}
+};
+    
+void parse(std::istream& input, ParseVisitor& visitor) noexcept(false);
+    
+// Runs only the lexer over `input` and returns the number of tokens. Meant for benchmarking.
+size_t tokenize(std::istream& input);
+    
 std::ostream& operator<<(std::ostream& o, const Disc& disc);
 
+// Appends the same text operator<< produces to `buffer`, without going through iostreams.
+void serialize(const Disc& disc, std::string& buffer);
+
+// Serializes `disc` and writes it to the file descriptor in one go.
+void write(const Disc& disc, int fileDescriptor) noexcept(false);
+
 struct SplitInputSegment {
     std::string inputFile;
     Time begin;
@@ -177,6 +212,18 @@ struct Split {
     std::vector<SplitOutput> outputFiles;
     std::shared_ptr<Disc> outputSheet;
 };
+
+// A stretch of a Split that is read in one go, front to back, from a single input file.
+struct SplitPass {
+    std::string inputFile;
+    std::vector<std::pair<size_t, size_t>> segments; // output and segment indices, in disc order
+};
+
+// Orders the segments of `outputs` into passes so that the outputs come out one after the
+// other in disc order, which is what the AccurateRip checksums need. Consecutive segments
+// share a pass while they read forward through the same file; a layout going back to an
+// earlier file or an earlier part of one (file A, then B, then A again) takes another pass.
+std::vector<SplitPass> planSplitPasses(const Split& split, std::vector<size_t> outputs);
     
 class SplitGenerator {
 public:
@@ -0,0 +1,390 @@
+//
+//  DiscSnapshot.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "DiscSnapshot.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace cue {
+
+static const char SnapshotMagic[4] = { 'F', 'C', 'D', 'S' };
+static const size_t HeaderSize = 24;
+static const size_t EntryRecordSize = 40;
+// Encoded sizes of the records of a disc, the strings they refer to not included.
+static const size_t StringRecordSize = 8;
+static const size_t FileRecordSize = 2 * StringRecordSize;
+static const size_t IndexRecordSize = 17;
+static const size_t TrackRecordSize = 6 * StringRecordSize + 29;
+
+template<typename T> static void appendLittleEndian(std::string& buffer, T x) {
+    static_assert(std::is_integral<T>(), "T must be an integral type!");
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        buffer += (char)(uint8_t)((typename std::make_unsigned<T>::type)x >> (8 * i));
+    }
+}
+
+template<typename T> static T readLittleEndian(const uint8_t* p) {
+    static_assert(std::is_integral<T>(), "T must be an integral type!");
+    typename std::make_unsigned<T>::type x = 0;
+    for (int i = sizeof(T) - 1; i >= 0; --i) {
+        x = (typename std::make_unsigned<T>::type)(x << 8) | p[i];
+    }
+    return (T)x;
+}
+
+class SnapshotReader {
+    const uint8_t* _position;
+    const uint8_t* _end;
+
+    const uint8_t* take(size_t size) {
+        if ((size_t)(_end - _position) < size) {
+            throw SnapshotError("Truncated snapshot entry");
+        }
+        auto result = _position;
+        _position += size;
+        return result;
+    }
+
+public:
+    SnapshotReader(const uint8_t* data, size_t size) : _position(data), _end(data + size) {}
+
+    template<typename T> T read() { return readLittleEndian<T>(take(sizeof(T))); }
+    std::string_view bytes(size_t size) { return std::string_view((const char*)take(size), size); }
+
+    // Checks a count read from the entry before anything is allocated for it: there have
+    // to be enough bytes left for that many records.
+    void checkCount(uint32_t count, size_t recordSize) const {
+        if (count > (size_t)(_end - _position) / recordSize) {
+            throw SnapshotError("Invalid record count in snapshot entry");
+        }
+    }
+};
+
+class SnapshotCodec {
+    static void encode(std::string& buffer, const CompactDisc::String& string) {
+        appendLittleEndian(buffer, string.offset);
+        appendLittleEndian(buffer, string.length);
+    }
+
+    static CompactDisc::String decodeString(SnapshotReader& reader, const CompactDisc& disc) {
+        CompactDisc::String result;
+        result.offset = reader.read<uint32_t>();
+        result.length = reader.read<uint32_t>();
+        if (result.hasValue() && (uint64_t)result.offset + result.length > disc._strings.size()) {
+            throw SnapshotError("String out of bounds in snapshot entry");
+        }
+        return result;
+    }
+
+public:
+    static void encode(std::string& buffer, const CompactDisc& disc) {
+        appendLittleEndian(buffer, (uint32_t)disc._strings.size());
+        appendLittleEndian(buffer, (uint32_t)disc._comments.size());
+        appendLittleEndian(buffer, (uint32_t)disc._files.size());
+        appendLittleEndian(buffer, (uint32_t)disc._indexes.size());
+        appendLittleEndian(buffer, (uint32_t)disc._tracks.size());
+        appendLittleEndian(buffer, disc._numberOfDiscComments);
+        buffer += disc._strings;
+        encode(buffer, disc._catalog);
+        encode(buffer, disc._cdTextFile);
+        encode(buffer, disc._performer);
+        encode(buffer, disc._title);
+        encode(buffer, disc._songwriter);
+        for (auto& comment : disc._comments) {
+            encode(buffer, comment);
+        }
+        for (auto& file : disc._files) {
+            encode(buffer, file.path);
+            encode(buffer, file.fileType);
+        }
+        for (auto& index : disc._indexes) {
+            appendLittleEndian(buffer, (int64_t)index.begin.samples);
+            appendLittleEndian(buffer, index.firstComment);
+            appendLittleEndian(buffer, index.numberOfComments);
+            appendLittleEndian(buffer, index.file);
+            appendLittleEndian(buffer, index.index);
+        }
+        for (auto& track : disc._tracks) {
+            encode(buffer, track.dataType);
+            encode(buffer, track.performer);
+            encode(buffer, track.title);
+            encode(buffer, track.songwriter);
+            encode(buffer, track.isrc);
+            encode(buffer, track.flags);
+            appendLittleEndian(buffer, track.pregap);
+            appendLittleEndian(buffer, track.postgap);
+            appendLittleEndian(buffer, track.firstIndex);
+            appendLittleEndian(buffer, track.firstComment);
+            appendLittleEndian(buffer, track.numberOfIndexes);
+            appendLittleEndian(buffer, track.numberOfComments);
+            appendLittleEndian(buffer, track.number);
+        }
+    }
+
+    static std::shared_ptr<CompactDisc> decode(const uint8_t* data, size_t size) {
+        SnapshotReader reader(data, size);
+        auto disc = std::make_shared<CompactDisc>();
+        auto stringsSize = reader.read<uint32_t>();
+        auto numberOfComments = reader.read<uint32_t>();
+        auto numberOfFiles = reader.read<uint32_t>();
+        auto numberOfIndexes = reader.read<uint32_t>();
+        auto numberOfTracks = reader.read<uint32_t>();
+        disc->_numberOfDiscComments = reader.read<uint32_t>();
+        if (disc->_numberOfDiscComments > numberOfComments) {
+            throw SnapshotError("Invalid comment count in snapshot entry");
+        }
+        disc->_strings = std::string(reader.bytes(stringsSize));
+        disc->_catalog = decodeString(reader, *disc);
+        disc->_cdTextFile = decodeString(reader, *disc);
+        disc->_performer = decodeString(reader, *disc);
+        disc->_title = decodeString(reader, *disc);
+        disc->_songwriter = decodeString(reader, *disc);
+
+        reader.checkCount(numberOfComments, StringRecordSize);
+        disc->_comments.reserve(numberOfComments);
+        for (uint32_t i = 0; i < numberOfComments; ++i) {
+            disc->_comments.push_back(decodeString(reader, *disc));
+        }
+        reader.checkCount(numberOfFiles, FileRecordSize);
+        disc->_files.reserve(numberOfFiles);
+        for (uint32_t i = 0; i < numberOfFiles; ++i) {
+            CompactDisc::File file;
+            file.path = decodeString(reader, *disc);
+            file.fileType = decodeString(reader, *disc);
+            disc->_files.push_back(file);
+        }
+        reader.checkCount(numberOfIndexes, IndexRecordSize);
+        disc->_indexes.reserve(numberOfIndexes);
+        for (uint32_t i = 0; i < numberOfIndexes; ++i) {
+            CompactDisc::Index index;
+            index.begin = reader.read<int64_t>();
+            index.firstComment = reader.read<uint32_t>();
+            index.numberOfComments = reader.read<uint16_t>();
+            index.file = reader.read<uint16_t>();
+            index.index = reader.read<uint8_t>();
+            if ((uint64_t)index.firstComment + index.numberOfComments > numberOfComments || index.file >= numberOfFiles) {
+                throw SnapshotError("Invalid index in snapshot entry");
+            }
+            disc->_indexes.push_back(index);
+        }
+        reader.checkCount(numberOfTracks, TrackRecordSize);
+        disc->_tracks.reserve(numberOfTracks);
+        for (uint32_t i = 0; i < numberOfTracks; ++i) {
+            CompactDisc::Track track;
+            track.dataType = decodeString(reader, *disc);
+            track.performer = decodeString(reader, *disc);
+            track.title = decodeString(reader, *disc);
+            track.songwriter = decodeString(reader, *disc);
+            track.isrc = decodeString(reader, *disc);
+            track.flags = decodeString(reader, *disc);
+            track.pregap = reader.read<int64_t>();
+            track.postgap = reader.read<int64_t>();
+            track.firstIndex = reader.read<uint32_t>();
+            track.firstComment = reader.read<uint32_t>();
+            track.numberOfIndexes = reader.read<uint16_t>();
+            track.numberOfComments = reader.read<uint16_t>();
+            track.number = reader.read<uint8_t>();
+            if ((uint64_t)track.firstIndex + track.numberOfIndexes > numberOfIndexes ||
+                (uint64_t)track.firstComment + track.numberOfComments > numberOfComments) {
+                throw SnapshotError("Invalid track in snapshot entry");
+            }
+            disc->_tracks.push_back(track);
+        }
+        return disc;
+    }
+};
+
+std::optional<SourceInfo> SourceInfo::Stat(const std::string& path) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) {
+        return std::nullopt;
+    }
+#ifdef __APPLE__
+    auto modificationTime = fileStat.st_mtimespec;
+#else
+    auto modificationTime = fileStat.st_mtim;
+#endif
+    return SourceInfo {
+        (int64_t)modificationTime.tv_sec * 1000000000 + modificationTime.tv_nsec,
+        (uint64_t)fileStat.st_size
+    };
+}
+
+SnapshotWriter::SnapshotWriter() {
+    _blobs.append(SnapshotMagic, sizeof(SnapshotMagic));
+    appendLittleEndian(_blobs, Snapshot::Version);
+    appendLittleEndian(_blobs, (uint32_t)0);
+    appendLittleEndian(_blobs, (uint32_t)0);
+    appendLittleEndian(_blobs, (uint64_t)0);
+}
+
+void SnapshotWriter::addBlob(const std::string& path, const SourceInfo& source, const uint8_t* blob, size_t blobSize) {
+    Entry entry;
+    entry.blobOffset = _blobs.size();
+    entry.blobSize = (uint32_t)blobSize;
+    _blobs.append((const char*)blob, blobSize);
+    entry.pathOffset = _blobs.size();
+    entry.pathSize = (uint32_t)path.size();
+    _blobs += path;
+    entry.source = source;
+    _entries.push_back(entry);
+}
+
+void SnapshotWriter::add(const std::string& path, const SourceInfo& source, const CompactDisc& disc) {
+    std::string blob;
+    SnapshotCodec::encode(blob, disc);
+    addBlob(path, source, (const uint8_t*)blob.data(), blob.size());
+}
+
+void SnapshotWriter::add(const Snapshot& snapshot, size_t entry) {
+    auto blob = snapshot.blob(entry);
+    addBlob(std::string(snapshot.path(entry)), snapshot.source(entry), blob.first, blob.second);
+}
+
+void SnapshotWriter::write(const std::string& path) const noexcept(false) {
+    std::string header;
+    header.append(SnapshotMagic, sizeof(SnapshotMagic));
+    appendLittleEndian(header, Snapshot::Version);
+    appendLittleEndian(header, (uint32_t)_entries.size());
+    appendLittleEndian(header, (uint32_t)0);
+    appendLittleEndian(header, (uint64_t)_blobs.size());
+
+    std::string entryTable;
+    entryTable.reserve(_entries.size() * EntryRecordSize);
+    for (auto& entry : _entries) {
+        appendLittleEndian(entryTable, entry.blobOffset);
+        appendLittleEndian(entryTable, entry.blobSize);
+        appendLittleEndian(entryTable, entry.pathSize);
+        appendLittleEndian(entryTable, entry.pathOffset);
+        appendLittleEndian(entryTable, entry.source.modificationTime);
+        appendLittleEndian(entryTable, entry.source.size);
+    }
+
+    // A name of its own, so that writers of the same snapshot don't write into each
+    // other's temporary file; the last rename wins.
+    auto temporaryPath = path + ".XXXXXX";
+    auto fileDescriptor = mkstemp(&temporaryPath[0]);
+    if (fileDescriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + temporaryPath + "'");
+    }
+    fchmod(fileDescriptor, 0644);
+
+    auto writeAll = [&](const char* data, size_t size) {
+        while (size > 0) {
+            auto result = ::write(fileDescriptor, data, size);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                auto error = errno;
+                close(fileDescriptor);
+                unlink(temporaryPath.c_str());
+                throw std::system_error(error, std::generic_category(), "Failed to write '" + temporaryPath + "'");
+            }
+            data += result;
+            size -= result;
+        }
+    };
+    writeAll(header.data(), header.size());
+    writeAll(_blobs.data() + HeaderSize, _blobs.size() - HeaderSize);
+    writeAll(entryTable.data(), entryTable.size());
+
+    if (fsync(fileDescriptor) != 0 || close(fileDescriptor) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to flush '" + temporaryPath + "'");
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to rename '" + temporaryPath + "'");
+    }
+}
+
+Snapshot::Snapshot(const std::string& path) noexcept(false)
+: _file(path) {
+    auto data = _file.data();
+    auto size = _file.size();
+    if (size < HeaderSize || memcmp(data, SnapshotMagic, sizeof(SnapshotMagic)) != 0) {
+        throw SnapshotError("'" + path + "' is not a cue snapshot");
+    }
+    auto version = readLittleEndian<uint32_t>(data + 4);
+    if (version != Version) {
+        throw SnapshotError("Unsupported snapshot version " + std::to_string(version) + " in '" + path + "'");
+    }
+    _numberOfEntries = readLittleEndian<uint32_t>(data + 8);
+    auto entryTableOffset = readLittleEndian<uint64_t>(data + 16);
+    if (entryTableOffset > size || (size - entryTableOffset) / EntryRecordSize < _numberOfEntries) {
+        throw SnapshotError("Truncated snapshot '" + path + "'");
+    }
+    _entryTable = data + entryTableOffset;
+
+    for (size_t i = 0; i < _numberOfEntries; ++i) {
+        auto record = entryRecord(i);
+        auto blobOffset = readLittleEndian<uint64_t>(record);
+        auto blobSize = readLittleEndian<uint32_t>(record + 8);
+        auto pathSize = readLittleEndian<uint32_t>(record + 12);
+        auto pathOffset = readLittleEndian<uint64_t>(record + 16);
+        if (blobOffset > entryTableOffset || blobSize > entryTableOffset - blobOffset ||
+            pathOffset > entryTableOffset || pathSize > entryTableOffset - pathOffset) {
+            throw SnapshotError("Corrupt entry table in snapshot '" + path + "'");
+        }
+        _entriesByPath[this->path(i)] = i;
+    }
+    _discs.resize(_numberOfEntries);
+}
+
+const uint8_t* Snapshot::entryRecord(size_t entry) const {
+    return _entryTable + entry * EntryRecordSize;
+}
+
+std::optional<size_t> Snapshot::find(std::string_view path) const {
+    auto entry = _entriesByPath.find(path);
+    if (entry == _entriesByPath.end()) {
+        return std::nullopt;
+    } else {
+        return entry->second;
+    }
+}
+
+std::string_view Snapshot::path(size_t entry) const {
+    auto record = entryRecord(entry);
+    return std::string_view((const char*)_file.data() + readLittleEndian<uint64_t>(record + 16), readLittleEndian<uint32_t>(record + 12));
+}
+
+SourceInfo Snapshot::source(size_t entry) const {
+    auto record = entryRecord(entry);
+    return SourceInfo { readLittleEndian<int64_t>(record + 24), readLittleEndian<uint64_t>(record + 32) };
+}
+
+std::pair<const uint8_t*, size_t> Snapshot::blob(size_t entry) const {
+    auto record = entryRecord(entry);
+    return { _file.data() + readLittleEndian<uint64_t>(record), readLittleEndian<uint32_t>(record + 8) };
+}
+
+std::shared_ptr<const CompactDisc> Snapshot::disc(size_t entry) const noexcept(false) {
+    std::lock_guard<std::mutex> lock(_discsMutex);
+    auto& disc = _discs.at(entry);
+    if (!disc) {
+        auto blob = this->blob(entry);
+        disc = SnapshotCodec::decode(blob.first, blob.second);
+    }
+    return disc;
+}
+
+bool Snapshot::isStale(size_t entry) const {
+    auto current = SourceInfo::Stat(std::string(path(entry)));
+    return !current || *current != source(entry);
+}
+
+}
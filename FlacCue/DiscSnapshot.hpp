@@ -0,0 +1,110 @@
+//
+//  DiscSnapshot.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef DiscSnapshot_h
+#define DiscSnapshot_h
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "CompactDisc.hpp"
+#include "MappedFile.hpp"
+
+namespace cue {
+
+// Binary snapshot of many parsed cue sheets, so a catalog can be reloaded without
+// running the parser again.
+//
+// Layout (all integers little-endian):
+//   header:      "FCDS", u32 version, u32 numberOfEntries, u32 reserved, u64 entryTableOffset
+//   blobs:       one encoded CompactDisc per entry, followed by the entry's source path
+//   entry table: u64 blobOffset, u32 blobSize, u32 pathSize, u64 pathOffset,
+//                i64 sourceModificationTime, u64 sourceSize
+
+class SnapshotError : public std::runtime_error {
+    using runtime_error::runtime_error;
+};
+
+struct SourceInfo {
+    int64_t modificationTime; // nanoseconds since the epoch
+    uint64_t size;
+
+    bool operator==(const SourceInfo& other) const { return modificationTime == other.modificationTime && size == other.size; }
+    bool operator!=(const SourceInfo& other) const { return !(*this == other); }
+
+    static std::optional<SourceInfo> Stat(const std::string& path);
+};
+
+class Snapshot;
+
+class SnapshotWriter {
+    std::string _blobs;
+    struct Entry {
+        uint64_t blobOffset;
+        uint32_t blobSize;
+        uint32_t pathSize;
+        uint64_t pathOffset;
+        SourceInfo source;
+    };
+    std::vector<Entry> _entries;
+
+    void addBlob(const std::string& path, const SourceInfo& source, const uint8_t* blob, size_t blobSize);
+
+public:
+    SnapshotWriter();
+
+    void add(const std::string& path, const SourceInfo& source, const CompactDisc& disc);
+    void add(const std::string& path, const SourceInfo& source, const Disc& disc) { add(path, source, CompactDisc(disc)); }
+
+    // Copies an entry of an existing snapshot without decoding it.
+    void add(const Snapshot& snapshot, size_t entry);
+
+    size_t numberOfEntries() const { return _entries.size(); }
+
+    // Writes to a temporary file and renames it over `path`.
+    void write(const std::string& path) const noexcept(false);
+};
+
+class Snapshot {
+    flaccue::MappedFile _file;
+    uint32_t _numberOfEntries;
+    const uint8_t* _entryTable;
+    std::unordered_map<std::string_view, size_t> _entriesByPath;
+    mutable std::mutex _discsMutex;
+    mutable std::vector<std::shared_ptr<const CompactDisc>> _discs;
+
+    const uint8_t* entryRecord(size_t entry) const;
+
+public:
+    static constexpr uint32_t Version = 1;
+
+    explicit Snapshot(const std::string& path) noexcept(false);
+
+    size_t numberOfEntries() const { return _numberOfEntries; }
+    std::optional<size_t> find(std::string_view path) const;
+
+    std::string_view path(size_t entry) const;
+    SourceInfo source(size_t entry) const;
+    std::pair<const uint8_t*, size_t> blob(size_t entry) const;
+
+    // Decodes the entry on first access; later calls return the same object.
+    std::shared_ptr<const CompactDisc> disc(size_t entry) const noexcept(false);
+
+    // True if the source file changed (or disappeared) since the snapshot was taken.
+    bool isStale(size_t entry) const;
+};
+
+}
+
+#endif /* DiscSnapshot_h */
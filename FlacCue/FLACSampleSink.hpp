@@ -0,0 +1,65 @@
+//
+//  FLACSampleSink.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef FLACSampleSink_h
+#define FLACSampleSink_h
+
+// Needs libFLAC++, see SplitExecutor.hpp.
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <FLAC++/all.h>
+
+#include "SampleSource.hpp"
+#include "SplitEncoder.hpp"
+#include "Trace.hpp"
+
+namespace cue {
+
+// Encodes whatever it is given into a FLAC file, in the format of the source.
+class FLACSampleSink : public SampleSink {
+    std::string _path;
+    EncoderSettings _settings;
+    std::unique_ptr<FLAC::Encoder::File> _encoder;
+
+public:
+    FLACSampleSink(const std::string& path, const EncoderSettings& settings = EncoderSettings())
+    : _path(path)
+    , _settings(settings) {}
+
+    virtual void begin(const StreamFormat& format) override {
+        _encoder = std::make_unique<FLAC::Encoder::File>();
+        _encoder->set_channels(format.channels);
+        _encoder->set_sample_rate(format.sampleRate);
+        _encoder->set_bits_per_sample(format.bitsPerSample);
+        _settings.apply(*_encoder);
+        if (_encoder->init(_path) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            throw std::runtime_error("Error while creating '" + _path + "'");
+        }
+    }
+
+    virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) override {
+        flaccue::TraceScope trace("write", "encode");
+        if (!_encoder->process(buffer, count)) {
+            throw std::runtime_error("Error while encoding '" + _path + "'");
+        }
+    }
+
+    virtual void end() override {
+        auto ok = _encoder->finish();
+        _encoder.reset();
+        if (!ok) {
+            throw std::runtime_error("Error while finishing '" + _path + "'");
+        }
+    }
+};
+
+}
+
+#endif /* FLACSampleSink_h */
@@ -11,5 +11,25 @@
 
 #include "AccurateRip.hpp"
 #include "CueParse.hpp"
+#include "Timeline.hpp"
+#include "ThreadPool.hpp"
+#include "Pipeline.hpp"
+#include "MD5.hpp"
+#include "FlacFrame.hpp"
+#include "Probe.hpp"
+#include "PCMImage.hpp"
+#include "PCMSplit.hpp"
+#include "SampleSource.hpp"
+#include "Prefetch.hpp"
+#include "BatchParse.hpp"
+#include "CompactDisc.hpp"
+#include "MappedFile.hpp"
+#include "DiscSnapshot.hpp"
+#include "Manifest.hpp"
+#include "Watch.hpp"
+#include "Lease.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include "Prometheus.hpp"
 
 #endif /* FlacCue_h */
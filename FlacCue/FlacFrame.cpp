@@ -0,0 +1,241 @@
+//
+//  FlacFrame.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "FlacFrame.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace flaccue {
+
+static const size_t StreamInfoSize = 34;
+static const size_t SeekPointSize = 18;
+static const size_t MetadataBlockHeaderSize = 4;
+static const uint8_t StreamInfoType = 0;
+static const uint8_t SeekTableType = 3;
+
+uint8_t crc8(const uint8_t* data, size_t size, uint8_t crc) {
+    static const struct Table {
+        uint8_t values[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                uint8_t value = (uint8_t)i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 0x80) ? (uint8_t)((value << 1) ^ 0x07) : (uint8_t)(value << 1);
+                }
+                values[i] = value;
+            }
+        }
+    } table;
+
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.values[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t size, uint16_t crc) {
+    static const struct Table {
+        uint16_t values[256];
+        Table() {
+            for (int i = 0; i < 256; ++i) {
+                uint16_t value = (uint16_t)(i << 8);
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 0x8000) ? (uint16_t)((value << 1) ^ 0x8005) : (uint16_t)(value << 1);
+                }
+                values[i] = value;
+            }
+        }
+    } table;
+
+    for (size_t i = 0; i < size; ++i) {
+        crc = (uint16_t)((crc << 8) ^ table.values[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// Length of the UTF-8-like coded frame or sample number starting with `lead`.
+static size_t codedNumberSize(uint8_t lead) {
+    if ((lead & 0x80) == 0) {
+        return 1;
+    }
+    size_t size = 0;
+    while (size < 8 && (lead & (0x80 >> size))) {
+        ++size;
+    }
+    if (size < 2 || size > 7) {
+        throw FrameError("Invalid coded number in frame header");
+    }
+    return size;
+}
+
+static void appendCodedNumber(uint64_t number, std::string& output) {
+    if (number < 0x80) {
+        output += (char)number;
+        return;
+    }
+
+    size_t size = 2;
+    while (size < 7 && number >= (1ULL << (5 * size + 1))) {
+        ++size;
+    }
+    if (number >= (1ULL << 36)) {
+        throw FrameError("Sample number doesn't fit in a frame header");
+    }
+
+    auto shift = 6 * (size - 1);
+    output += (char)(((0xFF00 >> size) & 0xFF) | (number >> shift));
+    while (shift > 0) {
+        shift -= 6;
+        output += (char)(0x80 | ((number >> shift) & 0x3F));
+    }
+}
+
+size_t frameHeaderSize(const uint8_t* frame, size_t size) noexcept(false) {
+    if (size < 6 || frame[0] != 0xFF || (frame[1] & 0xFE) != 0xF8) {
+        throw FrameError("Missing frame sync code");
+    }
+
+    auto blocksizeCode = frame[2] >> 4;
+    auto sampleRateCode = frame[2] & 0x0F;
+    if (blocksizeCode == 0 || sampleRateCode == 15) {
+        throw FrameError("Invalid frame header");
+    }
+
+    auto position = 4 + codedNumberSize(frame[4]);
+    if (blocksizeCode == 6) {
+        position += 1;
+    } else if (blocksizeCode == 7) {
+        position += 2;
+    }
+    if (sampleRateCode == 12) {
+        position += 1;
+    } else if (sampleRateCode == 13 || sampleRateCode == 14) {
+        position += 2;
+    }
+
+    if (position >= size) {
+        throw FrameError("Truncated frame header");
+    }
+    if (crc8(frame, position) != frame[position]) {
+        throw FrameError("Frame header CRC mismatch");
+    }
+    return position + 1;
+}
+
+void appendRenumberedFrame(const uint8_t* frame, size_t size, uint64_t sampleNumber, std::string& output) noexcept(false) {
+    auto headerSize = frameHeaderSize(frame, size);
+    if (size < headerSize + 2) {
+        throw FrameError("Truncated frame");
+    }
+
+    auto begin = output.size();
+    output += (char)frame[0];
+    output += (char)(frame[1] | 0x01); // variable blocksize, the header carries the sample number
+    output += (char)frame[2];
+    output += (char)frame[3];
+    appendCodedNumber(sampleNumber, output);
+
+    auto codedNumberEnd = 4 + codedNumberSize(frame[4]);
+    output.append((const char*)frame + codedNumberEnd, headerSize - 1 - codedNumberEnd);
+    output += (char)crc8((const uint8_t*)output.data() + begin, output.size() - begin);
+
+    output.append((const char*)frame + headerSize, size - headerSize - 2);
+    auto crc = crc16((const uint8_t*)output.data() + begin, output.size() - begin);
+    output += (char)(crc >> 8);
+    output += (char)(crc & 0xFF);
+}
+
+static uint64_t readBigEndian(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (auto i = 0; i < bytes; ++i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static void appendBigEndian(uint64_t value, int bytes, std::string& output) {
+    for (auto i = bytes - 1; i >= 0; --i) {
+        output += (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static void appendMetadataBlockHeader(bool isLast, uint8_t type, size_t length, std::string& output) {
+    output += (char)((isLast ? 0x80 : 0) | type);
+    appendBigEndian(length, 3, output);
+}
+
+size_t streamHeaderSize(size_t seekTableCapacity) {
+    auto size = 4 + MetadataBlockHeaderSize + StreamInfoSize;
+    if (seekTableCapacity > 0) {
+        size += MetadataBlockHeaderSize + seekTableCapacity * SeekPointSize;
+    }
+    return size;
+}
+
+void appendStreamHeader(const StreamInfo& streamInfo, const std::vector<SeekPoint>& seekPoints, size_t seekTableCapacity, std::string& output) noexcept(false) {
+    if (seekPoints.size() > seekTableCapacity) {
+        throw FrameError("Too many seek points");
+    }
+    if (streamInfo.channels < 1 || streamInfo.channels > 8 || streamInfo.bitsPerSample < 4 || streamInfo.bitsPerSample > 32) {
+        throw FrameError("Invalid stream format");
+    }
+
+    output += "fLaC";
+    appendMetadataBlockHeader(seekTableCapacity == 0, StreamInfoType, StreamInfoSize, output);
+    appendBigEndian(streamInfo.minimumBlocksize, 2, output);
+    appendBigEndian(streamInfo.maximumBlocksize, 2, output);
+    appendBigEndian(streamInfo.minimumFramesize, 3, output);
+    appendBigEndian(streamInfo.maximumFramesize, 3, output);
+    uint64_t packed =
+        ((uint64_t)streamInfo.sampleRate << 44) |
+        ((uint64_t)(streamInfo.channels - 1) << 41) |
+        ((uint64_t)(streamInfo.bitsPerSample - 1) << 36) |
+        (streamInfo.totalSamples & 0xFFFFFFFFFULL);
+    appendBigEndian(packed, 8, output);
+    output.append((const char*)streamInfo.md5.data(), streamInfo.md5.size());
+
+    if (seekTableCapacity > 0) {
+        appendMetadataBlockHeader(true, SeekTableType, seekTableCapacity * SeekPointSize, output);
+        for (auto& seekPoint : seekPoints) {
+            appendBigEndian(seekPoint.sampleNumber, 8, output);
+            appendBigEndian(seekPoint.offset, 8, output);
+            appendBigEndian(seekPoint.numberOfSamples, 2, output);
+        }
+        for (auto i = seekPoints.size(); i < seekTableCapacity; ++i) {
+            appendBigEndian(UINT64_MAX, 8, output);
+            appendBigEndian(0, 8, output);
+            appendBigEndian(0, 2, output);
+        }
+    }
+}
+
+StreamInfo parseStreamInfoHeader(const uint8_t* data, size_t size) noexcept(false) {
+    if (size < StreamInfoHeaderSize || memcmp(data, "fLaC", 4) != 0) {
+        throw FrameError("Not a FLAC stream");
+    }
+    if ((data[4] & 0x7F) != StreamInfoType || readBigEndian(data + 5, 3) != StreamInfoSize) {
+        throw FrameError("FLAC stream doesn't start with STREAMINFO");
+    }
+
+    auto block = data + 4 + MetadataBlockHeaderSize;
+    StreamInfo streamInfo;
+    streamInfo.minimumBlocksize = (uint32_t)readBigEndian(block, 2);
+    streamInfo.maximumBlocksize = (uint32_t)readBigEndian(block + 2, 2);
+    streamInfo.minimumFramesize = (uint32_t)readBigEndian(block + 4, 3);
+    streamInfo.maximumFramesize = (uint32_t)readBigEndian(block + 7, 3);
+    auto packed = readBigEndian(block + 10, 8);
+    streamInfo.sampleRate = (uint32_t)(packed >> 44);
+    streamInfo.channels = (uint32_t)((packed >> 41) & 0x07) + 1;
+    streamInfo.bitsPerSample = (uint32_t)((packed >> 36) & 0x1F) + 1;
+    streamInfo.totalSamples = packed & 0xFFFFFFFFFULL;
+    std::copy(block + 18, block + 34, streamInfo.md5.begin());
+    return streamInfo;
+}
+
+}
@@ -0,0 +1,73 @@
+//
+//  FlacFrame.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef FlacFrame_h
+#define FlacFrame_h
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MD5.hpp"
+
+namespace flaccue {
+
+// Bit-level helpers for writing FLAC streams out of existing, already encoded frames.
+// Nothing here depends on libFLAC.
+
+class FrameError : public std::runtime_error {
+    using runtime_error::runtime_error;
+};
+
+uint8_t crc8(const uint8_t* data, size_t size, uint8_t crc = 0);
+uint16_t crc16(const uint8_t* data, size_t size, uint16_t crc = 0);
+
+// Size of the frame header including its CRC-8. Throws FrameError unless `frame` starts
+// with a valid frame header.
+size_t frameHeaderSize(const uint8_t* frame, size_t size) noexcept(false);
+
+// Appends `frame` (a complete frame, from sync code to CRC-16) to `output`, turned into a
+// frame of a variable-blocksize stream starting at `sampleNumber`. Only the header and
+// the CRCs change; the subframes are copied byte for byte.
+void appendRenumberedFrame(const uint8_t* frame, size_t size, uint64_t sampleNumber, std::string& output) noexcept(false);
+
+struct StreamInfo {
+    uint32_t minimumBlocksize = 0;
+    uint32_t maximumBlocksize = 0;
+    uint32_t minimumFramesize = 0;
+    uint32_t maximumFramesize = 0;
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t bitsPerSample = 0;
+    uint64_t totalSamples = 0;
+    MD5::Digest md5 = {};
+};
+
+struct SeekPoint {
+    uint64_t sampleNumber;
+    uint64_t offset; // from the first byte of the first frame
+    uint16_t numberOfSamples;
+};
+
+// "fLaC", STREAMINFO and a SEEKTABLE of exactly `seekTableCapacity` points; unused points
+// are written as placeholders. The size only depends on the capacity, so the header can
+// be written up front and overwritten once the stream is complete.
+size_t streamHeaderSize(size_t seekTableCapacity);
+void appendStreamHeader(const StreamInfo& streamInfo, const std::vector<SeekPoint>& seekPoints, size_t seekTableCapacity, std::string& output) noexcept(false);
+
+// "fLaC" and the STREAMINFO block, which the format requires to come first.
+const size_t StreamInfoHeaderSize = 42;
+
+// Parses the first StreamInfoHeaderSize bytes of a FLAC stream. Throws FrameError unless
+// they hold "fLaC" followed by a STREAMINFO block.
+StreamInfo parseStreamInfoHeader(const uint8_t* data, size_t size) noexcept(false);
+
+}
+
+#endif /* FlacFrame_h */
@@ -0,0 +1,375 @@
+//
+//  FramePassthrough.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef FramePassthrough_h
+#define FramePassthrough_h
+
+// Needs libFLAC++, see SplitExecutor.hpp.
+
+#include <cerrno>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <FLAC++/all.h>
+
+#include "CueParse.hpp"
+#include "FlacFrame.hpp"
+#include "MD5.hpp"
+#include "SplitExecutor.hpp"
+#include "Trace.hpp"
+
+namespace cue {
+
+// Writes each output of a split as a FLAC file by copying the encoded frames that lie
+// entirely inside it, byte for byte. Only the audio around the split points, which doesn't
+// make up whole frames, is encoded again. The frames are renumbered into a variable-blocksize
+// stream; STREAMINFO, including the MD5 of the audio, and the seek table are written once
+// the output is complete.
+class FLACPassthroughSplitSink : public SplitSink {
+public:
+    using InputFileDurationHandler = std::function<Time(const std::string& inputFile)>;
+    using OutputPathHandler = std::function<std::string(const std::string& outputFile)>;
+
+private:
+    // Encodes into memory, keeping the frames and dropping the metadata.
+    class FrameEncoder : public FLAC::Encoder::Stream {
+        std::vector<std::pair<std::string, uint32_t>>& _frames;
+
+    protected:
+        virtual ::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame) override {
+            if (samples > 0) {
+                _frames.emplace_back(std::string((const char*)buffer, bytes), samples);
+            }
+            return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+        }
+
+    public:
+        explicit FrameEncoder(std::vector<std::pair<std::string, uint32_t>>& frames) : _frames(frames) {}
+    };
+
+    class Output {
+        // Shorter runs of re-encoded audio are merged with the next whole frame instead.
+        static constexpr uint32_t MinimumBlocksize = 16;
+        static constexpr size_t WriteBufferSize = 1 << 20;
+        static constexpr unsigned SecondsPerSeekPoint = 10;
+        // Bounds the memory used when long stretches arrive without their frames.
+        static constexpr size_t MaximumPendingCount = 1 << 20;
+
+        std::string _path;
+        int _fd;
+        StreamFormat _format;
+        unsigned _compressionLevel;
+        flaccue::StreamInfo _streamInfo;
+        flaccue::MD5 _md5;
+        std::vector<uint8_t> _md5Buffer;
+
+        size_t _seekTableCapacity;
+        uint64_t _seekPointInterval;
+        std::vector<flaccue::SeekPoint> _seekPoints;
+
+        std::string _buffer;
+        uint64_t _framesSize = 0;
+        uint32_t _lastBlocksize = 0;
+        std::vector<std::vector<FLAC__int32>> _pending; // planar samples waiting to be encoded
+
+        void write(const std::string& data, off_t offset) {
+            flaccue::TraceScope trace("write", "encode");
+            for (size_t done = 0; done < data.size(); ) {
+                auto result = offset < 0
+                    ? ::write(_fd, data.data() + done, data.size() - done)
+                    : ::pwrite(_fd, data.data() + done, data.size() - done, offset + (off_t)done);
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result < 0) {
+                    throw std::system_error(errno, std::generic_category(), "Error while writing '" + _path + "'");
+                }
+                done += result;
+            }
+        }
+
+        void updateMD5(const FLAC__int32* const buffer[], uint32_t count) {
+            auto bytesPerSample = (_format.bitsPerSample + 7) / 8;
+            _md5Buffer.resize((size_t)count * _format.channels * bytesPerSample);
+            auto byte = _md5Buffer.data();
+            for (uint32_t i = 0; i < count; ++i) {
+                for (unsigned channel = 0; channel < _format.channels; ++channel) {
+                    auto sample = (uint32_t)buffer[channel][i];
+                    for (unsigned j = 0; j < bytesPerSample; ++j) {
+                        *byte++ = (uint8_t)(sample >> (8 * j));
+                    }
+                }
+            }
+            _md5.update(_md5Buffer.data(), _md5Buffer.size());
+        }
+
+        size_t pendingCount() const {
+            return _pending.empty() ? 0 : _pending[0].size();
+        }
+
+        void addPending(const FLAC__int32* const buffer[], uint32_t count) {
+            _pending.resize(_format.channels);
+            for (unsigned channel = 0; channel < _format.channels; ++channel) {
+                _pending[channel].insert(_pending[channel].end(), buffer[channel], buffer[channel] + count);
+            }
+        }
+
+        void addSeekPoint(uint32_t blocksize) {
+            if (_streamInfo.totalSamples < _seekPoints.size() * _seekPointInterval) {
+                return;
+            }
+            if (_seekPoints.size() == _seekTableCapacity) {
+                // Longer than expected: keep every other point.
+                for (size_t i = 0; 2 * i < _seekPoints.size(); ++i) {
+                    _seekPoints[i] = _seekPoints[2 * i];
+                }
+                _seekPoints.resize((_seekPoints.size() + 1) / 2);
+                _seekPointInterval *= 2;
+                if (_streamInfo.totalSamples < _seekPoints.size() * _seekPointInterval) {
+                    return;
+                }
+            }
+            _seekPoints.push_back(flaccue::SeekPoint { _streamInfo.totalSamples, _framesSize, (uint16_t)blocksize });
+        }
+
+        void appendFrame(const uint8_t* frame, size_t size, uint32_t blocksize) {
+            addSeekPoint(blocksize);
+
+            auto begin = _buffer.size();
+            flaccue::appendRenumberedFrame(frame, size, _streamInfo.totalSamples, _buffer);
+            auto frameSize = (uint32_t)(_buffer.size() - begin);
+
+            // The minimum blocksize excludes the last frame, so each frame is only counted
+            // once the next one arrives; finish() adds the last one to the maximum.
+            if (_lastBlocksize > 0) {
+                _streamInfo.minimumBlocksize = std::min(_streamInfo.minimumBlocksize, _lastBlocksize);
+                _streamInfo.maximumBlocksize = std::max(_streamInfo.maximumBlocksize, _lastBlocksize);
+            }
+            _lastBlocksize = blocksize;
+            _streamInfo.minimumFramesize = std::min(_streamInfo.minimumFramesize, frameSize);
+            _streamInfo.maximumFramesize = std::max(_streamInfo.maximumFramesize, frameSize);
+            _streamInfo.totalSamples += blocksize;
+            _framesSize += frameSize;
+
+            if (_buffer.size() >= WriteBufferSize) {
+                write(_buffer, -1);
+                _buffer.clear();
+            }
+        }
+
+        // Encodes the pending samples into frames of about equal size, as few as the
+        // streamable subset allows.
+        void encodePending() {
+            auto count = (uint32_t)pendingCount();
+            if (count == 0) {
+                return;
+            }
+
+            uint32_t maximumBlocksize = _format.sampleRate <= 48000 ? 4608 : 16384;
+            auto numberOfFrames = (count + maximumBlocksize - 1) / maximumBlocksize;
+            auto blocksize = std::max(MinimumBlocksize, (count + numberOfFrames - 1) / numberOfFrames);
+
+            std::vector<std::pair<std::string, uint32_t>> frames;
+            FrameEncoder encoder(frames);
+            encoder.set_channels(_format.channels);
+            encoder.set_bits_per_sample(_format.bitsPerSample);
+            encoder.set_sample_rate(_format.sampleRate);
+            encoder.set_compression_level(_compressionLevel);
+            encoder.set_blocksize(blocksize);
+            encoder.set_do_md5(false);
+            encoder.set_total_samples_estimate(count);
+            if (encoder.init() != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+                throw std::runtime_error("Error while initializing the FLAC encoder for '" + _path + "'");
+            }
+
+            const FLAC__int32* channels[FLAC__MAX_CHANNELS];
+            for (unsigned channel = 0; channel < _format.channels; ++channel) {
+                channels[channel] = _pending[channel].data();
+            }
+            flaccue::TraceScope trace("reencode", "encode");
+            if (!encoder.process(channels, count) || !encoder.finish()) {
+                throw std::runtime_error("Error while encoding '" + _path + "'");
+            }
+
+            for (auto& frame : frames) {
+                appendFrame((const uint8_t*)frame.first.data(), frame.first.size(), frame.second);
+            }
+            _pending.clear();
+        }
+
+        static bool isIntact(const uint8_t* frame, size_t size) {
+            try {
+                if (size < flaccue::frameHeaderSize(frame, size) + 2) {
+                    return false;
+                }
+            } catch (const flaccue::FrameError&) {
+                return false;
+            }
+            return flaccue::crc16(frame, size - 2) == ((frame[size - 2] << 8) | frame[size - 1]);
+        }
+
+    public:
+        Output(const std::string& path, const StreamFormat& format, uint64_t expectedSamples, unsigned compressionLevel)
+        : _path(path)
+        , _format(format)
+        , _compressionLevel(compressionLevel) {
+            if (format.channels == 0 || format.channels > FLAC__MAX_CHANNELS || format.sampleRate == 0) {
+                throw std::runtime_error("Invalid stream format for '" + path + "'");
+            }
+
+            _streamInfo.minimumBlocksize = UINT32_MAX;
+            _streamInfo.minimumFramesize = UINT32_MAX;
+            _streamInfo.sampleRate = format.sampleRate;
+            _streamInfo.channels = format.channels;
+            _streamInfo.bitsPerSample = format.bitsPerSample;
+            _seekPointInterval = (uint64_t)format.sampleRate * SecondsPerSeekPoint;
+            _seekTableCapacity = (size_t)(expectedSamples / _seekPointInterval) + 1;
+
+            _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (_fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "Error while creating '" + path + "'");
+            }
+
+            // Placeholder, overwritten in finish().
+            _buffer.assign(flaccue::streamHeaderSize(_seekTableCapacity), '\0');
+        }
+
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+
+        // An output that wasn't finished is incomplete, and is removed.
+        ~Output() {
+            if (_fd >= 0) {
+                ::close(_fd);
+                ::unlink(_path.c_str());
+            }
+        }
+
+        const StreamFormat& format() const { return _format; }
+
+        void addSamples(const FLAC__int32* const buffer[], unsigned channels, uint32_t count) {
+            if (channels != _format.channels) {
+                throw std::runtime_error("The inputs of '" + _path + "' have different formats");
+            }
+            updateMD5(buffer, count);
+            addPending(buffer, count);
+            if (pendingCount() >= MaximumPendingCount) {
+                encodePending();
+            }
+        }
+
+        void addFrame(const FLAC__int32* const buffer[], unsigned channels, uint32_t count, const uint8_t* frame, size_t size) {
+            if (!isIntact(frame, size)) {
+                addSamples(buffer, channels, count);
+                return;
+            }
+            if (pendingCount() > 0 && pendingCount() < MinimumBlocksize) {
+                addSamples(buffer, channels, count);
+                return;
+            }
+            if (channels != _format.channels) {
+                throw std::runtime_error("The inputs of '" + _path + "' have different formats");
+            }
+            updateMD5(buffer, count);
+            encodePending();
+            appendFrame(frame, size, count);
+        }
+
+        void finish() {
+            encodePending();
+            write(_buffer, -1);
+            _buffer.clear();
+
+            // The maximum covers every frame: the re-encoded tail can be longer than the
+            // frames of the source, and decoders reject frames above it.
+            _streamInfo.maximumBlocksize = std::max(_streamInfo.maximumBlocksize, _lastBlocksize);
+            if (_lastBlocksize > 0 && _streamInfo.minimumBlocksize == UINT32_MAX) {
+                _streamInfo.minimumBlocksize = _lastBlocksize;
+            }
+            if (_streamInfo.minimumBlocksize == UINT32_MAX) {
+                _streamInfo.minimumBlocksize = _streamInfo.maximumBlocksize = MinimumBlocksize;
+            }
+            if (_streamInfo.minimumFramesize == UINT32_MAX) {
+                _streamInfo.minimumFramesize = 0;
+            }
+            _streamInfo.md5 = _md5.digest();
+
+            std::string header;
+            flaccue::appendStreamHeader(_streamInfo, _seekPoints, _seekTableCapacity, header);
+            write(header, 0);
+
+            // Write errors can surface only now, e.g. on NFS or a full disk.
+            auto result = ::close(_fd);
+            _fd = -1;
+            if (result != 0) {
+                auto error = errno;
+                ::unlink(_path.c_str());
+                throw std::system_error(error, std::generic_category(), "Error while closing '" + _path + "'");
+            }
+        }
+    };
+
+    const Split& _split;
+    InputFileDurationHandler _inputFileDurationHandler;
+    OutputPathHandler _outputPathHandler;
+    unsigned _compressionLevel;
+    std::optional<StreamFormat> _format;
+    std::unordered_map<size_t, std::unique_ptr<Output>> _outputs;
+
+public:
+    // `compressionLevel` only applies to the re-encoded frames around the split points.
+    FLACPassthroughSplitSink(const Split& split, InputFileDurationHandler inputFileDurationHandler, OutputPathHandler outputPathHandler, unsigned compressionLevel = 5)
+    : _split(split)
+    , _inputFileDurationHandler(inputFileDurationHandler)
+    , _outputPathHandler(outputPathHandler)
+    , _compressionLevel(compressionLevel) {}
+
+    virtual void beginInput(const StreamFormat& format) override {
+        for (auto& output : _outputs) {
+            auto& outputFormat = output.second->format();
+            if (outputFormat.sampleRate != format.sampleRate || outputFormat.channels != format.channels || outputFormat.bitsPerSample != format.bitsPerSample) {
+                throw std::runtime_error("The inputs of '" + _split.outputFiles[output.first].outputFile + "' have different formats");
+            }
+        }
+        _format = format;
+    }
+
+    virtual void beginOutput(size_t output) override {
+        if (!_format) {
+            throw std::logic_error("beginOutput() before beginInput()");
+        }
+        auto& outputFile = _split.outputFiles[output].outputFile;
+        _outputs[output] = std::make_unique<Output>(_outputPathHandler(outputFile), *_format, splitOutputDuration(_split.outputFiles[output], _inputFileDurationHandler).samples, _compressionLevel);
+    }
+
+    virtual void processSamples(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count) override {
+        _outputs.at(output)->addSamples(buffer, channels, count);
+    }
+
+    virtual bool wantsEncodedFrames() const override {
+        return true;
+    }
+
+    virtual void processFrame(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count, const uint8_t* frame, size_t frameSize) override {
+        _outputs.at(output)->addFrame(buffer, channels, count, frame, frameSize);
+    }
+
+    virtual void endOutput(size_t output) override {
+        _outputs.at(output)->finish();
+        _outputs.erase(output);
+    }
+};
+
+}
+
+#endif /* FramePassthrough_h */
@@ -0,0 +1,182 @@
+//
+//  Lease.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Lease.hpp"
+
+#include <system_error>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "MD5.hpp"
+
+namespace flaccue {
+
+constexpr std::chrono::seconds LeaseDirectory::DefaultDuration;
+
+// Held while a stale lease is checked and removed.
+class TakeoverLock {
+    int _fileDescriptor;
+
+public:
+    explicit TakeoverLock(const std::string& path) noexcept(false) {
+        _fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (_fileDescriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open '" + path + "'");
+        }
+        while (flock(_fileDescriptor, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                auto error = errno;
+                close(_fileDescriptor);
+                throw std::system_error(error, std::generic_category(), "Failed to lock '" + path + "'");
+            }
+        }
+    }
+
+    TakeoverLock(const TakeoverLock&) = delete;
+    TakeoverLock& operator=(const TakeoverLock&) = delete;
+
+    ~TakeoverLock() {
+        close(_fileDescriptor); // releases the lock
+    }
+};
+
+LeaseDirectory::LeaseDirectory(const std::string& directory, const std::string& worker, Clock::duration duration) noexcept(false)
+: _directory(directory)
+, _worker(worker)
+, _duration(duration)
+, _isStopping(false) {
+    if (mkdir(_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + _directory + "'");
+    }
+    _renewer = std::thread(&LeaseDirectory::renewLoop, this);
+}
+
+LeaseDirectory::~LeaseDirectory() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _stopCondition.notify_all();
+    _renewer.join();
+
+    for (auto& item : _held) {
+        unlink(itemPath(item, ".lease").c_str());
+    }
+}
+
+std::string LeaseDirectory::itemPath(const std::string& item, const char* suffix) const {
+    MD5 md5;
+    md5.update(item.data(), item.size());
+    return _directory + "/" + MD5::toString(md5.digest()) + suffix;
+}
+
+bool LeaseDirectory::createExclusively(const std::string& path) const {
+    auto fileDescriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fileDescriptor < 0) {
+        if (errno == EEXIST) {
+            return false;
+        }
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + path + "'");
+    }
+    // The owner is only there for whoever looks at the directory.
+    auto contents = _worker + "\n";
+    auto written = write(fileDescriptor, contents.data(), contents.size());
+    (void)written;
+    close(fileDescriptor);
+    return true;
+}
+
+void LeaseDirectory::renewLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopCondition.wait_for(lock, _duration / 3, [&]() { return _isStopping; })) {
+        for (auto& item : _held) {
+            utimes(itemPath(item, ".lease").c_str(), nullptr);
+        }
+    }
+}
+
+LeaseDirectory::LeaseState LeaseDirectory::leaseState(const std::string& lease) const noexcept(false) {
+    struct stat leaseStat;
+    if (stat(lease.c_str(), &leaseStat) != 0) {
+        if (errno == ENOENT) {
+            return LeaseState::Missing;
+        }
+        throw std::system_error(errno, std::generic_category(), "Failed to stat '" + lease + "'");
+    }
+    return Clock::now() < Clock::from_time_t(leaseStat.st_mtime) + _duration ? LeaseState::Fresh : LeaseState::Stale;
+}
+
+LeaseDirectory::Claim LeaseDirectory::tryClaim(const std::string& item) noexcept(false) {
+    auto done = itemPath(item, ".done");
+    auto lease = itemPath(item, ".lease");
+    while (true) {
+        if (access(done.c_str(), F_OK) == 0) {
+            return Claim::Done;
+        }
+
+        if (createExclusively(lease)) {
+            // Whoever finished the item might have dropped its lease just before we
+            // looked for the done file.
+            if (access(done.c_str(), F_OK) == 0) {
+                unlink(lease.c_str());
+                return Claim::Done;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            _held.insert(item);
+            return Claim::Claimed;
+        }
+
+        auto state = leaseState(lease);
+        if (state == LeaseState::Missing) {
+            continue; // released meanwhile
+        }
+        if (state == LeaseState::Fresh) {
+            return Claim::HeldElsewhere;
+        }
+
+        // Another worker may have taken the lease over since it was looked at, so it is
+        // checked again under the lock before it goes. While it exists nobody can create
+        // a new one, so what gets removed is the stale lease.
+        {
+            TakeoverLock lock(_directory + "/takeover.lock");
+            state = leaseState(lease);
+            if (state == LeaseState::Fresh) {
+                return Claim::HeldElsewhere;
+            }
+            if (state == LeaseState::Stale && unlink(lease.c_str()) != 0 && errno != ENOENT) {
+                throw std::system_error(errno, std::generic_category(), "Failed to take over '" + lease + "'");
+            }
+        }
+        // Creating it afresh might still lose against another worker.
+    }
+}
+
+void LeaseDirectory::complete(const std::string& item) noexcept(false) {
+    createExclusively(itemPath(item, ".done"));
+    release(item);
+}
+
+void LeaseDirectory::release(const std::string& item) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_held.erase(item) > 0) {
+        unlink(itemPath(item, ".lease").c_str());
+    }
+}
+
+std::string LeaseDirectory::DefaultWorkerName() {
+    char hostName[256] = {};
+    gethostname(hostName, sizeof(hostName) - 1);
+    return std::string(hostName) + "-" + std::to_string(getpid());
+}
+
+}
@@ -0,0 +1,87 @@
+//
+//  Lease.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Lease_h
+#define Lease_h
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace flaccue {
+
+// Lets processes that share nothing but a directory, possibly on several hosts over NFS,
+// split a list of items between them. An item is claimed by creating its lease file with
+// O_EXCL, and finished by creating its done file. While held, a lease is renewed by
+// touching it every third of its duration; one not renewed for a whole duration belongs
+// to a dead worker and can be taken over. Stale leases are only removed while holding an
+// flock() on the directory's takeover.lock and after checking again that they are stale,
+// so one worker taking over never removes the fresh lease of another; the lock is released
+// by the kernel (or the NFS lock manager) when its holder dies, so it can't go stale
+// itself. Whoever creates the lease afresh afterwards has claimed the item.
+//
+// Items are identified by the MD5 of their name, so every worker must use the same names
+// (paths on the same mount point). Expiry compares modification times set by the file
+// server with the local clock, so the hosts' clocks should be in sync to well within the
+// lease duration. Thread safe.
+class LeaseDirectory {
+public:
+    using Clock = std::chrono::system_clock;
+
+    enum class Claim {
+        Claimed,
+        HeldElsewhere, // by a live worker; might be free later
+        Done,
+    };
+
+private:
+    std::string _directory;
+    std::string _worker;
+    Clock::duration _duration;
+    std::mutex _mutex;
+    std::condition_variable _stopCondition;
+    bool _isStopping;
+    std::unordered_set<std::string> _held;
+    std::thread _renewer;
+
+    std::string itemPath(const std::string& item, const char* suffix) const;
+    bool createExclusively(const std::string& path) const;
+    enum class LeaseState { Missing, Fresh, Stale };
+    LeaseState leaseState(const std::string& lease) const noexcept(false);
+    void renewLoop();
+
+public:
+    static constexpr std::chrono::seconds DefaultDuration = std::chrono::seconds(600);
+
+    // Creates the directory if needed.
+    LeaseDirectory(const std::string& directory, const std::string& worker, Clock::duration duration = DefaultDuration) noexcept(false);
+    ~LeaseDirectory();
+
+    LeaseDirectory(const LeaseDirectory&) = delete;
+    LeaseDirectory& operator=(const LeaseDirectory&) = delete;
+
+    const std::string& worker() const { return _worker; }
+
+    Claim tryClaim(const std::string& item) noexcept(false);
+
+    // Marks a claimed item done and drops its lease.
+    void complete(const std::string& item) noexcept(false);
+
+    // Drops the lease without finishing the item, so another worker can take it.
+    void release(const std::string& item);
+
+    // The host name and process ID.
+    static std::string DefaultWorkerName();
+};
+
+}
+
+#endif /* Lease_h */
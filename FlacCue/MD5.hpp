@@ -0,0 +1,140 @@
+//
+//  MD5.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef MD5_h
+#define MD5_h
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace flaccue {
+
+// RFC 1321 MD5, as stored in the STREAMINFO block of FLAC files.
+class MD5 {
+public:
+    using Digest = std::array<uint8_t, 16>;
+
+private:
+    uint32_t _state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    uint8_t _buffer[64];
+    uint64_t _length = 0;
+
+    static uint32_t rotateLeft(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void transform(const uint8_t block[64]) {
+        static const uint32_t K[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+        static const int S[64] = {
+            7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+            5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+            4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+            6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+        };
+
+        uint32_t M[16];
+        for (int i = 0; i < 16; ++i) {
+            M[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) | ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+        }
+
+        uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t f;
+            int g;
+            if (i < 16) {
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if (i < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            } else if (i < 48) {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            auto rotated = b + rotateLeft(a + f + K[i] + M[g], S[i]);
+            a = d;
+            d = c;
+            c = b;
+            b = rotated;
+        }
+
+        _state[0] += a;
+        _state[1] += b;
+        _state[2] += c;
+        _state[3] += d;
+    }
+
+public:
+    void update(const void* data, size_t size) {
+        auto bytes = (const uint8_t*)data;
+        auto used = (size_t)(_length % 64);
+        _length += size;
+
+        if (used > 0) {
+            auto count = std::min(size, 64 - used);
+            memcpy(_buffer + used, bytes, count);
+            bytes += count;
+            size -= count;
+            if (used + count < 64) {
+                return;
+            }
+            transform(_buffer);
+        }
+        for (; size >= 64; bytes += 64, size -= 64) {
+            transform(bytes);
+        }
+        memcpy(_buffer, bytes, size);
+    }
+
+    // Finishes the hash; the object must not be updated afterwards.
+    Digest digest() {
+        uint8_t padding[72] = { 0x80 };
+        auto bitLength = _length * 8;
+        auto used = (size_t)(_length % 64);
+        auto paddingSize = used < 56 ? 56 - used : 120 - used;
+        for (int i = 0; i < 8; ++i) {
+            padding[paddingSize + i] = (uint8_t)(bitLength >> (8 * i));
+        }
+        update(padding, paddingSize + 8);
+
+        Digest result;
+        for (int i = 0; i < 16; ++i) {
+            result[i] = (uint8_t)(_state[i / 4] >> (8 * (i % 4)));
+        }
+        return result;
+    }
+
+    static std::string toString(const Digest& digest) {
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        for (auto byte : digest) {
+            result += hex[byte >> 4];
+            result += hex[byte & 0xf];
+        }
+        return result;
+    }
+};
+
+}
+
+#endif /* MD5_h */
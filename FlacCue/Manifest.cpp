@@ -0,0 +1,381 @@
+//
+//  Manifest.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Manifest.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Probe.hpp"
+
+namespace cue {
+
+static const std::string ManifestMagic = "FlacCue manifest";
+
+static uint64_t fnv1a(const std::string& data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (auto c : data) {
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static std::string hexString(uint64_t value, int digits) {
+    static const char hex[] = "0123456789abcdef";
+    std::string result(digits, '0');
+    for (auto i = digits - 1; i >= 0; --i, value >>= 4) {
+        result[i] = hex[value & 0xf];
+    }
+    return result;
+}
+
+static uint64_t parseHex(const std::string& string) {
+    if (string.empty() || string.size() > 16 || string.find_first_not_of("0123456789abcdef") != std::string::npos) {
+        throw ManifestError("Invalid hexadecimal number in manifest: '" + string + "'");
+    }
+    return std::stoull(string, nullptr, 16);
+}
+
+static uint64_t parseDecimal(const std::string& string) {
+    if (string.empty() || string.find_first_not_of("-0123456789") != std::string::npos) {
+        throw ManifestError("Invalid number in manifest: '" + string + "'");
+    }
+    return (uint64_t)std::stoll(string);
+}
+
+static flaccue::MD5::Digest parseDigest(const std::string& string) {
+    flaccue::MD5::Digest digest;
+    if (string.size() != 2 * digest.size()) {
+        throw ManifestError("Invalid digest in manifest: '" + string + "'");
+    }
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = (uint8_t)parseHex(string.substr(2 * i, 2));
+    }
+    return digest;
+}
+
+static void appendField(std::string& line, const std::string& field) {
+    if (!line.empty()) {
+        line += '\t';
+    }
+    for (auto c : field) {
+        switch (c) {
+            case '\\': line += "\\\\"; break;
+            case '\t': line += "\\t"; break;
+            case '\n': line += "\\n"; break;
+            default: line += c; break;
+        }
+    }
+}
+
+static std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); ++i) {
+        auto c = line[i];
+        if (c == '\t') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            auto escaped = line[++i];
+            fields.back() += escaped == 't' ? '\t' : escaped == 'n' ? '\n' : escaped;
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+static std::string encode(const AlbumVerification& verification) {
+    std::string line;
+    appendField(line, verification.album);
+    appendField(line, flaccue::MD5::toString(verification.cueSheetDigest));
+    appendField(line, verification.settings);
+    appendField(line, std::to_string(verification.inputs.size()));
+    for (auto& input : verification.inputs) {
+        appendField(line, input.path);
+        appendField(line, std::to_string(input.source.size));
+        appendField(line, std::to_string(input.source.modificationTime));
+        appendField(line, input.streamMD5 ? flaccue::MD5::toString(*input.streamMD5) : "-");
+    }
+    appendField(line, std::to_string(verification.tracks.size()));
+    for (auto& track : verification.tracks) {
+        appendField(line, hexString(track.v1Checksum, 8));
+        appendField(line, track.v1Frame450Checksum ? hexString(*track.v1Frame450Checksum, 8) : "-");
+        appendField(line, hexString(track.v2Checksum, 8));
+        appendField(line, std::to_string(track.accurateRipConfidence));
+    }
+
+    return hexString(fnv1a(line), 16) + " " + line + "\n";
+}
+
+static AlbumVerification decode(const std::string& payload) {
+    auto fields = splitFields(payload);
+    size_t position = 0;
+    auto next = [&]() -> const std::string& {
+        if (position == fields.size()) {
+            throw ManifestError("Truncated manifest record");
+        }
+        return fields[position++];
+    };
+
+    AlbumVerification verification;
+    verification.album = next();
+    verification.cueSheetDigest = parseDigest(next());
+    verification.settings = next();
+    auto numberOfInputs = parseDecimal(next());
+    for (uint64_t i = 0; i < numberOfInputs; ++i) {
+        ManifestInput input;
+        input.path = next();
+        input.source.size = parseDecimal(next());
+        input.source.modificationTime = (int64_t)parseDecimal(next());
+        auto& streamMD5 = next();
+        if (streamMD5 != "-") {
+            input.streamMD5 = parseDigest(streamMD5);
+        }
+        verification.inputs.push_back(std::move(input));
+    }
+    auto numberOfTracks = parseDecimal(next());
+    for (uint64_t i = 0; i < numberOfTracks; ++i) {
+        TrackVerification track;
+        track.v1Checksum = (uint32_t)parseHex(next());
+        auto& v1Frame450Checksum = next();
+        if (v1Frame450Checksum != "-") {
+            track.v1Frame450Checksum = (uint32_t)parseHex(v1Frame450Checksum);
+        }
+        track.v2Checksum = (uint32_t)parseHex(next());
+        track.accurateRipConfidence = (uint32_t)parseDecimal(next());
+        verification.tracks.push_back(track);
+    }
+    if (position != fields.size()) {
+        throw ManifestError("Unexpected fields at the end of a manifest record");
+    }
+    return verification;
+}
+
+static void writeAll(int fileDescriptor, const std::string& data, const std::string& path) {
+    auto bytes = data.data();
+    auto size = data.size();
+    while (size > 0) {
+        auto result = ::write(fileDescriptor, bytes, size);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Failed to write '" + path + "'");
+        }
+        bytes += result;
+        size -= result;
+    }
+}
+
+// Makes a rename in the directory of `path` durable.
+static void syncDirectory(const std::string& path) {
+    auto slash = path.rfind('/');
+    auto directory = slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : path.substr(0, slash);
+    auto fileDescriptor = open(directory.c_str(), O_RDONLY);
+    if (fileDescriptor >= 0) {
+        fsync(fileDescriptor);
+        close(fileDescriptor);
+    }
+}
+
+ManifestInput ManifestInput::Capture(const std::string& path) noexcept(false) {
+    auto source = SourceInfo::Stat(path);
+    if (!source) {
+        throw std::system_error(errno, std::generic_category(), "Failed to stat '" + path + "'");
+    }
+
+    ManifestInput input { path, *source, std::nullopt };
+    static const std::string FLACSuffix = ".flac";
+    if (path.size() >= FLACSuffix.size() && path.compare(path.size() - FLACSuffix.size(), FLACSuffix.size(), FLACSuffix) == 0) {
+        input.streamMD5 = flaccue::probeStreamInfo(path).md5;
+    }
+    return input;
+}
+
+Manifest::Manifest(const std::string& path) noexcept(false)
+: _path(path)
+, _journal(-1) {
+    load();
+    compact();
+    _journal = open(_path.c_str(), O_WRONLY | O_APPEND);
+    if (_journal < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open '" + _path + "'");
+    }
+}
+
+Manifest::Manifest(const std::string& path, ReadOnly) noexcept(false)
+: _path(path)
+, _journal(-1) {
+    load();
+}
+
+Manifest Manifest::OpenReadOnly(const std::string& path) noexcept(false) {
+    return Manifest(path, ReadOnly());
+}
+
+void Manifest::checkWritable() const noexcept(false) {
+    if (_journal < 0) {
+        throw std::logic_error("'" + _path + "' is open read-only");
+    }
+}
+
+Manifest::~Manifest() {
+    if (_journal >= 0) {
+        close(_journal);
+    }
+}
+
+void Manifest::load() noexcept(false) {
+    std::ifstream input(_path, std::ios::binary);
+    if (!input) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw std::system_error(errno, std::generic_category(), "Failed to open '" + _path + "'");
+    }
+
+    std::string line;
+    if (!std::getline(input, line)) {
+        return;
+    }
+    if (line != ManifestMagic + " " + std::to_string(Version)) {
+        throw ManifestError("'" + _path + "' is not a version " + std::to_string(Version) + " manifest");
+    }
+
+    while (std::getline(input, line)) {
+        // Only a line cut short by a crash can fail its hash; it is dropped along with the
+        // album it would have recorded.
+        if (line.size() < 17 || line[16] != ' ') {
+            continue;
+        }
+        auto payload = line.substr(17);
+        if (line.compare(0, 16, hexString(fnv1a(payload), 16)) != 0) {
+            continue;
+        }
+        auto verification = decode(payload);
+        auto album = verification.album;
+        _albums[album] = std::move(verification);
+    }
+}
+
+void Manifest::compact() noexcept(false) {
+    std::string contents = ManifestMagic + " " + std::to_string(Version) + "\n";
+    for (auto& album : _albums) {
+        contents += encode(album.second);
+    }
+
+    auto temporaryPath = _path + ".tmp";
+    auto fileDescriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + temporaryPath + "'");
+    }
+    try {
+        writeAll(fileDescriptor, contents, temporaryPath);
+    } catch (...) {
+        close(fileDescriptor);
+        unlink(temporaryPath.c_str());
+        throw;
+    }
+    if (fsync(fileDescriptor) != 0 || close(fileDescriptor) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to flush '" + temporaryPath + "'");
+    }
+    if (rename(temporaryPath.c_str(), _path.c_str()) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to rename '" + temporaryPath + "'");
+    }
+    syncDirectory(_path);
+}
+
+size_t Manifest::numberOfAlbums() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _albums.size();
+}
+
+std::optional<AlbumVerification> Manifest::find(const std::string& album) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _albums.find(album);
+    if (it == _albums.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<AlbumVerification> Manifest::findUnchanged(const std::string& album, const flaccue::MD5::Digest& cueSheetDigest, const std::string& settings) const {
+    auto verification = find(album);
+    if (!verification || verification->cueSheetDigest != cueSheetDigest || verification->settings != settings) {
+        return std::nullopt;
+    }
+    for (auto& input : verification->inputs) {
+        try {
+            if (ManifestInput::Capture(input.path) != input) {
+                return std::nullopt;
+            }
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    return verification;
+}
+
+void Manifest::record(const AlbumVerification& verification) noexcept(false) {
+    checkWritable();
+    auto line = encode(verification);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto end = lseek(_journal, 0, SEEK_END);
+    try {
+        writeAll(_journal, line, _path);
+    } catch (...) {
+        // A partial line would swallow the next one appended after it.
+        if (end >= 0) {
+            ftruncate(_journal, end);
+        }
+        throw;
+    }
+    if (fsync(_journal) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to flush '" + _path + "'");
+    }
+    _albums[verification.album] = verification;
+}
+
+size_t Manifest::merge(const Manifest& other) noexcept(false) {
+    checkWritable();
+    std::vector<AlbumVerification> albums;
+    {
+        std::lock_guard<std::mutex> lock(other._mutex);
+        for (auto& album : other._albums) {
+            albums.push_back(album.second);
+        }
+    }
+
+    // One compaction instead of an fsync per album; the journal is reopened because the
+    // compacted file replaces it.
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& album : albums) {
+        _albums[album.album] = std::move(album);
+    }
+    close(_journal);
+    _journal = -1;
+    compact();
+    _journal = open(_path.c_str(), O_WRONLY | O_APPEND);
+    if (_journal < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open '" + _path + "'");
+    }
+    return albums.size();
+}
+
+}
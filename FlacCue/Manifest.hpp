@@ -0,0 +1,126 @@
+//
+//  Manifest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Manifest_h
+#define Manifest_h
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DiscSnapshot.hpp"
+#include "MD5.hpp"
+
+namespace cue {
+
+// Persistent record of the albums verified so far, so that later runs can skip the ones
+// whose inputs haven't changed.
+//
+// The file is a journal of text lines. The first line is "FlacCue manifest <version>";
+// every other line is the FNV-1a hash of its payload in hex, a space and the payload: the
+// tab-separated fields of one album, with backslash escapes for tabs, newlines and
+// backslashes. A later line for the same album replaces the earlier ones. Each verified
+// album is appended and fsync'ed on its own; a line torn by a crash fails its hash and is
+// dropped on the next load, which also rewrites the journal compacted, to a temporary file
+// renamed over the old one.
+
+class ManifestError : public std::runtime_error {
+    using runtime_error::runtime_error;
+};
+
+// An input file as it was when its album was verified. FLAC files also keep the MD5 of
+// their audio from STREAMINFO, which catches a file replaced with its size and
+// modification time preserved.
+struct ManifestInput {
+    std::string path;
+    SourceInfo source;
+    std::optional<flaccue::MD5::Digest> streamMD5;
+
+    bool operator==(const ManifestInput& other) const { return path == other.path && source == other.source && streamMD5 == other.streamMD5; }
+    bool operator!=(const ManifestInput& other) const { return !(*this == other); }
+
+    // Stats the file, and probes its STREAMINFO if its name ends in ".flac".
+    static ManifestInput Capture(const std::string& path) noexcept(false);
+};
+
+struct TrackVerification {
+    uint32_t v1Checksum;
+    std::optional<uint32_t> v1Frame450Checksum;
+    uint32_t v2Checksum;
+    // Sum of the AccurateRip counts of the entries matching the track at offset zero;
+    // zero if none does.
+    uint32_t accurateRipConfidence;
+
+    bool operator==(const TrackVerification& other) const {
+        return v1Checksum == other.v1Checksum && v1Frame450Checksum == other.v1Frame450Checksum && v2Checksum == other.v2Checksum && accurateRipConfidence == other.accurateRipConfidence;
+    }
+};
+
+struct AlbumVerification {
+    // The album path as given on the command line.
+    std::string album;
+    // Hash of whatever determines the split: the cue sheet and the names of the files
+    // around it.
+    flaccue::MD5::Digest cueSheetDigest = {};
+    // Options the results depend on; a record made with different ones doesn't count.
+    std::string settings;
+    std::vector<ManifestInput> inputs;
+    std::vector<TrackVerification> tracks;
+};
+
+class Manifest {
+    std::string _path;
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, AlbumVerification> _albums;
+    int _journal; // -1 when read-only
+
+    struct ReadOnly {};
+    Manifest(const std::string& path, ReadOnly) noexcept(false);
+
+    void load() noexcept(false);
+    void compact() noexcept(false);
+    void checkWritable() const noexcept(false);
+
+public:
+    static constexpr uint32_t Version = 1;
+
+    // Loads the manifest if it exists, and leaves it compacted and open for appending.
+    explicit Manifest(const std::string& path) noexcept(false);
+    ~Manifest();
+
+    // Loads the manifest without rewriting it, for reading one that another process may
+    // still be appending to: compacting would replace the file under its open journal and
+    // lose whatever it records afterwards. A read-only manifest can't record or merge.
+    static Manifest OpenReadOnly(const std::string& path) noexcept(false);
+
+    Manifest(const Manifest&) = delete;
+    Manifest& operator=(const Manifest&) = delete;
+
+    size_t numberOfAlbums() const;
+    std::optional<AlbumVerification> find(const std::string& album) const;
+
+    // The record of the album if it was made with the same cue sheet and settings, and
+    // every input still matches what it was. Inputs that can't be captured count as
+    // changed.
+    std::optional<AlbumVerification> findUnchanged(const std::string& album, const flaccue::MD5::Digest& cueSheetDigest, const std::string& settings) const;
+
+    // Appends the record to the journal and waits for it to reach the disk. Thread safe.
+    void record(const AlbumVerification& verification) noexcept(false);
+
+    // Records every album of another manifest, such as one written by another worker of a
+    // sharded scan; its records replace ours. Returns how many there were.
+    size_t merge(const Manifest& other) noexcept(false);
+};
+
+}
+
+#endif /* Manifest_h */
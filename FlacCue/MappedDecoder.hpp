@@ -0,0 +1,144 @@
+//
+//  MappedDecoder.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef MappedDecoder_h
+#define MappedDecoder_h
+
+// Needs libFLAC++, see SplitExecutor.hpp.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+#include <FLAC++/all.h>
+
+#include "MappedFile.hpp"
+
+namespace cue {
+
+// A FLAC::Decoder::Stream serving its reads from a memory mapping of the input instead of
+// stdio: no read syscalls, and the only copy is the one into libFLAC's own buffer. The
+// kernel is told that access is sequential and is asked to read a window ahead of the
+// decoder, so I/O overlaps with decoding. An input truncated while it is decoded aborts
+// the decoding with readError() set, rather than the process with SIGBUS.
+class MappedFLACDecoder : public FLAC::Decoder::Stream {
+public:
+    static constexpr size_t DefaultReadaheadWindow = 8 << 20;
+
+private:
+    std::unique_ptr<flaccue::MappedFile> _file;
+    size_t _position = 0;
+    size_t _readaheadWindow = DefaultReadaheadWindow;
+    size_t _readaheadEnd = SIZE_MAX;
+    size_t _hintedUpTo = 0;
+    std::exception_ptr _readError;
+
+    void readAhead() {
+        if (_readaheadWindow == 0 || _position + _readaheadWindow <= _hintedUpTo) {
+            return;
+        }
+        auto begin = std::max(_position, _hintedUpTo);
+        auto end = std::min(_readaheadEnd, _position + 2 * _readaheadWindow);
+        if (end > begin) {
+            _file->willNeed(begin, end - begin);
+            _hintedUpTo = end;
+        }
+    }
+
+protected:
+    virtual ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t *bytes) override {
+        auto count = std::min(*bytes, _file->size() - _position);
+        if (count == 0) {
+            *bytes = 0;
+            return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+        }
+        readAhead();
+        try {
+            _file->copy(_position, count, buffer);
+        } catch (...) {
+            _readError = std::current_exception();
+            *bytes = 0;
+            return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+        }
+        _position += count;
+        *bytes = count;
+        return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+    }
+
+    virtual ::FLAC__StreamDecoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset) override {
+        if (absolute_byte_offset > _file->size()) {
+            return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+        }
+        _position = (size_t)absolute_byte_offset;
+        _hintedUpTo = _position;
+        return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+    }
+
+    virtual ::FLAC__StreamDecoderTellStatus tell_callback(FLAC__uint64 *absolute_byte_offset) override {
+        *absolute_byte_offset = _position;
+        return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+    }
+
+    virtual ::FLAC__StreamDecoderLengthStatus length_callback(FLAC__uint64 *stream_length) override {
+        *stream_length = _file->size();
+        return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+    }
+
+    virtual bool eof_callback() override {
+        return _position >= _file->size();
+    }
+
+public:
+    using FLAC::Decoder::Stream::init;
+
+    // Finishes while the mapping is still there.
+    ~MappedFLACDecoder() {
+        FLAC::Decoder::Stream::finish();
+    }
+
+    // Maps `path` and initializes the decoder. Throws if the file can't be mapped.
+    ::FLAC__StreamDecoderInitStatus init(const std::string& path) noexcept(false) {
+        _file = std::make_unique<flaccue::MappedFile>(path);
+        _file->adviseSequential();
+        _position = 0;
+        _hintedUpTo = 0;
+        _readError = nullptr;
+        return FLAC::Decoder::Stream::init();
+    }
+
+    virtual bool finish() override {
+        auto result = FLAC::Decoder::Stream::finish();
+        _file.reset();
+        return result;
+    }
+
+    // Readahead keeps `window` bytes in front of the decoder and stops at `end`, e.g. the
+    // end of the part of the file a split needs. A window of 0 turns it off.
+    void setReadahead(size_t window, size_t end = SIZE_MAX) {
+        _readaheadWindow = window;
+        _readaheadEnd = end;
+    }
+
+    // What made the last read fail, if anything did.
+    std::exception_ptr readError() const { return _readError; }
+
+    // Reads back bytes of the input, such as an encoded frame. Valid between init() and
+    // finish(); throws like reads do.
+    void copyInput(size_t offset, size_t length, std::vector<uint8_t>& destination) const noexcept(false) {
+        destination.resize(length);
+        _file->copy(offset, length, destination.data());
+    }
+    size_t mappedSize() const { return _file ? _file->size() : 0; }
+};
+
+}
+
+#endif /* MappedDecoder_h */
@@ -0,0 +1,118 @@
+//
+//  MappedFile.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "MappedFile.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <signal.h>
+
+namespace flaccue {
+
+// A mapping being read under guard() on some thread; they nest.
+struct GuardedRange {
+    const uint8_t* begin;
+    size_t size;
+    volatile sig_atomic_t didFault;
+    GuardedRange* previous;
+};
+
+static thread_local GuardedRange* guardedRanges = nullptr;
+static struct sigaction previousBusErrorAction;
+static uintptr_t pageSize;
+
+static void handleBusError(int signal, siginfo_t* info, void* context) {
+    auto address = (const uint8_t*)info->si_addr;
+    for (auto range = guardedRanges; range != nullptr; range = range->previous) {
+        if (address < range->begin || address >= range->begin + range->size) {
+            continue;
+        }
+        // Puts a page of zeros where the file ends now, so the faulting read carries on
+        // (with garbage) and returns normally; guard() throws once it is done. Jumping out
+        // of the handler instead would skip the destructors of the code doing the read.
+        auto page = (void*)((uintptr_t)address / pageSize * pageSize);
+        if (mmap(page, pageSize, PROT_READ, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            range->didFault = 1;
+            return;
+        }
+        break;
+    }
+    // Not from a guarded read: put back whatever handled it before and fault again on return.
+    sigaction(SIGBUS, &previousBusErrorAction, nullptr);
+}
+
+static void installBusErrorHandler() {
+    pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleBusError;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGBUS, &action, &previousBusErrorAction) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to install the SIGBUS handler");
+    }
+}
+
+namespace {
+
+// Registers a mapping with the SIGBUS handler for as long as it is in scope.
+class BusErrorGuard {
+    GuardedRange _range;
+
+public:
+    BusErrorGuard(const uint8_t* data, size_t size) : _range { data, size, 0, guardedRanges } {
+        static std::once_flag isHandlerInstalled;
+        std::call_once(isHandlerInstalled, installBusErrorHandler);
+        guardedRanges = &_range;
+    }
+
+    BusErrorGuard(const BusErrorGuard&) = delete;
+    BusErrorGuard& operator=(const BusErrorGuard&) = delete;
+
+    ~BusErrorGuard() {
+        guardedRanges = _range.previous;
+    }
+
+    bool didFault() const { return _range.didFault != 0; }
+};
+
+}
+
+void MappedFile::guard(const std::function<void()>& read) const noexcept(false) {
+    if (!_isTruncated) {
+        BusErrorGuard guard(_data, _size);
+        try {
+            read();
+        } catch (...) {
+            if (guard.didFault()) {
+                _isTruncated = true;
+            }
+            throw;
+        }
+        if (guard.didFault()) {
+            _isTruncated = true;
+        }
+    }
+    if (_isTruncated) {
+        throw std::system_error(EIO, std::generic_category(), "'" + _path + "' was truncated while being read");
+    }
+}
+
+void MappedFile::copy(size_t offset, size_t length, void* destination) const noexcept(false) {
+    if (offset > _size || length > _size - offset) {
+        throw std::out_of_range("Reading past the end of '" + _path + "'");
+    }
+    if (length == 0) {
+        return;
+    }
+    guard([&]() {
+        memcpy(destination, _data + offset, length);
+    });
+}
+
+}
@@ -0,0 +1,129 @@
+//
+//  MappedFile.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef MappedFile_h
+#define MappedFile_h
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace flaccue {
+
+// Asks the kernel to start reading [offset, offset + length) of an open file into the page
+// cache without waiting for it. Best effort: platforms without a way to do it ignore it.
+inline void adviseWillNeed(int fileDescriptor, size_t offset, size_t length) {
+#if defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fileDescriptor, (off_t)offset, (off_t)length, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+    struct radvisory advisory;
+    advisory.ra_offset = (off_t)offset;
+    advisory.ra_count = (int)std::min<size_t>(length, INT_MAX);
+    fcntl(fileDescriptor, F_RDADVISE, &advisory);
+#endif
+}
+
+// Read-only memory mapping of a whole file.
+//
+// Touching a page of the mapping that the file no longer has, because it was truncated
+// while mapped, raises SIGBUS and would take the whole process down. Whatever can be read
+// while the file changes underneath (audio input, say) is read inside guard() or through
+// copy(), which turn that into an exception about the one file instead.
+class MappedFile {
+    std::string _path;
+    int _fileDescriptor;
+    const uint8_t* _data;
+    size_t _size;
+    // Set once a guarded read faulted; the missing pages read as zeros from then on.
+    mutable std::atomic<bool> _isTruncated;
+
+public:
+    explicit MappedFile(const std::string& path) noexcept(false)
+    : _path(path)
+    , _fileDescriptor(-1)
+    , _data(nullptr)
+    , _size(0)
+    , _isTruncated(false) {
+        _fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (_fileDescriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open '" + path + "'");
+        }
+
+        struct stat fileStat;
+        if (fstat(_fileDescriptor, &fileStat) != 0) {
+            auto error = errno;
+            close(_fileDescriptor);
+            throw std::system_error(error, std::generic_category(), "Failed to stat '" + path + "'");
+        }
+        _size = (size_t)fileStat.st_size;
+
+        if (_size > 0) {
+            auto data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fileDescriptor, 0);
+            if (data == MAP_FAILED) {
+                auto error = errno;
+                close(_fileDescriptor);
+                throw std::system_error(error, std::generic_category(), "Failed to map '" + path + "'");
+            }
+            _data = (const uint8_t*)data;
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (_data != nullptr) {
+            munmap((void*)_data, _size);
+        }
+        close(_fileDescriptor);
+    }
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+    // Runs `read`, which may touch any part of the mapping, and throws a system_error (EIO)
+    // after it returns if the file turned out to be truncated, i.e. if it got a SIGBUS.
+    // `read` must cope with seeing zeros where the data was missing.
+    void guard(const std::function<void()>& read) const noexcept(false);
+
+    // Copies [offset, offset + length) out of the mapping, under guard().
+    void copy(size_t offset, size_t length, void* destination) const noexcept(false);
+    int fileDescriptor() const { return _fileDescriptor; }
+
+    // Access pattern hints; both are best effort and never fail.
+    void adviseSequential() const {
+        if (_data != nullptr) {
+            madvise((void*)_data, _size, MADV_SEQUENTIAL);
+        }
+    }
+
+    // Starts reading [offset, offset + length) into the page cache in the background.
+    void willNeed(size_t offset, size_t length) const {
+        if (offset >= _size || length == 0) {
+            return;
+        }
+        length = std::min(length, _size - offset);
+
+        auto pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        auto pageBegin = offset / pageSize * pageSize;
+        madvise((void*)(_data + pageBegin), length + (offset - pageBegin), MADV_WILLNEED);
+        adviseWillNeed(_fileDescriptor, offset, length);
+    }
+};
+
+}
+
+#endif /* MappedFile_h */
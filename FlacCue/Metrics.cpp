@@ -0,0 +1,221 @@
+//
+//  Metrics.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Metrics.hpp"
+
+#include <cstdio>
+#include <system_error>
+#include <errno.h>
+#include <time.h>
+
+namespace flaccue {
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Probe: return "probe";
+        case Stage::Parse: return "parse";
+        case Stage::Decode: return "decode";
+        case Stage::Checksum: return "checksum";
+        case Stage::Encode: return "encode";
+        case Stage::Fetch: return "fetch";
+        case Stage::Report: return "report";
+    }
+    return "unknown";
+}
+
+int64_t threadCPUNanoseconds() {
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// The stages the calling thread works for, innermost first.
+static thread_local StageScope* stageScopes = nullptr;
+
+StageScope::StageScope(const StageAccount& account) : _account(account), _outer(stageScopes) {
+    stageScopes = this;
+}
+
+StageScope::~StageScope() {
+    for (auto scope = &stageScopes; *scope != nullptr; scope = &(*scope)->_outer) {
+        if (*scope == this) {
+            *scope = _outer;
+            return;
+        }
+    }
+}
+
+StageAccount currentStageAccount() {
+    return stageScopes ? stageScopes->_account : StageAccount();
+}
+
+bool isInStage(const StageAccount& account) {
+    for (auto scope = stageScopes; scope != nullptr; scope = scope->_outer) {
+        if (scope->_account.metrics == account.metrics && scope->_account.stage == account.stage) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The length of the UTF-8 sequence starting at `bytes`, or 0 if it isn't a valid one:
+// truncated, overlong, a surrogate or beyond U+10FFFF.
+static size_t utf8SequenceLength(const uint8_t* bytes, size_t available) {
+    static const uint32_t minimumCodePoint[] = { 0, 0, 0x80, 0x800, 0x10000 };
+
+    size_t length;
+    uint32_t codePoint;
+    if (bytes[0] < 0x80) {
+        return 1;
+    } else if ((bytes[0] & 0xE0) == 0xC0) {
+        length = 2;
+        codePoint = bytes[0] & 0x1F;
+    } else if ((bytes[0] & 0xF0) == 0xE0) {
+        length = 3;
+        codePoint = bytes[0] & 0x0F;
+    } else if ((bytes[0] & 0xF8) == 0xF0) {
+        length = 4;
+        codePoint = bytes[0] & 0x07;
+    } else {
+        return 0;
+    }
+    if (length > available) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (bytes[i] & 0x3F);
+    }
+    if (codePoint < minimumCodePoint[length] || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+std::string jsonString(const std::string& string) {
+    std::string result = "\"";
+    for (size_t i = 0; i < string.size(); ) {
+        auto c = string[i];
+        if ((uint8_t)c >= 0x80) {
+            // Paths needn't be UTF-8; bytes that aren't would make the whole line invalid.
+            auto length = utf8SequenceLength((const uint8_t*)string.data() + i, string.size() - i);
+            if (length == 0) {
+                result += "\\ufffd";
+                ++i;
+            } else {
+                result.append(string, i, length);
+                i += length;
+            }
+            continue;
+        }
+        ++i;
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if ((uint8_t)c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)(uint8_t)c);
+                    result += escaped;
+                } else {
+                    result += c;
+                }
+                break;
+        }
+    }
+    return result + "\"";
+}
+
+void Metrics::add(Stage stage, const StageTotals& totals) {
+    auto& counters = _stages[(size_t)stage];
+    counters.wallNanoseconds.fetch_add(totals.wallNanoseconds, std::memory_order_relaxed);
+    counters.cpuNanoseconds.fetch_add(totals.cpuNanoseconds, std::memory_order_relaxed);
+    counters.bytes.fetch_add(totals.bytes, std::memory_order_relaxed);
+    counters.samples.fetch_add(totals.samples, std::memory_order_relaxed);
+    counters.calls.fetch_add(totals.calls, std::memory_order_relaxed);
+}
+
+void Metrics::add(const Metrics& other) {
+    for (size_t stage = 0; stage < NumberOfStages; ++stage) {
+        add((Stage)stage, other.totals((Stage)stage));
+    }
+}
+
+StageTotals Metrics::totals(Stage stage) const {
+    auto& counters = _stages[(size_t)stage];
+    StageTotals totals;
+    totals.wallNanoseconds = counters.wallNanoseconds.load(std::memory_order_relaxed);
+    totals.cpuNanoseconds = counters.cpuNanoseconds.load(std::memory_order_relaxed);
+    totals.bytes = counters.bytes.load(std::memory_order_relaxed);
+    totals.samples = counters.samples.load(std::memory_order_relaxed);
+    totals.calls = counters.calls.load(std::memory_order_relaxed);
+    return totals;
+}
+
+void Metrics::writeJSON(std::ostream& output) const {
+    output << "{";
+    bool isFirst = true;
+    for (size_t stage = 0; stage < NumberOfStages; ++stage) {
+        auto stageTotals = totals((Stage)stage);
+        if (stageTotals.calls == 0) {
+            continue;
+        }
+        output << (isFirst ? "" : ",") << jsonString(stageName((Stage)stage)) << ":{"
+        << "\"wallSeconds\":" << stageTotals.wallNanoseconds / 1e9
+        << ",\"cpuSeconds\":" << stageTotals.cpuNanoseconds / 1e9
+        << ",\"bytes\":" << stageTotals.bytes
+        << ",\"samples\":" << stageTotals.samples
+        << ",\"calls\":" << stageTotals.calls
+        << "}";
+        isFirst = false;
+    }
+    output << "}";
+}
+
+MetricsReport::MetricsReport(const std::string& path) noexcept(false)
+: _output(path, std::ios::app)
+, _albums(0)
+, _failed(0)
+, _start(std::chrono::steady_clock::now()) {
+    if (!_output) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open '" + path + "'");
+    }
+}
+
+void MetricsReport::addAlbum(const std::string& album, bool succeeded, std::chrono::steady_clock::duration wallTime, const Metrics& metrics) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _batch.add(metrics);
+    ++_albums;
+    _failed += succeeded ? 0 : 1;
+
+    _output << "{\"type\":\"album\",\"album\":" << jsonString(album)
+    << ",\"succeeded\":" << (succeeded ? "true" : "false")
+    << ",\"wallSeconds\":" << std::chrono::duration<double>(wallTime).count()
+    << ",\"stages\":";
+    metrics.writeJSON(_output);
+    _output << "}" << std::endl;
+}
+
+void MetricsReport::finish() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _output << "{\"type\":\"batch\",\"albums\":" << _albums
+    << ",\"failed\":" << _failed
+    << ",\"wallSeconds\":" << std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count()
+    << ",\"stages\":";
+    _batch.writeJSON(_output);
+    _output << "}" << std::endl;
+}
+
+}
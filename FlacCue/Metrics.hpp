@@ -0,0 +1,205 @@
+//
+//  Metrics.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace flaccue {
+
+enum class Stage : size_t {
+    Probe,
+    Parse,
+    Decode,
+    Checksum,
+    Encode,
+    Fetch,
+    Report,
+};
+
+constexpr size_t NumberOfStages = (size_t)Stage::Report + 1;
+
+const char* stageName(Stage stage);
+
+// CPU time used by the calling thread so far.
+int64_t threadCPUNanoseconds();
+
+// The string quoted and escaped for JSON. Bytes that aren't part of valid UTF-8 become
+// U+FFFD.
+std::string jsonString(const std::string& string);
+
+struct StageTotals {
+    int64_t wallNanoseconds = 0;
+    int64_t cpuNanoseconds = 0;
+    uint64_t bytes = 0;
+    uint64_t samples = 0;
+    uint64_t calls = 0;
+};
+
+// Time spent and work done per stage. Wall time is measured by the thread driving a
+// stage, so a stage that drives another one (decoding feeds the checksums) includes its
+// wall time, and so does its CPU time when both run on the same thread. CPU time also
+// covers the pool tasks and threads doing the stage's work (see StageCPUTimer), so it can
+// exceed the wall time. Thread safe: adding is a handful of relaxed atomic additions.
+class Metrics {
+    struct Counters {
+        std::atomic<int64_t> wallNanoseconds{0};
+        std::atomic<int64_t> cpuNanoseconds{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> calls{0};
+    };
+    Counters _stages[NumberOfStages];
+
+public:
+    void add(Stage stage, const StageTotals& totals);
+    void add(const Metrics& other);
+    StageTotals totals(Stage stage) const;
+
+    // {"probe":{"wallSeconds":...,"cpuSeconds":...,"bytes":...,"samples":...,"calls":...},...}
+    // Stages that never ran are left out.
+    void writeJSON(std::ostream& output) const;
+};
+
+// The stage a thread is working for, if any.
+struct StageAccount {
+    Metrics* metrics = nullptr;
+    Stage stage = Stage::Probe;
+};
+
+// One of the stages a thread is working for, kept in a per-thread list while in scope.
+class StageScope {
+    StageAccount _account;
+    StageScope* _outer;
+
+    friend StageAccount currentStageAccount();
+    friend bool isInStage(const StageAccount& account);
+
+public:
+    explicit StageScope(const StageAccount& account);
+    StageScope(const StageScope&) = delete;
+    StageScope& operator=(const StageScope&) = delete;
+    // Scopes needn't end in reverse order, e.g. when a timer kept by a sink outlives the
+    // one of the stage feeding it during unwinding.
+    ~StageScope();
+};
+
+// The innermost stage the calling thread is working for. Pool tasks and threads started on
+// behalf of a stage take it along and run under a StageCPUTimer for it.
+StageAccount currentStageAccount();
+
+// Whether the calling thread's CPU time already goes to the stage.
+bool isInStage(const StageAccount& account);
+
+// Adds the CPU time the calling thread spends from its construction to its destruction to
+// a stage running on another thread, without counting a call or any wall time. Does nothing
+// on a thread that already counts its time for that stage, such as one running the tasks it
+// waits for itself.
+class StageCPUTimer {
+    StageAccount _account;
+    std::optional<StageScope> _scope;
+    int64_t _cpuStart;
+
+public:
+    explicit StageCPUTimer(const StageAccount& account) : _cpuStart(0) {
+        if (account.metrics && !isInStage(account)) {
+            _account = account;
+            _scope.emplace(account);
+            _cpuStart = threadCPUNanoseconds();
+        }
+    }
+
+    StageCPUTimer(const StageCPUTimer&) = delete;
+    StageCPUTimer& operator=(const StageCPUTimer&) = delete;
+
+    ~StageCPUTimer() {
+        if (_account.metrics) {
+            StageTotals totals;
+            totals.cpuNanoseconds = threadCPUNanoseconds() - _cpuStart;
+            _account.metrics->add(_account.stage, totals);
+        }
+    }
+};
+
+// Measures the wall and thread CPU time from its construction to its destruction, and adds
+// them to a stage along with the bytes and samples it was told about. With no metrics to
+// add to it doesn't even read the clocks.
+class StageTimer {
+    Metrics* _metrics;
+    Stage _stage;
+    std::optional<StageScope> _scope;
+    std::chrono::steady_clock::time_point _start;
+    int64_t _cpuStart;
+    uint64_t _bytes;
+    uint64_t _samples;
+
+public:
+    StageTimer(Metrics* metrics, Stage stage)
+    : _metrics(metrics)
+    , _stage(stage)
+    , _cpuStart(0)
+    , _bytes(0)
+    , _samples(0) {
+        if (_metrics) {
+            _scope.emplace(StageAccount { metrics, stage });
+            _start = std::chrono::steady_clock::now();
+            _cpuStart = threadCPUNanoseconds();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        if (_metrics) {
+            StageTotals totals;
+            totals.wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+            totals.cpuNanoseconds = threadCPUNanoseconds() - _cpuStart;
+            totals.bytes = _bytes;
+            totals.samples = _samples;
+            totals.calls = 1;
+            _metrics->add(_stage, totals);
+        }
+    }
+
+    void addBytes(uint64_t bytes) { _bytes += bytes; }
+    void addSamples(uint64_t samples) { _samples += samples; }
+};
+
+// Writes one JSON object per line: a record per album as it finishes, and one for the
+// whole batch when finished. Thread safe.
+//
+//   {"type":"album","album":"...","succeeded":true,"wallSeconds":1.5,"stages":{...}}
+//   {"type":"batch","albums":10,"failed":1,"wallSeconds":12.5,"stages":{...}}
+class MetricsReport {
+    std::mutex _mutex;
+    std::ofstream _output;
+    Metrics _batch;
+    size_t _albums;
+    size_t _failed;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    // Appends to the file if it exists.
+    explicit MetricsReport(const std::string& path) noexcept(false);
+
+    void addAlbum(const std::string& album, bool succeeded, std::chrono::steady_clock::duration wallTime, const Metrics& metrics);
+    void finish();
+};
+
+}
+
+#endif /* Metrics_h */
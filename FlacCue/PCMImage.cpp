@@ -0,0 +1,121 @@
+//
+//  PCMImage.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "PCMImage.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace flaccue {
+
+static const size_t RIFFHeaderSize = 12;
+static const size_t ChunkHeaderSize = 8;
+static const size_t FormatChunkSize = 16;
+static const size_t ExtensibleFormatChunkSize = 40;
+static const uint16_t WaveFormatPCM = 0x0001;
+static const uint16_t WaveFormatExtensible = 0xFFFE;
+
+static uint32_t readLittleEndian(const uint8_t* data, int bytes) {
+    uint32_t value = 0;
+    for (auto i = bytes - 1; i >= 0; --i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+// Whether a chunk starts at `offset`: an identifier of printable characters and a size
+// that fits in the file.
+static bool isChunkAt(const uint8_t* data, size_t size, size_t offset) {
+    if (offset + ChunkHeaderSize > size) {
+        return false;
+    }
+    if (!std::all_of(data + offset, data + offset + 4, [](uint8_t c) { return c >= 0x20 && c <= 0x7E; })) {
+        return false;
+    }
+    return readLittleEndian(data + offset + 4, 4) <= size - offset - ChunkHeaderSize;
+}
+
+PCMImage::Kind PCMImage::kindForFileType(const std::string& fileType) noexcept(false) {
+    if (fileType == "WAVE") {
+        return Kind::WAVE;
+    } else if (fileType == "BINARY") {
+        return Kind::RawLittleEndianCDDA;
+    } else if (fileType == "MOTOROLA") {
+        return Kind::RawBigEndianCDDA;
+    }
+    throw PCMImageError("Unsupported file type: " + fileType);
+}
+
+PCMImage::PCMImage(const std::string& path, Kind kind) noexcept(false)
+: _file(path)
+, _sampleRate(44100)
+, _channels(2)
+, _bitsPerSample(16)
+, _isBigEndian(kind == Kind::RawBigEndianCDDA)
+, _dataOffset(0)
+, _dataSize(_file.size()) {
+    if (kind == Kind::WAVE) {
+        parseWAVE(path);
+    }
+    _dataSize -= _dataSize % bytesPerSample();
+}
+
+void PCMImage::parseWAVE(const std::string& path) {
+    auto data = _file.data();
+    auto size = _file.size();
+    if (size < RIFFHeaderSize || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        throw PCMImageError("'" + path + "' is not a RIFF/WAVE file");
+    }
+
+    bool hasFormat = false;
+    for (size_t offset = RIFFHeaderSize; offset + ChunkHeaderSize <= size; ) {
+        auto chunk = data + offset;
+        auto chunkSize = (size_t)readLittleEndian(chunk + 4, 4);
+        auto body = offset + ChunkHeaderSize;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkSize < FormatChunkSize || body + chunkSize > size) {
+                throw PCMImageError("'" + path + "' has a truncated format chunk");
+            }
+            auto format = (uint16_t)readLittleEndian(data + body, 2);
+            if (format == WaveFormatExtensible) {
+                // The sub-format GUID starts with the format tag it stands for.
+                if (chunkSize < ExtensibleFormatChunkSize) {
+                    throw PCMImageError("'" + path + "' has a truncated format chunk");
+                }
+                format = (uint16_t)readLittleEndian(data + body + 24, 2);
+            }
+            if (format != WaveFormatPCM) {
+                throw PCMImageError("'" + path + "' is not integer PCM");
+            }
+            _channels = readLittleEndian(data + body + 2, 2);
+            _sampleRate = readLittleEndian(data + body + 4, 4);
+            _bitsPerSample = readLittleEndian(data + body + 14, 2);
+            if (_channels == 0 || _bitsPerSample == 0 || _bitsPerSample > 32) {
+                throw PCMImageError("'" + path + "' has an invalid format");
+            }
+            hasFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!hasFormat) {
+                throw PCMImageError("'" + path + "' has no format chunk before its data");
+            }
+            // Streamed WAVs leave the size at 0xFFFFFFFF, or at 0 with nothing but audio
+            // after it; the data runs to the end. A 0 followed by another chunk is just an
+            // empty data chunk.
+            auto isStreamed = chunkSize == UINT32_MAX || (chunkSize == 0 && !isChunkAt(data, size, body));
+            _dataOffset = body;
+            _dataSize = isStreamed ? size - body : std::min(chunkSize, size - body);
+            return;
+        }
+
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+    throw PCMImageError("'" + path + "' has no data chunk");
+}
+
+}
@@ -0,0 +1,83 @@
+//
+//  PCMImage.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PCMImage_h
+#define PCMImage_h
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "MappedFile.hpp"
+
+namespace flaccue {
+
+class PCMImageError : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+// Uncompressed audio read in place from a memory mapping: a RIFF/WAVE file (plain PCM or
+// WAVE_FORMAT_EXTENSIBLE), or a headerless CD image. Samples are interleaved and
+// little-endian, except in big-endian raw images.
+class PCMImage {
+public:
+    enum class Kind {
+        WAVE,                 // RIFF/WAVE
+        RawLittleEndianCDDA,  // cue sheet FILE type BINARY
+        RawBigEndianCDDA,     // cue sheet FILE type MOTOROLA
+    };
+
+    static Kind kindForFileType(const std::string& fileType) noexcept(false);
+
+private:
+    MappedFile _file;
+    uint32_t _sampleRate;
+    uint32_t _channels;
+    uint32_t _bitsPerSample;
+    bool _isBigEndian;
+    size_t _dataOffset;
+    size_t _dataSize;
+
+    void parseWAVE(const std::string& path);
+
+public:
+    PCMImage(const std::string& path, Kind kind) noexcept(false);
+
+    uint32_t sampleRate() const { return _sampleRate; }
+    uint32_t channels() const { return _channels; }
+    uint32_t bitsPerSample() const { return _bitsPerSample; }
+    bool isBigEndian() const { return _isBigEndian; }
+    size_t bytesPerSample() const { return _channels * ((_bitsPerSample + 7) / 8); }
+
+    // 44.1 kHz 16-bit stereo, the only format AccurateRip checksums.
+    bool isCDDA() const { return _sampleRate == 44100 && _channels == 2 && _bitsPerSample == 16; }
+
+    // The audio, trimmed to whole samples.
+    const uint8_t* data() const { return _file.data() + _dataOffset; }
+    uint64_t numberOfSamples() const { return _dataSize / bytesPerSample(); }
+
+    // Runs `read` over data(); see MappedFile::guard().
+    void guard(const std::function<void()>& read) const noexcept(false) { _file.guard(read); }
+
+    // Copies `count` samples from `sample` on, throwing instead of faulting if the file was
+    // truncated since it was opened.
+    void copySamples(uint64_t sample, uint32_t count, uint8_t* destination) const noexcept(false) {
+        _file.copy(_dataOffset + sample * bytesPerSample(), count * bytesPerSample(), destination);
+    }
+
+    // Where the audio is in the file, for copying it without going through the mapping.
+    int fileDescriptor() const { return _file.fileDescriptor(); }
+    size_t dataOffset() const { return _dataOffset; }
+
+    void adviseSequential() const { _file.adviseSequential(); }
+};
+
+}
+
+#endif /* PCMImage_h */
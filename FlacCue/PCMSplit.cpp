@@ -0,0 +1,247 @@
+//
+//  PCMSplit.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "PCMSplit.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#endif
+
+#include "Trace.hpp"
+
+namespace flaccue {
+
+static const size_t CopyBufferSize = 1 << 20;
+
+static void copyWithBuffer(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) {
+    std::vector<uint8_t> buffer(std::min(length, CopyBufferSize));
+    while (length > 0) {
+        TraceScope trace("copy", "encode");
+        auto result = pread(inputFileDescriptor, buffer.data(), std::min(length, buffer.size()), inputOffset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw std::system_error(result < 0 ? errno : EIO, std::generic_category(), "Error while reading a split segment");
+        }
+        for (size_t done = 0; done < (size_t)result; ) {
+            auto written = pwrite(outputFileDescriptor, buffer.data() + done, result - done, outputOffset + (off_t)done);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0) {
+                throw std::system_error(errno, std::generic_category(), "Error while writing a split segment");
+            }
+            done += written;
+        }
+        inputOffset += result;
+        outputOffset += result;
+        length -= result;
+    }
+}
+
+// Copies as much as copy_file_range agrees to, returning how much that was.
+static size_t copyInKernel(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) {
+    size_t done = 0;
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    while (done < length) {
+        loff_t input = inputOffset + (off_t)done;
+        loff_t output = outputOffset + (off_t)done;
+        auto result = copy_file_range(inputFileDescriptor, &input, outputFileDescriptor, &output, length - done, 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        done += result;
+    }
+#endif
+    return done;
+}
+
+static void copyBytes(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) {
+    auto done = copyInKernel(inputFileDescriptor, inputOffset, outputFileDescriptor, outputOffset, length);
+    if (done < length) {
+        copyWithBuffer(inputFileDescriptor, inputOffset + (off_t)done, outputFileDescriptor, outputOffset + (off_t)done, length - done);
+    }
+}
+
+// Makes the output share the input's blocks; both ranges have to be block aligned.
+static bool cloneRange(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) {
+#if defined(__linux__) && defined(FICLONERANGE)
+    struct file_clone_range range;
+    range.src_fd = inputFileDescriptor;
+    range.src_offset = (uint64_t)inputOffset;
+    range.src_length = (uint64_t)length;
+    range.dest_offset = (uint64_t)outputOffset;
+    return ioctl(outputFileDescriptor, FICLONERANGE, &range) == 0;
+#else
+    return false;
+#endif
+}
+
+void copyFileRange(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) noexcept(false) {
+    struct stat inputStat;
+    if (fstat(inputFileDescriptor, &inputStat) == 0 && inputStat.st_blksize > 0) {
+        auto blockSize = (size_t)inputStat.st_blksize;
+        if ((size_t)inputOffset % blockSize == (size_t)outputOffset % blockSize) {
+            auto head = std::min(length, (blockSize - (size_t)inputOffset % blockSize) % blockSize);
+            auto aligned = (length - head) / blockSize * blockSize;
+            if (aligned > 0 && cloneRange(inputFileDescriptor, inputOffset + (off_t)head, outputFileDescriptor, outputOffset + (off_t)head, aligned)) {
+                copyBytes(inputFileDescriptor, inputOffset, outputFileDescriptor, outputOffset, head);
+                auto tail = (off_t)(head + aligned);
+                copyBytes(inputFileDescriptor, inputOffset + tail, outputFileDescriptor, outputOffset + tail, length - head - aligned);
+                return;
+            }
+        }
+    }
+    copyBytes(inputFileDescriptor, inputOffset, outputFileDescriptor, outputOffset, length);
+}
+
+}
+
+namespace cue {
+
+static const size_t WaveHeaderSize = 44;
+static const size_t ChunkHeaderSize = 8;
+// Aligning the data only pays off if the first segment spans this many blocks.
+static const size_t MinimumClonedBlocks = 16;
+
+static void appendLittleEndian(uint32_t value, int bytes, std::string& output) {
+    for (auto i = 0; i < bytes; ++i) {
+        output += (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+struct CopiedRange {
+    const flaccue::PCMImage* image;
+    off_t offset;
+    size_t length;
+};
+
+PCMSplitWriter::PCMSplitWriter(const Split& split, InputImageHandler inputImageHandler, OutputPathHandler outputPathHandler)
+: _split(split)
+, _inputImageHandler(inputImageHandler)
+, _outputPathHandler(outputPathHandler) {}
+
+void PCMSplitWriter::write(size_t output) const noexcept(false) {
+    auto& splitOutput = _split.outputFiles.at(output);
+    auto path = _outputPathHandler(splitOutput.outputFile);
+
+    std::vector<CopiedRange> ranges;
+    const flaccue::PCMImage* format = nullptr;
+    uint64_t dataSize = 0;
+    for (auto& segment : splitOutput.inputSegments) {
+        auto& image = _inputImageHandler(segment.inputFile);
+        if (image.isBigEndian()) {
+            throw std::runtime_error("'" + segment.inputFile + "' is big-endian, it can't be copied into a WAV file");
+        }
+        if (format && (format->sampleRate() != image.sampleRate() || format->channels() != image.channels() || format->bitsPerSample() != image.bitsPerSample())) {
+            throw std::runtime_error("'" + splitOutput.outputFile + "' would mix audio formats");
+        }
+        format = &image;
+
+        auto end = segment.end ? segment.end->samples : (long long)image.numberOfSamples();
+        if (segment.begin.samples > end || end > (long long)image.numberOfSamples()) {
+            throw std::runtime_error("'" + segment.inputFile + "' ends at " + to_string(Time((long long)image.numberOfSamples())) + ", before the end of a split segment");
+        }
+        auto length = (size_t)(end - segment.begin.samples) * image.bytesPerSample();
+        ranges.push_back(CopiedRange { &image, (off_t)(image.dataOffset() + segment.begin.samples * image.bytesPerSample()), length });
+        dataSize += length;
+    }
+    if (!format) {
+        throw std::runtime_error("'" + splitOutput.outputFile + "' has no input segments");
+    }
+
+    auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Error while creating '" + path + "'");
+    }
+
+    try {
+        size_t dataOffset = WaveHeaderSize;
+        struct stat outputStat;
+        if (fstat(fd, &outputStat) == 0 && outputStat.st_blksize > 0) {
+            auto blockSize = (size_t)outputStat.st_blksize;
+            auto target = (size_t)ranges.front().offset % blockSize;
+            if (ranges.front().length >= MinimumClonedBlocks * blockSize && target % 2 == 0) {
+                while (dataOffset % blockSize != target || (dataOffset > WaveHeaderSize && dataOffset < WaveHeaderSize + ChunkHeaderSize)) {
+                    dataOffset += 2;
+                }
+            }
+        }
+        if (dataOffset + dataSize - ChunkHeaderSize > UINT32_MAX) {
+            throw std::runtime_error("'" + path + "' would be too large for a WAV file");
+        }
+
+        std::string header = "RIFF";
+        appendLittleEndian((uint32_t)(dataOffset + dataSize - ChunkHeaderSize), 4, header);
+        header += "WAVEfmt ";
+        appendLittleEndian(16, 4, header);
+        appendLittleEndian(1, 2, header); // integer PCM
+        appendLittleEndian(format->channels(), 2, header);
+        appendLittleEndian(format->sampleRate(), 4, header);
+        appendLittleEndian((uint32_t)(format->sampleRate() * format->bytesPerSample()), 4, header);
+        appendLittleEndian((uint32_t)format->bytesPerSample(), 2, header);
+        appendLittleEndian(format->bitsPerSample(), 2, header);
+        if (dataOffset > WaveHeaderSize) {
+            auto junkSize = dataOffset - WaveHeaderSize - ChunkHeaderSize;
+            header += "JUNK";
+            appendLittleEndian((uint32_t)junkSize, 4, header);
+            header.append(junkSize, '\0');
+        }
+        header += "data";
+        appendLittleEndian((uint32_t)dataSize, 4, header);
+
+        for (size_t done = 0; done < header.size(); ) {
+            auto result = pwrite(fd, header.data() + done, header.size() - done, (off_t)done);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                throw std::system_error(errno, std::generic_category(), "Error while writing '" + path + "'");
+            }
+            done += result;
+        }
+
+        auto outputOffset = (off_t)dataOffset;
+        for (auto& range : ranges) {
+            flaccue::copyFileRange(range.image->fileDescriptor(), range.offset, fd, outputOffset, range.length);
+            outputOffset += (off_t)range.length;
+        }
+        auto result = close(fd);
+        fd = -1;
+        if (result != 0) {
+            throw std::system_error(errno, std::generic_category(), "Error while closing '" + path + "'");
+        }
+    } catch (...) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw;
+    }
+}
+
+void PCMSplitWriter::writeAll() const noexcept(false) {
+    for (size_t output = 0; output < _split.outputFiles.size(); ++output) {
+        write(output);
+    }
+}
+
+}
@@ -0,0 +1,55 @@
+//
+//  PCMSplit.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PCMSplit_h
+#define PCMSplit_h
+
+#include <functional>
+#include <string>
+#include <sys/types.h>
+
+#include "CueParse.hpp"
+#include "PCMImage.hpp"
+
+namespace flaccue {
+
+// Copies `length` bytes between two files without bringing them into userspace where the
+// platform allows: ranges at the same offset within a filesystem block share their
+// aligned blocks (FICLONERANGE), the rest goes through copy_file_range. Elsewhere, and on
+// filesystems refusing both, it falls back to pread/pwrite.
+void copyFileRange(int inputFileDescriptor, off_t inputOffset, int outputFileDescriptor, off_t outputOffset, size_t length) noexcept(false);
+
+}
+
+namespace cue {
+
+// Splits uncompressed inputs into WAV files: a RIFF header, then every input segment of
+// the output copied over as it is. The header is padded with a JUNK chunk so that the
+// first segment lands at the same offset within a filesystem block as in its input,
+// which lets a reflink-capable filesystem share the blocks instead of copying them.
+class PCMSplitWriter {
+public:
+    using InputImageHandler = std::function<const flaccue::PCMImage&(const std::string& inputFile)>;
+    using OutputPathHandler = std::function<std::string(const std::string& outputFile)>;
+
+private:
+    const Split& _split;
+    InputImageHandler _inputImageHandler;
+    OutputPathHandler _outputPathHandler;
+
+public:
+    PCMSplitWriter(const Split& split, InputImageHandler inputImageHandler, OutputPathHandler outputPathHandler);
+
+    // Inputs have to be little-endian and share their format.
+    void write(size_t output) const noexcept(false);
+    void writeAll() const noexcept(false);
+};
+
+}
+
+#endif /* PCMSplit_h */
@@ -0,0 +1,195 @@
+//
+//  Pipeline.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Pipeline_h
+#define Pipeline_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace flaccue {
+
+// Spins briefly, then yields, then sleeps; used while waiting on the other end of a queue.
+class Backoff {
+    unsigned _iteration = 0;
+
+public:
+    void wait() {
+        if (_iteration < 64) {
+            // busy wait
+        } else if (_iteration < 1024) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        ++_iteration;
+    }
+};
+
+// Bounded lock-free queue for exactly one producer and one consumer thread. push() and
+// pop() wait while the queue is full or empty, which gives backpressure between stages.
+template<typename T> class SPSCQueue {
+    std::vector<T> _slots;
+    alignas(64) std::atomic<size_t> _head; // next slot to read, owned by the consumer
+    alignas(64) std::atomic<size_t> _tail; // next slot to write, owned by the producer
+
+public:
+    explicit SPSCQueue(size_t capacity) : _slots(capacity + 1), _head(0), _tail(0) {
+        if (capacity == 0) {
+            throw std::invalid_argument("SPSCQueue capacity must be positive");
+        }
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    size_t capacity() const { return _slots.size() - 1; }
+
+    bool tryPush(const T& value) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        auto next = tail + 1 == _slots.size() ? 0 : tail + 1;
+        if (next == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _slots[tail] = value;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(_slots[head]);
+        _head.store(head + 1 == _slots.size() ? 0 : head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T& value) {
+        Backoff backoff;
+        while (!tryPush(value)) {
+            backoff.wait();
+        }
+    }
+
+    T pop() {
+        T value;
+        Backoff backoff;
+        while (!tryPop(value)) {
+            backoff.wait();
+        }
+        return value;
+    }
+};
+
+// A fixed-capacity run of planar samples, shared by several consumers. It goes back to
+// its pool once every consumer has released it.
+class SampleBlock {
+    friend class SampleBlockPool;
+
+public:
+    static const unsigned MaxChannels = 8;
+
+private:
+    std::vector<int32_t> _samples;
+    std::vector<uint8_t> _encoded;
+    const int32_t* _channels[MaxChannels];
+    uint32_t _capacity;
+    uint32_t _count = 0;
+    unsigned _numberOfChannels = 0;
+    std::atomic<unsigned> _references;
+
+public:
+    explicit SampleBlock(uint32_t capacity) : _capacity(capacity), _references(0) {}
+
+    const int32_t* const* channels() const { return _channels; }
+    unsigned numberOfChannels() const { return _numberOfChannels; }
+    uint32_t count() const { return _count; }
+    uint32_t capacity() const { return _capacity; }
+    const uint8_t* encoded() const { return _encoded.data(); }
+    size_t encodedSize() const { return _encoded.size(); }
+
+    // Copies `count` (at most capacity()) samples of every channel, and optionally the
+    // encoded bytes they were decoded from.
+    void assign(const int32_t* const buffer[], unsigned numberOfChannels, uint32_t count, const uint8_t* encoded = nullptr, size_t encodedSize = 0) {
+        if (numberOfChannels > MaxChannels || count > _capacity) {
+            throw std::length_error("Samples don't fit in the block");
+        }
+        if (_samples.size() < numberOfChannels * (size_t)_capacity) {
+            _samples.resize(numberOfChannels * (size_t)_capacity);
+        }
+        for (unsigned channel = 0; channel < numberOfChannels; ++channel) {
+            auto destination = _samples.data() + channel * (size_t)_capacity;
+            std::copy(buffer[channel], buffer[channel] + count, destination);
+            _channels[channel] = destination;
+        }
+        _numberOfChannels = numberOfChannels;
+        _count = count;
+        _encoded.assign(encoded, encoded + encodedSize);
+    }
+};
+
+// Preallocated SampleBlocks. acquire() waits while all of them are in flight, which bounds
+// the memory a pipeline can use.
+class SampleBlockPool {
+    std::vector<std::unique_ptr<SampleBlock>> _blocks;
+    std::vector<SampleBlock*> _free;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+
+public:
+    SampleBlockPool(size_t numberOfBlocks, uint32_t samplesPerBlock) {
+        _blocks.reserve(numberOfBlocks);
+        _free.reserve(numberOfBlocks);
+        for (size_t i = 0; i < numberOfBlocks; ++i) {
+            _blocks.push_back(std::make_unique<SampleBlock>(samplesPerBlock));
+            _free.push_back(_blocks.back().get());
+        }
+    }
+
+    SampleBlockPool(const SampleBlockPool&) = delete;
+    SampleBlockPool& operator=(const SampleBlockPool&) = delete;
+
+    uint32_t samplesPerBlock() const { return _blocks.empty() ? 0 : _blocks.front()->capacity(); }
+
+    // The block comes back to the pool after `references` calls to release().
+    SampleBlock* acquire(unsigned references) {
+        if (references == 0) {
+            throw std::invalid_argument("A SampleBlock needs at least one reference");
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&]() { return !_free.empty(); });
+        auto block = _free.back();
+        _free.pop_back();
+        block->_references.store(references, std::memory_order_relaxed);
+        return block;
+    }
+
+    void release(SampleBlock* block) {
+        if (block->_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _free.push_back(block);
+            }
+            _condition.notify_one();
+        }
+    }
+};
+
+}
+
+#endif /* Pipeline_h */
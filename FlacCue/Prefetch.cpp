@@ -0,0 +1,140 @@
+//
+//  Prefetch.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Prefetch.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "MappedFile.hpp"
+
+namespace flaccue {
+
+Prefetcher::Prefetcher(size_t budget)
+: _budget(budget)
+, _outstanding(0) {}
+
+void Prefetcher::pump() {
+    while (!_queue.empty() && _outstanding < _budget) {
+        auto& pending = _queue.front();
+        auto fd = open(pending.path.c_str(), O_RDONLY);
+        struct stat fileStat;
+        if (fd < 0 || fstat(fd, &fileStat) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            _queue.pop_front();
+            continue;
+        }
+
+        pending.size = (size_t)fileStat.st_size;
+        auto length = std::min(pending.size - std::min(pending.offset, pending.size), _budget - _outstanding);
+        if (length > 0) {
+            adviseWillNeed(fd, pending.offset, length);
+            pending.offset += length;
+            _outstanding += length;
+            _issued[pending.path] += length;
+        }
+        close(fd);
+
+        if (pending.offset >= pending.size) {
+            _queue.pop_front();
+        }
+    }
+}
+
+void Prefetcher::enqueue(const std::string& path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto isQueued = std::any_of(_queue.cbegin(), _queue.cend(), [&](const Pending& pending) {
+        return pending.path == path;
+    });
+    if (isQueued || _issued.count(path) != 0) {
+        return;
+    }
+    _queue.push_back(Pending { path, 0, 0 });
+    pump();
+}
+
+void Prefetcher::enqueue(const std::vector<std::string>& paths) {
+    for (auto& path : paths) {
+        enqueue(path);
+    }
+}
+
+void Prefetcher::release(const std::string& path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [&](const Pending& pending) {
+        return pending.path == path;
+    }), _queue.end());
+
+    auto issued = _issued.find(path);
+    if (issued != _issued.end()) {
+        _outstanding -= issued->second;
+        _issued.erase(issued);
+    }
+    pump();
+}
+
+void Prefetcher::releaseDirectory(const std::string& directory) {
+    auto isInDirectory = [&](const std::string& path) {
+        return path.size() > directory.size() + 1
+            && path.compare(0, directory.size(), directory) == 0
+            && path[directory.size()] == '/'
+            && path.find('/', directory.size() + 1) == std::string::npos;
+    };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [&](const Pending& pending) {
+        return isInDirectory(pending.path);
+    }), _queue.end());
+    for (auto issued = _issued.begin(); issued != _issued.end(); ) {
+        if (isInDirectory(issued->first)) {
+            _outstanding -= issued->second;
+            issued = _issued.erase(issued);
+        } else {
+            ++issued;
+        }
+    }
+    pump();
+}
+
+size_t Prefetcher::outstandingBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _outstanding;
+}
+
+void PrefetchRelease::release() {
+    for (auto& path : _paths) {
+        _prefetcher.release(path);
+    }
+    for (auto& directory : _directories) {
+        _prefetcher.releaseDirectory(directory);
+    }
+    _paths.clear();
+    _directories.clear();
+}
+
+}
+
+namespace cue {
+
+std::vector<std::string> splitInputFiles(const Split& split) {
+    std::vector<std::string> result;
+    for (auto& output : split.outputFiles) {
+        for (auto& segment : output.inputSegments) {
+            if (std::find(result.cbegin(), result.cend(), segment.inputFile) == result.cend()) {
+                result.push_back(segment.inputFile);
+            }
+        }
+    }
+    return result;
+}
+
+}
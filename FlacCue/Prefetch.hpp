@@ -0,0 +1,94 @@
+//
+//  Prefetch.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Prefetch_h
+#define Prefetch_h
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CueParse.hpp"
+
+namespace flaccue {
+
+// Gets files into the page cache before they are opened, in the order they are going to
+// be read, so the disk works while the CPU decodes the file before. Readahead is issued
+// with posix_fadvise (F_RDADVISE on macOS), which returns without waiting for the data.
+// At most `budget` bytes are prefetched for files nobody has started reading yet; once a
+// file is released its share goes to the next ones in line. Thread safe.
+class Prefetcher {
+public:
+    static constexpr size_t DefaultBudget = 256 << 20;
+
+private:
+    struct Pending {
+        std::string path;
+        size_t offset;
+        size_t size;
+    };
+
+    mutable std::mutex _mutex;
+    size_t _budget;
+    size_t _outstanding;
+    std::deque<Pending> _queue;
+    std::unordered_map<std::string, size_t> _issued;
+
+    void pump();
+
+public:
+    explicit Prefetcher(size_t budget = DefaultBudget);
+
+    // Files already queued or prefetched are skipped; ones that can't be opened too.
+    void enqueue(const std::string& path);
+    void enqueue(const std::vector<std::string>& paths);
+
+    // The file is being read now (or won't be at all): it stops counting against the budget
+    // and is dropped from the queue.
+    void release(const std::string& path);
+    // Every file queued or prefetched directly in the directory, such as the guessed files
+    // of an album that got skipped.
+    void releaseDirectory(const std::string& directory);
+
+    size_t outstandingBytes() const;
+};
+
+// Releases files and directories from a Prefetcher when destroyed, so that whichever way
+// the reading of an album ends (finished, skipped or failed) its share of the budget comes
+// back. Without that, prefetching stops for good once the budget has leaked away.
+class PrefetchRelease {
+    Prefetcher& _prefetcher;
+    std::vector<std::string> _paths;
+    std::vector<std::string> _directories;
+
+public:
+    explicit PrefetchRelease(Prefetcher& prefetcher) : _prefetcher(prefetcher) {}
+    ~PrefetchRelease() { release(); }
+
+    PrefetchRelease(const PrefetchRelease&) = delete;
+    PrefetchRelease& operator=(const PrefetchRelease&) = delete;
+
+    void add(const std::vector<std::string>& paths) { _paths.insert(_paths.end(), paths.begin(), paths.end()); }
+    void addDirectory(const std::string& directory) { _directories.push_back(directory); }
+
+    // Releases everything added so far, before the end of the scope.
+    void release();
+};
+
+}
+
+namespace cue {
+
+// The input files of a split in the order it reads them, each once.
+std::vector<std::string> splitInputFiles(const Split& split);
+
+}
+
+#endif /* Prefetch_h */
@@ -0,0 +1,84 @@
+//
+//  Probe.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Probe.hpp"
+
+#include <cstring>
+#include <system_error>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace flaccue {
+
+static const size_t ID3v2HeaderSize = 10;
+
+static size_t readAt(int fd, uint8_t* buffer, size_t size, off_t offset, const std::string& path) {
+    size_t done = 0;
+    while (done < size) {
+        auto result = pread(fd, buffer + done, size - done, offset + (off_t)done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            throw std::system_error(errno, std::generic_category(), "Error while reading '" + path + "'");
+        }
+        if (result == 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+StreamInfo probeStreamInfo(const std::string& path) noexcept(false) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Error while opening '" + path + "'");
+    }
+
+    try {
+        uint8_t header[StreamInfoHeaderSize];
+        auto size = readAt(fd, header, sizeof(header), 0, path);
+
+        if (size >= ID3v2HeaderSize && memcmp(header, "ID3", 3) == 0) {
+            // The tag size is stored in four 7-bit bytes, excluding the header and the
+            // optional footer.
+            off_t offset = ID3v2HeaderSize +
+                (((off_t)header[6] & 0x7F) << 21 | ((off_t)header[7] & 0x7F) << 14 | ((off_t)header[8] & 0x7F) << 7 | ((off_t)header[9] & 0x7F));
+            if (header[5] & 0x10) {
+                offset += ID3v2HeaderSize;
+            }
+            size = readAt(fd, header, sizeof(header), offset, path);
+        }
+
+        auto streamInfo = parseStreamInfoHeader(header, size);
+        close(fd);
+        return streamInfo;
+    } catch (const FrameError& e) {
+        close(fd);
+        throw FrameError("'" + path + "': " + e.what());
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+std::vector<StreamInfo> probeStreamInfos(const std::vector<std::string>& paths, ThreadPool& pool) noexcept(false) {
+    std::vector<StreamInfo> result(paths.size());
+    TaskGroup tasks(pool);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        tasks.run([&, i]() {
+            result[i] = probeStreamInfo(paths[i]);
+        });
+    }
+    tasks.wait();
+    return result;
+}
+
+}
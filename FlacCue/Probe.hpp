@@ -0,0 +1,31 @@
+//
+//  Probe.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Probe_h
+#define Probe_h
+
+#include <string>
+#include <vector>
+
+#include "FlacFrame.hpp"
+#include "ThreadPool.hpp"
+
+namespace flaccue {
+
+// Reads the STREAMINFO of a FLAC file with a single pread of its first bytes, leaving the
+// rest of the metadata (embedded pictures and the like) alone. An ID3v2 tag in front of
+// the stream, which some taggers add, costs one more read.
+StreamInfo probeStreamInfo(const std::string& path) noexcept(false);
+
+// Probes every file on the pool; the results are in the order of `paths`. Rethrows the
+// first error once all probes have finished.
+std::vector<StreamInfo> probeStreamInfos(const std::vector<std::string>& paths, ThreadPool& pool) noexcept(false);
+
+}
+
+#endif /* Probe_h */
@@ -0,0 +1,240 @@
+//
+//  Prometheus.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Prometheus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <system_error>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace flaccue {
+
+static bool isValidName(const std::string& name) {
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':';
+    });
+}
+
+// Integers as such, so counters don't turn into 1.234e+09.
+static std::string formatValue(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    char formatted[32];
+    if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) {
+        snprintf(formatted, sizeof(formatted), "%.0f", value);
+    } else {
+        snprintf(formatted, sizeof(formatted), "%.17g", value);
+    }
+    return formatted;
+}
+
+static std::string formatLabels(const PrometheusMetrics::Labels& labels) {
+    std::string result;
+    for (auto& label : labels) {
+        if (!isValidName(label.first) || label.first.find(':') != std::string::npos) {
+            throw PrometheusError("Invalid Prometheus label name: '" + label.first + "'");
+        }
+        result += (result.empty() ? "" : ",") + label.first + "=\"";
+        for (auto c : label.second) {
+            switch (c) {
+                case '\\': result += "\\\\"; break;
+                case '"': result += "\\\""; break;
+                case '\n': result += "\\n"; break;
+                default: result += c; break;
+            }
+        }
+        result += "\"";
+    }
+    return result;
+}
+
+// `name{labels,extra}`, leaving out the braces when there are no labels at all.
+static std::string seriesName(const std::string& name, const std::string& labels, const std::string& extra = "") {
+    auto all = labels.empty() ? extra : extra.empty() ? labels : labels + "," + extra;
+    return all.empty() ? name : name + "{" + all + "}";
+}
+
+std::vector<double> exponentialBuckets(double start, double factor, size_t count) {
+    std::vector<double> bounds;
+    for (auto bound = start; bounds.size() < count; bound *= factor) {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+void PrometheusMetrics::declare(const std::string& name, Type type, const std::string& help, std::vector<double> bounds) noexcept(false) {
+    if (!isValidName(name)) {
+        throw PrometheusError("Invalid Prometheus metric name: '" + name + "'");
+    }
+    if (!std::is_sorted(bounds.begin(), bounds.end())) {
+        throw PrometheusError("The buckets of '" + name + "' aren't sorted");
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_families.emplace(name, Family { type, help, std::move(bounds), {} }).second) {
+        throw PrometheusError("'" + name + "' is declared twice");
+    }
+}
+
+void PrometheusMetrics::declareCounter(const std::string& name, const std::string& help) noexcept(false) {
+    declare(name, Type::Counter, help, {});
+}
+
+void PrometheusMetrics::declareGauge(const std::string& name, const std::string& help) noexcept(false) {
+    declare(name, Type::Gauge, help, {});
+}
+
+void PrometheusMetrics::declareHistogram(const std::string& name, const std::string& help, std::vector<double> bounds) noexcept(false) {
+    declare(name, Type::Histogram, help, std::move(bounds));
+}
+
+PrometheusMetrics::Series& PrometheusMetrics::series(const std::string& name, Type type, const Labels& labels) noexcept(false) {
+    auto family = _families.find(name);
+    if (family == _families.end() || family->second.type != type) {
+        throw PrometheusError("'" + name + "' isn't declared as a metric of this type");
+    }
+    auto& series = family->second.series[formatLabels(labels)];
+    if (type == Type::Histogram && series.buckets.empty()) {
+        series.buckets.resize(family->second.bounds.size() + 1);
+    }
+    return series;
+}
+
+void PrometheusMetrics::increment(const std::string& name, double value, const Labels& labels) noexcept(false) {
+    if (value < 0) {
+        throw PrometheusError("Counters can't decrease: '" + name + "'");
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    series(name, Type::Counter, labels).value += value;
+}
+
+void PrometheusMetrics::set(const std::string& name, double value, const Labels& labels) noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    series(name, Type::Gauge, labels).value = value;
+}
+
+void PrometheusMetrics::add(const std::string& name, double delta, const Labels& labels) noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    series(name, Type::Gauge, labels).value += delta;
+}
+
+void PrometheusMetrics::observe(const std::string& name, double value, const Labels& labels) noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& histogram = series(name, Type::Histogram, labels);
+    auto& bounds = _families.at(name).bounds;
+    auto bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+    ++histogram.buckets[bucket];
+    histogram.value += value;
+    ++histogram.count;
+}
+
+void PrometheusMetrics::write(std::ostream& output) const {
+    static const char* typeNames[] = { "counter", "gauge", "histogram" };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& family : _families) {
+        auto& name = family.first;
+        output << "# HELP " << name << " " << family.second.help << "\n";
+        output << "# TYPE " << name << " " << typeNames[(int)family.second.type] << "\n";
+        for (auto& series : family.second.series) {
+            auto& labels = series.first;
+            if (family.second.type != Type::Histogram) {
+                output << seriesName(name, labels) << " " << formatValue(series.second.value) << "\n";
+                continue;
+            }
+            uint64_t cumulative = 0;
+            auto& bounds = family.second.bounds;
+            for (size_t bucket = 0; bucket <= bounds.size(); ++bucket) {
+                cumulative += series.second.buckets[bucket];
+                auto bound = bucket < bounds.size() ? bounds[bucket] : INFINITY;
+                output << seriesName(name + "_bucket", labels, "le=\"" + formatValue(bound) + "\"") << " " << cumulative << "\n";
+            }
+            output << seriesName(name + "_sum", labels) << " " << formatValue(series.second.value) << "\n";
+            output << seriesName(name + "_count", labels) << " " << series.second.count << "\n";
+        }
+    }
+}
+
+PrometheusTextfile::PrometheusTextfile(const std::string& path, const PrometheusMetrics& metrics, std::chrono::steady_clock::duration interval) noexcept(false)
+: _metrics(metrics)
+, _path(path)
+, _interval(std::max<std::chrono::steady_clock::duration>(interval, std::chrono::seconds(1)))
+, _isStopping(false) {
+    write();
+    _writer = std::thread(&PrometheusTextfile::writeLoop, this);
+}
+
+PrometheusTextfile::~PrometheusTextfile() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _stopCondition.notify_all();
+    _writer.join();
+    try {
+        write();
+    } catch (const std::exception&) {
+    }
+}
+
+void PrometheusTextfile::writeLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopCondition.wait_for(lock, _interval, [&]() { return _isStopping; })) {
+        lock.unlock();
+        try {
+            write();
+        } catch (const std::exception&) {
+        }
+        lock.lock();
+    }
+}
+
+void PrometheusTextfile::write() noexcept(false) {
+    std::ostringstream contents;
+    _metrics.write(contents);
+    auto data = contents.str();
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    // The collector only reads *.prom files, so it never sees the temporary one.
+    auto temporaryPath = _path + "." + std::to_string(getpid()) + ".tmp";
+    auto fileDescriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + temporaryPath + "'");
+    }
+    for (size_t done = 0; done < data.size(); ) {
+        auto result = ::write(fileDescriptor, data.data() + done, data.size() - done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            auto error = errno;
+            close(fileDescriptor);
+            unlink(temporaryPath.c_str());
+            throw std::system_error(error, std::generic_category(), "Failed to write '" + temporaryPath + "'");
+        }
+        done += result;
+    }
+    if (close(fileDescriptor) != 0 || rename(temporaryPath.c_str(), _path.c_str()) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to replace '" + _path + "'");
+    }
+}
+
+}
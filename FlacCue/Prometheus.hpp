@@ -0,0 +1,106 @@
+//
+//  Prometheus.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Prometheus_h
+#define Prometheus_h
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace flaccue {
+
+class PrometheusError : public std::logic_error {
+public:
+    explicit PrometheusError(const std::string& what) : std::logic_error(what) {}
+};
+
+// `count` upper bounds for a histogram, starting at `start` and growing by `factor`.
+std::vector<double> exponentialBuckets(double start, double factor, size_t count);
+
+// Counters, gauges and histograms in the Prometheus text exposition format. Metrics are
+// declared once up front; each distinct set of labels is a series of its own, created when
+// first updated. Thread safe. Updates take a lock, so they belong to per-album bookkeeping
+// rather than inner loops.
+class PrometheusMetrics {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        double value = 0; // or the sum of the observations
+        std::vector<uint64_t> buckets; // per bucket, not cumulative; the last one is +Inf
+        uint64_t count = 0;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<double> bounds;
+        std::map<std::string, Series> series; // by formatted labels
+    };
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Family> _families;
+
+    void declare(const std::string& name, Type type, const std::string& help, std::vector<double> bounds) noexcept(false);
+    Series& series(const std::string& name, Type type, const Labels& labels) noexcept(false);
+
+public:
+    void declareCounter(const std::string& name, const std::string& help) noexcept(false);
+    void declareGauge(const std::string& name, const std::string& help) noexcept(false);
+    void declareHistogram(const std::string& name, const std::string& help, std::vector<double> bounds) noexcept(false);
+
+    // Throw PrometheusError for metrics that weren't declared with the same type.
+    void increment(const std::string& name, double value = 1, const Labels& labels = {}) noexcept(false);
+    void set(const std::string& name, double value, const Labels& labels = {}) noexcept(false);
+    void add(const std::string& name, double delta, const Labels& labels = {}) noexcept(false); // to a gauge
+    void observe(const std::string& name, double value, const Labels& labels = {}) noexcept(false);
+
+    void write(std::ostream& output) const;
+};
+
+// Keeps a .prom file for node_exporter's textfile collector up to date: writes the metrics
+// when constructed, every interval after that, and once more when destroyed. Each write
+// goes to a temporary file that is renamed over the previous one, so the collector never
+// reads half a file. A failed periodic write is retried at the next interval; since the
+// file's age is exported by the collector, it still shows up in monitoring.
+class PrometheusTextfile {
+    const PrometheusMetrics& _metrics;
+    std::string _path;
+    std::chrono::steady_clock::duration _interval;
+    std::mutex _mutex;
+    std::mutex _writeMutex;
+    std::condition_variable _stopCondition;
+    bool _isStopping;
+    std::thread _writer;
+
+    void writeLoop();
+
+public:
+    PrometheusTextfile(const std::string& path, const PrometheusMetrics& metrics, std::chrono::steady_clock::duration interval) noexcept(false);
+    ~PrometheusTextfile();
+
+    PrometheusTextfile(const PrometheusTextfile&) = delete;
+    PrometheusTextfile& operator=(const PrometheusTextfile&) = delete;
+
+    void write() noexcept(false);
+};
+
+}
+
+#endif /* Prometheus_h */
@@ -0,0 +1,251 @@
+//
+//  SampleSource.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "SampleSource.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cue {
+
+static const size_t MaximumChannels = 8;
+static const size_t WriteBufferSize = 1 << 20;
+
+void deinterleave(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count, int32_t* const buffer[]) noexcept(false) {
+    auto bytes = (format.bitsPerSample + 7) / 8;
+    if (bytes < 1 || bytes > 4) {
+        throw std::invalid_argument("Unsupported sample size: " + std::to_string(format.bitsPerSample) + " bits");
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        for (unsigned channel = 0; channel < format.channels; ++channel) {
+            uint32_t value = 0;
+            for (unsigned byte = 0; byte < bytes; ++byte) {
+                auto shift = isBigEndian ? 8 * (bytes - 1 - byte) : 8 * byte;
+                value |= (uint32_t)data[byte] << shift;
+            }
+            if (bytes == 1) {
+                buffer[channel][i] = (int32_t)value - 128;
+            } else {
+                // Sign-extends from the top of the stored bytes.
+                buffer[channel][i] = (int32_t)(value << (32 - 8 * bytes)) >> (32 - 8 * bytes);
+            }
+            data += bytes;
+        }
+    }
+}
+
+uint32_t SampleSource::read(int32_t* const buffer[], uint32_t capacity) noexcept(false) {
+    auto view = borrow(capacity);
+    if (view.channels) {
+        for (unsigned channel = 0; channel < format().channels; ++channel) {
+            std::copy(view.channels[channel], view.channels[channel] + view.count, buffer[channel]);
+        }
+    } else if (view.interleaved) {
+        view.guard([&]() {
+            deinterleave(view.interleaved, format(), view.isBigEndian, view.count, buffer);
+        });
+    }
+    return view.count;
+}
+
+void SampleSink::processInterleaved(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count) {
+    if (format.channels > MaximumChannels) {
+        throw std::invalid_argument("Too many channels: " + std::to_string(format.channels));
+    }
+    _scratch.resize(format.channels * (size_t)count);
+    int32_t* channels[MaximumChannels];
+    for (unsigned channel = 0; channel < format.channels; ++channel) {
+        channels[channel] = _scratch.data() + channel * (size_t)count;
+    }
+    deinterleave(data, format, isBigEndian, count, channels);
+    process(channels, format.channels, count);
+}
+
+uint64_t copySamples(SampleSource& source, SampleSink& sink, uint64_t count, uint32_t blockSize) noexcept(false) {
+    uint64_t done = 0;
+    while (done < count) {
+        auto view = source.borrow((uint32_t)std::min<uint64_t>(blockSize, count - done));
+        if (view.count == 0) {
+            break;
+        }
+        if (view.channels) {
+            sink.process(view.channels, source.format().channels, view.count);
+        } else {
+            view.guard([&]() {
+                sink.processInterleaved(view.interleaved, source.format(), view.isBigEndian, view.count);
+            });
+        }
+        done += view.count;
+    }
+    return done;
+}
+
+void copySplitOutput(const Split& split, size_t output, const SampleSourceHandler& sources, SampleSink& sink, uint32_t blockSize) noexcept(false) {
+    auto& segments = split.outputFiles.at(output).inputSegments;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        auto& segment = segments[i];
+        auto& source = sources(segment.inputFile);
+        if (i == 0) {
+            sink.begin(source.format());
+        }
+
+        auto begin = (uint64_t)segment.begin.samples;
+        auto end = segment.end ? (uint64_t)segment.end->samples : source.numberOfSamples();
+        source.seek(begin);
+        if (end < begin || copySamples(source, sink, end - begin, blockSize) != end - begin) {
+            throw std::runtime_error("'" + segment.inputFile + "' ends before the end of a split segment");
+        }
+    }
+    sink.end();
+}
+
+PCMSampleSource::PCMSampleSource(const flaccue::PCMImage& image)
+: _image(image)
+, _format { image.sampleRate(), image.channels(), image.bitsPerSample() }
+, _position(0) {}
+
+void PCMSampleSource::seek(uint64_t sample) noexcept(false) {
+    if (sample > _image.numberOfSamples()) {
+        throw std::out_of_range("Seeking past the end of the audio");
+    }
+    _position = sample;
+}
+
+SampleView PCMSampleSource::borrow(uint32_t maxCount) noexcept(false) {
+    SampleView view;
+    view.count = (uint32_t)std::min<uint64_t>(maxCount, _image.numberOfSamples() - _position);
+    view.interleaved = _image.data() + _position * _image.bytesPerSample();
+    view.isBigEndian = _image.isBigEndian();
+    view.image = &_image;
+    _position += view.count;
+    return view;
+}
+
+PCMFileSampleSink::PCMFileSampleSink(const std::string& path, bool writesWaveHeader)
+: _path(path)
+, _writesWaveHeader(writesWaveHeader)
+, _fileDescriptor(-1)
+, _format { 0, 0, 0 }
+, _dataSize(0) {}
+
+PCMFileSampleSink::~PCMFileSampleSink() {
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+}
+
+void PCMFileSampleSink::write(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        auto result = ::write(_fileDescriptor, data, size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            throw std::system_error(errno, std::generic_category(), "Error while writing '" + _path + "'");
+        }
+        data += result;
+        size -= result;
+    }
+}
+
+void PCMFileSampleSink::flush() {
+    write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+}
+
+static void appendLittleEndian(uint32_t value, unsigned bytes, std::vector<uint8_t>& output) {
+    for (unsigned i = 0; i < bytes; ++i) {
+        output.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void appendTag(const char* tag, std::vector<uint8_t>& output) {
+    output.insert(output.end(), tag, tag + strlen(tag));
+}
+
+// The canonical 44-byte header; begin() writes it with a zero size, end() with the real one.
+static std::vector<uint8_t> waveHeader(const StreamFormat& format, uint64_t dataSize) {
+    auto blockAlign = format.channels * ((format.bitsPerSample + 7) / 8);
+    std::vector<uint8_t> header;
+    appendTag("RIFF", header);
+    appendLittleEndian((uint32_t)(36 + dataSize), 4, header);
+    appendTag("WAVEfmt ", header);
+    appendLittleEndian(16, 4, header);
+    appendLittleEndian(1, 2, header);
+    appendLittleEndian(format.channels, 2, header);
+    appendLittleEndian(format.sampleRate, 4, header);
+    appendLittleEndian(format.sampleRate * blockAlign, 4, header);
+    appendLittleEndian(blockAlign, 2, header);
+    appendLittleEndian(format.bitsPerSample, 2, header);
+    appendTag("data", header);
+    appendLittleEndian((uint32_t)dataSize, 4, header);
+    return header;
+}
+
+void PCMFileSampleSink::begin(const StreamFormat& format) {
+    _format = format;
+    _fileDescriptor = open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fileDescriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Error while creating '" + _path + "'");
+    }
+    _buffer.reserve(WriteBufferSize);
+    if (_writesWaveHeader) {
+        _buffer = waveHeader(format, 0);
+    }
+}
+
+void PCMFileSampleSink::process(const int32_t* const buffer[], unsigned channels, uint32_t count) {
+    auto bytes = (_format.bitsPerSample + 7) / 8;
+    for (uint32_t i = 0; i < count; ++i) {
+        for (unsigned channel = 0; channel < channels; ++channel) {
+            auto value = (uint32_t)buffer[channel][i] + (bytes == 1 ? 128 : 0);
+            appendLittleEndian(value, bytes, _buffer);
+        }
+        if (_buffer.size() >= WriteBufferSize) {
+            flush();
+        }
+    }
+    _dataSize += count * (uint64_t)channels * bytes;
+}
+
+void PCMFileSampleSink::processInterleaved(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count) {
+    if (isBigEndian || format.channels != _format.channels || format.bitsPerSample != _format.bitsPerSample) {
+        SampleSink::processInterleaved(data, format, isBigEndian, count);
+        return;
+    }
+    auto size = count * (size_t)format.channels * ((format.bitsPerSample + 7) / 8);
+    flush();
+    write(data, size);
+    _dataSize += size;
+}
+
+void PCMFileSampleSink::end() {
+    flush();
+    if (_writesWaveHeader) {
+        if (_dataSize > UINT32_MAX - 36) {
+            throw std::runtime_error("'" + _path + "' is too large for a WAV file");
+        }
+        auto header = waveHeader(_format, _dataSize);
+        if (pwrite(_fileDescriptor, header.data(), header.size(), 0) != (ssize_t)header.size()) {
+            throw std::system_error(errno ? errno : EIO, std::generic_category(), "Error while writing '" + _path + "'");
+        }
+    }
+    auto result = close(_fileDescriptor);
+    _fileDescriptor = -1;
+    if (result != 0) {
+        throw std::system_error(errno, std::generic_category(), "Error while closing '" + _path + "'");
+    }
+}
+
+}
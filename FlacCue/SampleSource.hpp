@@ -0,0 +1,140 @@
+//
+//  SampleSource.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef SampleSource_h
+#define SampleSource_h
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CueParse.hpp"
+#include "PCMImage.hpp"
+
+namespace cue {
+
+struct StreamFormat {
+    unsigned sampleRate;
+    unsigned channels;
+    unsigned bitsPerSample;
+};
+
+// Samples borrowed from a source, in whatever layout was cheapest for it to produce:
+// planar 32-bit channels, or interleaved bytes exactly as an uncompressed file stores
+// them (little-endian unless isBigEndian; 8-bit samples unsigned, as in WAV files).
+// Interleaved samples may point right into the mapping of `image`, in which case they are
+// only read inside its guard().
+struct SampleView {
+    const int32_t* const* channels = nullptr;
+    const uint8_t* interleaved = nullptr;
+    bool isBigEndian = false;
+    uint32_t count = 0;
+    const flaccue::PCMImage* image = nullptr;
+
+    // Runs `read` over the samples, inside the guard of the image they point into, if any.
+    void guard(const std::function<void()>& read) const noexcept(false) {
+        if (image) {
+            image->guard(read);
+        } else {
+            read();
+        }
+    }
+};
+
+// Converts interleaved PCM to planar 32-bit samples.
+void deinterleave(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count, int32_t* const buffer[]) noexcept(false);
+
+// A seekable stream of audio, handed out in blocks of the caller's choosing.
+class SampleSource {
+public:
+    virtual ~SampleSource() = default;
+
+    virtual const StreamFormat& format() const = 0;
+    virtual uint64_t numberOfSamples() const = 0;
+    virtual uint64_t position() const = 0;
+    virtual void seek(uint64_t sample) noexcept(false) = 0;
+
+    // The next at most `maxCount` samples without copying them, valid until the next call.
+    // An empty view marks the end of the stream.
+    virtual SampleView borrow(uint32_t maxCount) noexcept(false) = 0;
+
+    // Copies the next at most `capacity` samples into buffers owned by the caller, one per
+    // channel. Returns 0 at the end of the stream.
+    uint32_t read(int32_t* const buffer[], uint32_t capacity) noexcept(false);
+};
+
+// Consumes audio. Sinks that can take interleaved PCM as it is override
+// processInterleaved(); for the others it gets deinterleaved first.
+class SampleSink {
+    std::vector<int32_t> _scratch;
+
+public:
+    virtual ~SampleSink() = default;
+
+    virtual void begin(const StreamFormat&) {}
+    virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) = 0;
+    virtual void processInterleaved(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count);
+    virtual void end() {}
+};
+
+const uint32_t DefaultSampleBlockSize = 4608;
+
+// Moves at most `count` samples from the current position of the source to the sink, in
+// borrowed blocks of `blockSize`. Returns how many there were.
+uint64_t copySamples(SampleSource& source, SampleSink& sink, uint64_t count = UINT64_MAX, uint32_t blockSize = DefaultSampleBlockSize) noexcept(false);
+
+using SampleSourceHandler = std::function<SampleSource&(const std::string& inputFile)>;
+
+// Feeds one output of a split to a sink, between its begin() and end(): the input
+// segments are seeked to and copied one after the other.
+void copySplitOutput(const Split& split, size_t output, const SampleSourceHandler& sources, SampleSink& sink, uint32_t blockSize = DefaultSampleBlockSize) noexcept(false);
+
+// Uncompressed audio served from the mapping of a PCMImage, which has to outlive it.
+// Borrowed blocks point into the mapping.
+class PCMSampleSource : public SampleSource {
+    const flaccue::PCMImage& _image;
+    StreamFormat _format;
+    uint64_t _position;
+
+public:
+    explicit PCMSampleSource(const flaccue::PCMImage& image);
+
+    virtual const StreamFormat& format() const override { return _format; }
+    virtual uint64_t numberOfSamples() const override { return _image.numberOfSamples(); }
+    virtual uint64_t position() const override { return _position; }
+    virtual void seek(uint64_t sample) noexcept(false) override;
+    virtual SampleView borrow(uint32_t maxCount) noexcept(false) override;
+};
+
+// Writes interleaved little-endian PCM to a file: a WAV file, or a raw image without a
+// header. Interleaved little-endian input in the same format is written as it is.
+class PCMFileSampleSink : public SampleSink {
+    std::string _path;
+    bool _writesWaveHeader;
+    int _fileDescriptor;
+    StreamFormat _format;
+    uint64_t _dataSize;
+    std::vector<uint8_t> _buffer;
+
+    void write(const uint8_t* data, size_t size);
+    void flush();
+
+public:
+    PCMFileSampleSink(const std::string& path, bool writesWaveHeader);
+    virtual ~PCMFileSampleSink();
+
+    virtual void begin(const StreamFormat& format) override;
+    virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) override;
+    virtual void processInterleaved(const uint8_t* data, const StreamFormat& format, bool isBigEndian, uint32_t count) override;
+    virtual void end() override;
+};
+
+}
+
+#endif /* SampleSource_h */
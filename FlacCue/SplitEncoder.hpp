@@ -0,0 +1,102 @@
+//
+//  SplitEncoder.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef SplitEncoder_h
+#define SplitEncoder_h
+
+// Needs libFLAC++, see SplitExecutor.hpp.
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <FLAC++/all.h>
+
+#include "CueParse.hpp"
+#include "SplitExecutor.hpp"
+#include "Trace.hpp"
+
+namespace cue {
+
+struct EncoderSettings {
+    unsigned compressionLevel = 5;
+    unsigned blocksize = 0; // 0 keeps the default of the compression level
+    // Threads libFLAC itself may use per encoder. Needs libFLAC 1.5; ignored before that.
+    unsigned numberOfThreads = 1;
+    bool verify = false;
+
+    void apply(FLAC::Encoder::Stream& encoder) const {
+        encoder.set_verify(verify);
+        encoder.set_compression_level(compressionLevel);
+        if (blocksize != 0) {
+            encoder.set_blocksize(blocksize);
+        }
+#if FLAC_API_VERSION_CURRENT >= 14
+        encoder.set_num_threads(numberOfThreads);
+#endif
+    }
+};
+
+// Encodes each output of a split into its own FLAC file, in the format of its inputs.
+class FLACEncodingSplitSink : public SplitSink {
+public:
+    using OutputPathHandler = std::function<std::string(const std::string& outputFile)>;
+
+private:
+    const Split& _split;
+    OutputPathHandler _outputPathHandler;
+    EncoderSettings _settings;
+    std::optional<StreamFormat> _format;
+    std::unique_ptr<FLAC::Encoder::File> _encoder;
+    std::string _path;
+
+public:
+    FLACEncodingSplitSink(const Split& split, OutputPathHandler outputPathHandler, const EncoderSettings& settings = EncoderSettings())
+    : _split(split)
+    , _outputPathHandler(outputPathHandler)
+    , _settings(settings) {}
+
+    virtual void beginInput(const StreamFormat& format) override {
+        _format = format;
+    }
+
+    virtual void beginOutput(size_t output) override {
+        if (!_format) {
+            throw std::logic_error("beginOutput() before beginInput()");
+        }
+        _path = _outputPathHandler(_split.outputFiles[output].outputFile);
+        _encoder = std::make_unique<FLAC::Encoder::File>();
+        _encoder->set_channels(_format->channels);
+        _encoder->set_sample_rate(_format->sampleRate);
+        _encoder->set_bits_per_sample(_format->bitsPerSample);
+        _settings.apply(*_encoder);
+        if (_encoder->init(_path) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+            throw std::runtime_error("Error while creating '" + _path + "'");
+        }
+    }
+
+    virtual void processSamples(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count) override {
+        flaccue::TraceScope trace("write", "encode");
+        if (!_encoder->process(buffer, count)) {
+            throw std::runtime_error("Error while encoding '" + _path + "'");
+        }
+    }
+
+    virtual void endOutput(size_t output) override {
+        auto ok = _encoder->finish();
+        _encoder.reset();
+        if (!ok) {
+            throw std::runtime_error("Error while finishing '" + _path + "'");
+        }
+    }
+};
+
+}
+
+#endif /* SplitEncoder_h */
@@ -0,0 +1,633 @@
+//
+//  SplitExecutor.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef SplitExecutor_h
+#define SplitExecutor_h
+
+// Needs libFLAC++, which the framework itself doesn't link; that's why this is header-only
+// and not part of FlacCue.h.
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <FLAC++/all.h>
+
+#include "CueParse.hpp"
+#include "MappedDecoder.hpp"
+#include "Metrics.hpp"
+#include "Pipeline.hpp"
+#include "SampleSource.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+namespace cue {
+
+// Length of an output; segments running to the end of their input take the duration of
+// the input file.
+inline Time splitOutputDuration(const SplitOutput& output, const std::function<Time(const std::string& inputFile)>& inputFileDuration) {
+    Time result = 0;
+    for (auto& segment : output.inputSegments) {
+        auto end = segment.end ? *segment.end : inputFileDuration(segment.inputFile);
+        if (end > segment.begin) {
+            result = result + (end - segment.begin);
+        }
+    }
+    return result;
+}
+
+// Receives the audio of the outputs of a Split. Samples of an output arrive in order,
+// between a beginOutput and an endOutput call for that output.
+class SplitSink {
+public:
+    virtual ~SplitSink() = default;
+
+    // Called before any audio of an input file, with the format from its STREAMINFO.
+    virtual void beginInput(const StreamFormat&) {}
+    virtual void beginOutput(size_t) {}
+    virtual void processSamples(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count) = 0;
+    virtual void endOutput(size_t) {}
+
+    // Sinks returning true get the frames that go into an output as a whole through
+    // processFrame(), together with their encoded bytes.
+    virtual bool wantsEncodedFrames() const { return false; }
+
+    // `frame` is the complete encoded FLAC frame, from sync code to CRC-16, that the
+    // samples were decoded from.
+    virtual void processFrame(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count, const uint8_t* frame, size_t frameSize) {
+        processSamples(output, buffer, channels, count);
+    }
+};
+
+// Hands the outputs of a Split from `firstOutput` on to a SampleSink, each of them between
+// a begin() with the format of its first input and an end().
+class SampleSinkSplitSink : public SplitSink {
+    SampleSink& _sink;
+    size_t _firstOutput;
+    StreamFormat _format { 0, 0, 0 };
+
+public:
+    SampleSinkSplitSink(SampleSink& sink, size_t firstOutput = 0) : _sink(sink), _firstOutput(firstOutput) {}
+
+    virtual void beginInput(const StreamFormat& format) override {
+        _format = format;
+    }
+
+    virtual void beginOutput(size_t output) override {
+        if (output >= _firstOutput) {
+            _sink.begin(_format);
+        }
+    }
+
+    virtual void processSamples(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count) override {
+        static_assert(sizeof(FLAC__int32) == sizeof(int32_t), "");
+        if (output >= _firstOutput) {
+            _sink.process(buffer, channels, count);
+        }
+    }
+
+    virtual void endOutput(size_t output) override {
+        if (output >= _firstOutput) {
+            _sink.end();
+        }
+    }
+};
+
+// Executes a Split by decoding the input files front to back and cutting the decoded
+// frames at segment boundaries. Outputs come out one after the other in disc order, in
+// the passes planned by planSplitPasses(): usually every input is decoded exactly once,
+// and unless asked to skip to the first needed sample, only a file read for a second
+// time is seeked, so the I/O stays sequential.
+class SequentialSplitExecutor {
+public:
+    // Maps file names of the cue sheet to the paths to actually open.
+    using InputPathHandler = std::function<std::string(const std::string& inputFile)>;
+
+private:
+    struct Cut {
+        size_t output;
+        size_t segment;
+        Time begin;
+        std::optional<Time> end;
+        bool isFirstOfOutput;
+        bool isLastOfOutput;
+        bool isStarted;
+        bool isFinished;
+    };
+
+    struct Input {
+        std::string file;
+        std::vector<Cut> cuts; // ordered by begin
+        bool seeksToFirstCut;
+    };
+
+    class InputDecoder : public MappedFLACDecoder {
+        std::vector<Cut>& _cuts;
+        SplitSink& _sink;
+        size_t _firstPendingCut = 0;
+        long long _position = 0;
+        std::optional<StreamFormat> _format;
+        bool _readsEncodedFrames = false;
+        FLAC__uint64 _frameBegin = 0;
+        std::vector<uint8_t> _encodedFrame;
+        bool _isSeeking = false;
+        std::exception_ptr _error;
+
+        void startCut(Cut& cut) {
+            cut.isStarted = true;
+            if (cut.isFirstOfOutput) {
+                _sink.beginOutput(cut.output);
+            }
+        }
+
+        void finishCut(Cut& cut) {
+            cut.isFinished = true;
+            if (cut.isLastOfOutput) {
+                _sink.endOutput(cut.output);
+            }
+        }
+
+        // Reads back the bytes of the frame just decoded. The decoder's position is the end
+        // of that frame, the end of the previous one is where it starts.
+        bool findEncodedFrame(const uint8_t*& frame, size_t& frameSize) {
+            FLAC__uint64 frameEnd;
+            if (!get_decode_position(&frameEnd) || frameEnd <= _frameBegin || frameEnd > mappedSize()) {
+                return false;
+            }
+            copyInput((size_t)_frameBegin, (size_t)(frameEnd - _frameBegin), _encodedFrame);
+            frame = _encodedFrame.data();
+            frameSize = _encodedFrame.size();
+            _frameBegin = frameEnd;
+            return true;
+        }
+
+        // Limits readahead to roughly where the last cut ends, assuming a constant bitrate.
+        void limitReadahead() {
+            FLAC__uint64 audioBegin;
+            auto totalSamples = get_total_samples();
+            if (_cuts.empty() || !_cuts.back().end || totalSamples == 0 || !get_decode_position(&audioBegin)) {
+                return;
+            }
+            auto audioSize = mappedSize() - std::min<size_t>(audioBegin, mappedSize());
+            auto fraction = std::min(1.0, (double)_cuts.back().end->samples / totalSamples);
+            setReadahead(DefaultReadaheadWindow, (size_t)(audioBegin + fraction * audioSize) + DefaultReadaheadWindow);
+        }
+
+        void deliver(const FLAC__int32* const buffer[], long long blocksize, unsigned channels, const uint8_t* frame, size_t frameSize) {
+            auto frameBegin = _position;
+            auto frameEnd = _position + blocksize;
+            const FLAC__int32* slice[FLAC__MAX_CHANNELS];
+
+            for (auto i = _firstPendingCut; i < _cuts.size() && _cuts[i].begin.samples < frameEnd; ++i) {
+                auto& cut = _cuts[i];
+                if (cut.isFinished) {
+                    continue;
+                }
+                if (!cut.isStarted) {
+                    startCut(cut);
+                }
+
+                auto begin = std::max(cut.begin.samples, frameBegin);
+                auto end = cut.end ? std::min(cut.end->samples, frameEnd) : frameEnd;
+                if (end > begin) {
+                    for (unsigned channel = 0; channel < channels; ++channel) {
+                        slice[channel] = buffer[channel] + (begin - frameBegin);
+                    }
+                    if (frame && begin == frameBegin && end == frameEnd) {
+                        _sink.processFrame(cut.output, slice, channels, (uint32_t)(end - begin), frame, frameSize);
+                    } else {
+                        _sink.processSamples(cut.output, slice, channels, (uint32_t)(end - begin));
+                    }
+                }
+
+                if (cut.end && cut.end->samples <= frameEnd) {
+                    finishCut(cut);
+                }
+            }
+
+            _position = frameEnd;
+            while (_firstPendingCut < _cuts.size() && _cuts[_firstPendingCut].isFinished) {
+                ++_firstPendingCut;
+            }
+        }
+
+        void finishAtEndOfStream(const std::string& path) {
+            for (auto i = _firstPendingCut; i < _cuts.size(); ++i) {
+                auto& cut = _cuts[i];
+                if (cut.isFinished) {
+                    continue;
+                }
+                if (cut.begin.samples > _position || (cut.end && cut.end->samples > _position)) {
+                    throw std::runtime_error("'" + path + "' ends at " + to_string(Time(_position)) + ", before the end of a split segment");
+                }
+                if (!cut.isStarted) {
+                    startCut(cut);
+                }
+                finishCut(cut);
+            }
+            _firstPendingCut = _cuts.size();
+        }
+
+    protected:
+        virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[]) override {
+            try {
+                const uint8_t* encodedFrame = nullptr;
+                size_t encodedFrameSize = 0;
+                if (_readsEncodedFrames && !_isSeeking) {
+                    findEncodedFrame(encodedFrame, encodedFrameSize);
+                }
+                deliver(buffer, frame->header.blocksize, frame->header.channels, encodedFrame, encodedFrameSize);
+                return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+            } catch (...) {
+                _error = std::current_exception();
+                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+            }
+        }
+
+        virtual void metadata_callback(const ::FLAC__StreamMetadata *metadata) override {
+            if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+                auto& streamInfo = metadata->data.stream_info;
+                _format = StreamFormat { streamInfo.sample_rate, streamInfo.channels, streamInfo.bits_per_sample };
+            }
+        }
+
+        virtual void error_callback(::FLAC__StreamDecoderErrorStatus status) override {
+            if (!_error) {
+                _error = std::make_exception_ptr(std::runtime_error(std::string("FLAC decoding error: ") + FLAC__StreamDecoderErrorStatusString[status]));
+            }
+        }
+
+    public:
+        InputDecoder(std::vector<Cut>& cuts, SplitSink& sink) : _cuts(cuts), _sink(sink) {}
+
+        // Skips the audio before the first cut. libFLAC delivers the frame containing the
+        // target sample from inside seek_absolute(), trimmed to start at the target.
+        bool seekToFirstCut() {
+            auto target = _cuts.empty() ? 0 : _cuts.front().begin.samples;
+            if (target <= 0 || (FLAC__uint64)target >= get_total_samples()) {
+                return true;
+            }
+            _position = target;
+            _isSeeking = true;
+            bool ok;
+            {
+                flaccue::TraceScope trace("seek", "decode");
+                ok = seek_absolute((FLAC__uint64)target);
+            }
+            _isSeeking = false;
+            if (ok && _readsEncodedFrames && !get_decode_position(&_frameBegin)) {
+                _readsEncodedFrames = false;
+            }
+            return ok;
+        }
+
+        void run(const std::string& path, bool seeksToFirstCut) {
+            if (init(path) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+                throw std::runtime_error("Error while opening '" + path + "'");
+            }
+
+            // Stops as soon as the last cut is done; trailing audio nobody wants isn't decoded.
+            bool ok = process_until_end_of_metadata();
+            if (ok && !_error) {
+                if (!_format) {
+                    throw std::runtime_error("'" + path + "' has no STREAMINFO");
+                }
+                _sink.beginInput(*_format);
+                _readsEncodedFrames = _sink.wantsEncodedFrames() && get_decode_position(&_frameBegin);
+                limitReadahead();
+                if (seeksToFirstCut) {
+                    ok = seekToFirstCut();
+                }
+            }
+            while (ok && !_error && _firstPendingCut < _cuts.size() && get_state() != FLAC__STREAM_DECODER_END_OF_STREAM) {
+                flaccue::TraceScope trace("frame", "decode");
+                ok = process_single();
+            }
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            if (readError()) {
+                std::rethrow_exception(readError());
+            }
+            if (!ok) {
+                throw std::runtime_error("Error while decoding '" + path + "'");
+            }
+
+            finishAtEndOfStream(path);
+            finish();
+        }
+    };
+
+    std::vector<Input> _inputs; // one per pass
+    InputPathHandler _inputPathHandler;
+
+    static std::vector<size_t> allOutputs(const Split& split) {
+        std::vector<size_t> outputs(split.outputFiles.size());
+        for (size_t output = 0; output < outputs.size(); ++output) {
+            outputs[output] = output;
+        }
+        return outputs;
+    }
+
+public:
+    SequentialSplitExecutor(const Split& split, InputPathHandler inputPathHandler)
+    : SequentialSplitExecutor(split, inputPathHandler, allOutputs(split), false) {}
+
+    // Produces only `outputs`. With `seeksToFirstCut` decoding of every input starts at
+    // the first sample those outputs need instead of at the beginning of the file.
+    SequentialSplitExecutor(const Split& split, InputPathHandler inputPathHandler, const std::vector<size_t>& outputs, bool seeksToFirstCut)
+    : _inputPathHandler(inputPathHandler) {
+        std::unordered_set<std::string> decodedFiles;
+        for (auto& pass : planSplitPasses(split, outputs)) {
+            Input input { pass.inputFile, {}, seeksToFirstCut || !decodedFiles.insert(pass.inputFile).second };
+            for (auto& outputSegment : pass.segments) {
+                auto& segments = split.outputFiles[outputSegment.first].inputSegments;
+                auto& inputSegment = segments[outputSegment.second];
+                input.cuts.push_back(Cut {
+                    outputSegment.first,
+                    outputSegment.second,
+                    inputSegment.begin,
+                    inputSegment.end,
+                    outputSegment.second == 0,
+                    outputSegment.second + 1 == segments.size(),
+                    false,
+                    false
+                });
+            }
+            _inputs.push_back(std::move(input));
+        }
+    }
+
+    void execute(SplitSink& sink) const noexcept(false) {
+        for (auto& input : _inputs) {
+            auto cuts = input.cuts;
+            InputDecoder decoder(cuts, sink);
+            decoder.run(_inputPathHandler(input.file), input.seeksToFirstCut);
+        }
+    }
+};
+
+// Runs a SequentialSplitExecutor with the decoder and every sink on separate threads. The
+// decoding thread copies the audio into pooled SampleBlocks and hands them to each stage
+// through its own bounded SPSC queue; a slow stage stalls the decoder instead of
+// buffering without limit. Wall time approaches that of the slowest stage.
+class PipelinedSplitExecutor {
+    struct Message {
+        enum Type { BeginInput, BeginOutput, Samples, Frame, EndOutput, EndOfStream } type;
+        size_t output;
+        flaccue::SampleBlock* block;
+        StreamFormat format;
+    };
+
+    struct Stage {
+        SplitSink& sink;
+        flaccue::SPSCQueue<Message> queue;
+        std::exception_ptr error;
+
+        Stage(SplitSink& sink, size_t queueCapacity) : sink(sink), queue(queueCapacity) {}
+    };
+
+    class StageFailed : public std::exception {};
+
+    class FanOutSink : public SplitSink {
+        std::vector<std::unique_ptr<Stage>>& _stages;
+        flaccue::SampleBlockPool& _pool;
+        std::atomic<bool>& _isFailed;
+        bool _wantsEncodedFrames;
+
+        void broadcast(Message message) {
+            if (_isFailed.load(std::memory_order_relaxed)) {
+                throw StageFailed();
+            }
+            for (auto& stage : _stages) {
+                stage->queue.push(message);
+            }
+        }
+
+    public:
+        FanOutSink(std::vector<std::unique_ptr<Stage>>& stages, flaccue::SampleBlockPool& pool, std::atomic<bool>& isFailed)
+        : _stages(stages), _pool(pool), _isFailed(isFailed) {
+            _wantsEncodedFrames = std::any_of(_stages.begin(), _stages.end(), [](const std::unique_ptr<Stage>& stage) {
+                return stage->sink.wantsEncodedFrames();
+            });
+        }
+
+        virtual void beginInput(const StreamFormat& format) override {
+            broadcast(Message { Message::BeginInput, 0, nullptr, format });
+        }
+
+        virtual void beginOutput(size_t output) override {
+            broadcast(Message { Message::BeginOutput, output, nullptr, {} });
+        }
+
+        virtual void processSamples(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count) override {
+            static_assert(sizeof(FLAC__int32) == sizeof(int32_t), "");
+            const int32_t* slice[flaccue::SampleBlock::MaxChannels];
+            for (uint32_t offset = 0; offset < count; ) {
+                auto block = _pool.acquire((unsigned)_stages.size());
+                auto blockCount = std::min(count - offset, block->capacity());
+                for (unsigned channel = 0; channel < channels; ++channel) {
+                    slice[channel] = buffer[channel] + offset;
+                }
+                block->assign(slice, channels, blockCount);
+                try {
+                    broadcast(Message { Message::Samples, output, block, {} });
+                } catch (...) {
+                    for (size_t i = 0; i < _stages.size(); ++i) {
+                        _pool.release(block);
+                    }
+                    throw;
+                }
+                offset += blockCount;
+            }
+        }
+
+        virtual bool wantsEncodedFrames() const override {
+            return _wantsEncodedFrames;
+        }
+
+        // Frames larger than a block lose their encoded bytes and travel as plain samples.
+        virtual void processFrame(size_t output, const FLAC__int32* const buffer[], unsigned channels, uint32_t count, const uint8_t* frame, size_t frameSize) override {
+            if (count > _pool.samplesPerBlock()) {
+                processSamples(output, buffer, channels, count);
+                return;
+            }
+            auto block = _pool.acquire((unsigned)_stages.size());
+            block->assign(buffer, channels, count, frame, frameSize);
+            try {
+                broadcast(Message { Message::Frame, output, block, {} });
+            } catch (...) {
+                for (size_t i = 0; i < _stages.size(); ++i) {
+                    _pool.release(block);
+                }
+                throw;
+            }
+        }
+
+        virtual void endOutput(size_t output) override {
+            broadcast(Message { Message::EndOutput, output, nullptr, {} });
+        }
+    };
+
+    const SequentialSplitExecutor& _executor;
+    size_t _numberOfBlocks;
+    uint32_t _samplesPerBlock;
+
+    static void runStage(Stage& stage, flaccue::SampleBlockPool& pool, std::atomic<bool>& isFailed, flaccue::StageAccount account) {
+        flaccue::StageCPUTimer timer(account);
+        for (;;) {
+            auto message = stage.queue.pop();
+            if (message.type == Message::EndOfStream) {
+                return;
+            }
+            if (!stage.error) {
+                try {
+                    switch (message.type) {
+                        case Message::BeginInput: stage.sink.beginInput(message.format); break;
+                        case Message::BeginOutput: stage.sink.beginOutput(message.output); break;
+                        case Message::Samples: stage.sink.processSamples(message.output, message.block->channels(), message.block->numberOfChannels(), message.block->count()); break;
+                        case Message::Frame: stage.sink.processFrame(message.output, message.block->channels(), message.block->numberOfChannels(), message.block->count(), message.block->encoded(), message.block->encodedSize()); break;
+                        case Message::EndOutput: stage.sink.endOutput(message.output); break;
+                        case Message::EndOfStream: break;
+                    }
+                } catch (...) {
+                    stage.error = std::current_exception();
+                    isFailed.store(true, std::memory_order_relaxed);
+                }
+            }
+            // A failed stage keeps draining its queue so that the decoder never blocks on it.
+            if (message.block) {
+                pool.release(message.block);
+            }
+        }
+    }
+
+public:
+    PipelinedSplitExecutor(const SequentialSplitExecutor& executor, size_t numberOfBlocks = 64, uint32_t samplesPerBlock = 4608)
+    : _executor(executor)
+    , _numberOfBlocks(numberOfBlocks)
+    , _samplesPerBlock(samplesPerBlock) {}
+
+    // Every sink is called from its own thread, whose CPU time goes to the calling thread's
+    // stage. Rethrows the first error of the decoder or
+    // of the stages, after all threads have stopped.
+    void execute(const std::vector<SplitSink*>& sinks) const noexcept(false) {
+        if (sinks.empty()) {
+            return;
+        }
+
+        flaccue::SampleBlockPool pool(_numberOfBlocks, _samplesPerBlock);
+        std::atomic<bool> isFailed(false);
+        std::vector<std::unique_ptr<Stage>> stages;
+        for (auto sink : sinks) {
+            stages.push_back(std::make_unique<Stage>(*sink, 2 * _numberOfBlocks + 2));
+        }
+
+        std::vector<std::thread> threads;
+        for (auto& stage : stages) {
+            threads.emplace_back(runStage, std::ref(*stage), std::ref(pool), std::ref(isFailed), flaccue::currentStageAccount());
+        }
+
+        std::exception_ptr error;
+        try {
+            FanOutSink fanOut(stages, pool, isFailed);
+            _executor.execute(fanOut);
+        } catch (const StageFailed&) {
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        for (auto& stage : stages) {
+            stage->queue.push(Message { Message::EndOfStream, 0, nullptr, {} });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        for (auto& stage : stages) {
+            if (stage->error) {
+                std::rethrow_exception(stage->error);
+            }
+        }
+    }
+};
+
+// Produces every output of a Split as an independent task on a thread pool, each one
+// decoding only the part of its inputs it needs. The largest outputs are started first, so
+// that a long track doesn't end up running alone at the end. Every output gets a sink of
+// its own, so what a sink sees doesn't depend on the number of threads or the scheduling.
+class ParallelSplitExecutor {
+public:
+    using InputPathHandler = SequentialSplitExecutor::InputPathHandler;
+    using InputFileDurationHandler = std::function<Time(const std::string& inputFile)>;
+    using SinkFactory = std::function<std::unique_ptr<SplitSink>(size_t output)>;
+
+private:
+    std::vector<SequentialSplitExecutor> _executors; // one per output
+    std::vector<size_t> _order;
+
+public:
+    ParallelSplitExecutor(const Split& split, InputPathHandler inputPathHandler, InputFileDurationHandler inputFileDurationHandler) noexcept(false) {
+        std::vector<Time> durations;
+        for (size_t output = 0; output < split.outputFiles.size(); ++output) {
+            _executors.emplace_back(split, inputPathHandler, std::vector<size_t> { output }, true);
+            durations.push_back(splitOutputDuration(split.outputFiles[output], inputFileDurationHandler));
+            _order.push_back(output);
+        }
+        std::stable_sort(_order.begin(), _order.end(), [&](size_t a, size_t b) {
+            return durations[a] > durations[b];
+        });
+    }
+
+    // The outputs in the order they are started.
+    const std::vector<size_t>& order() const { return _order; }
+
+    // Stops starting new outputs after the first failure and rethrows it once the ones
+    // already running have finished.
+    void execute(flaccue::ThreadPool& pool, const SinkFactory& sinkFactory) const noexcept(false) {
+        std::atomic<size_t> nextOutput(0);
+        std::atomic<bool> isFailed(false);
+        flaccue::TaskGroup group(pool);
+
+        // A fixed set of workers taking outputs from a shared cursor keeps the order exact;
+        // submitting one task per output would leave it to the pool's LIFO deques.
+        auto numberOfWorkers = std::min(pool.numberOfThreads(), _order.size());
+        for (size_t worker = 0; worker < numberOfWorkers; ++worker) {
+            group.run([&]() {
+                for (;;) {
+                    auto index = nextOutput++;
+                    if (index >= _order.size() || isFailed.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+                    try {
+                        auto output = _order[index];
+                        auto sink = sinkFactory(output);
+                        _executors[output].execute(*sink);
+                    } catch (...) {
+                        isFailed.store(true, std::memory_order_relaxed);
+                        throw;
+                    }
+                }
+            });
+        }
+        group.wait();
+    }
+};
+
+}
+
+#endif /* SplitExecutor_h */
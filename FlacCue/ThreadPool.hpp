@@ -0,0 +1,258 @@
+//
+//  ThreadPool.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Metrics.hpp"
+
+namespace flaccue {
+
+// Work-stealing pool: every worker owns a deque, pushes and pops its own tasks LIFO,
+// and steals FIFO from the other workers when it runs dry.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _idleMutex;
+    std::condition_variable _idleCondition;
+    std::atomic<size_t> _queuedTasks;
+    std::atomic<size_t> _nextQueue;
+    bool _stopping;
+
+    static ThreadPool*& currentPool() {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& currentWorker() {
+        static thread_local size_t worker = 0;
+        return worker;
+    }
+
+    bool popFrom(size_t queueIndex, bool back, Task& task) {
+        auto& queue = *_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        --_queuedTasks;
+        return true;
+    }
+
+    bool tryPop(size_t homeQueue, bool isWorker, Task& task) {
+        if (isWorker && popFrom(homeQueue, true, task)) {
+            return true;
+        }
+        for (size_t i = isWorker ? 1 : 0; i < _queues.size(); ++i) {
+            if (popFrom((homeQueue + i) % _queues.size(), false, task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t index) {
+        currentPool() = this;
+        currentWorker() = index;
+        Task task;
+        while (true) {
+            if (tryPop(index, true, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_idleMutex);
+            _idleCondition.wait(lock, [&]() { return _stopping || _queuedTasks > 0; });
+            if (_stopping && _queuedTasks == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t numberOfThreads = std::thread::hardware_concurrency())
+    : _queuedTasks(0)
+    , _nextQueue(0)
+    , _stopping(false) {
+        numberOfThreads = std::max<size_t>(numberOfThreads, 1);
+        for (size_t i = 0; i < numberOfThreads; ++i) {
+            _queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < numberOfThreads; ++i) {
+            _threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs every task that was already submitted before returning.
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_idleMutex);
+            _stopping = true;
+        }
+        _idleCondition.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    size_t numberOfThreads() const {
+        return _threads.size();
+    }
+
+    void submit(Task task) {
+        bool isWorker = currentPool() == this;
+        auto queueIndex = isWorker ? currentWorker() : (_nextQueue++ % _queues.size());
+        {
+            auto& queue = *_queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            ++_queuedTasks;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_idleMutex);
+        }
+        _idleCondition.notify_one();
+    }
+};
+
+// Tracks a set of tasks submitted to a pool. The tasks wait in the group's own queue, and
+// the pool only gets a stub that runs the oldest one still waiting. wait() runs the group's
+// remaining tasks itself, so groups can be nested inside pool tasks without deadlocking,
+// but a waiting thread never picks up unrelated work (such as another album) that would
+// keep it from returning to its caller.
+class TaskGroup {
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<ThreadPool::Task> pending;
+        size_t outstandingTasks = 0;
+        std::exception_ptr error;
+
+        bool runPending(bool newest) {
+            ThreadPool::Task task;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending.empty()) {
+                    return false;
+                }
+                if (newest) {
+                    task = std::move(pending.back());
+                    pending.pop_back();
+                } else {
+                    task = std::move(pending.front());
+                    pending.pop_front();
+                }
+            }
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--outstandingTasks == 0) {
+                condition.notify_all();
+            }
+            return true;
+        }
+    };
+
+    ThreadPool& _pool;
+    // Shared with the stubs, which may still be queued in the pool after the group is gone.
+    std::shared_ptr<State> _state;
+
+    void runUntilDone() {
+        while (true) {
+            if (_state->runPending(true)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            // Whatever is left runs on other threads, unless one of them adds more tasks.
+            _state->condition.wait(lock, [&]() { return _state->outstandingTasks == 0 || !_state->pending.empty(); });
+            if (_state->outstandingTasks == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit TaskGroup(ThreadPool& pool) : _pool(pool), _state(std::make_shared<State>()) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        runUntilDone();
+    }
+
+    // The task's CPU time goes to the stage the calling thread is working for, if any.
+    void run(ThreadPool::Task task) {
+        auto account = currentStageAccount();
+        if (account.metrics) {
+            task = [account, task = std::move(task)]() {
+                StageCPUTimer timer(account);
+                task();
+            };
+        }
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            _state->pending.push_back(std::move(task));
+            ++_state->outstandingTasks;
+        }
+        _state->condition.notify_all();
+        _pool.submit([state = _state]() {
+            state->runPending(false);
+        });
+    }
+
+    // Rethrows the first exception thrown by any task of the group.
+    void wait() {
+        runUntilDone();
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        if (_state->error) {
+            auto error = _state->error;
+            _state->error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}
+
+#endif /* ThreadPool_h */
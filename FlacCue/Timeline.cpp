@@ -0,0 +1,99 @@
+//
+//  Timeline.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Timeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cue {
+
+Timeline::Timeline(const Disc& disc, const FileDurationHandler& fileDuration) noexcept(false) {
+    _fileBegins.reserve(disc.filesCend() - disc.filesCbegin() + 1);
+    _fileBegins.push_back(0);
+    for (auto file = disc.filesCbegin(); file != disc.filesCend(); ++file) {
+        _fileBegins.push_back(_fileBegins.back() + fileDuration(file->path));
+    }
+
+    _tracks.reserve(disc.tracksCend() - disc.tracksCbegin());
+    for (auto track = disc.tracksCbegin(); track != disc.tracksCend(); ++track) {
+        _tracks.push_back({ (uint32_t)_indexes.size(), track->number, track->pregap.value_or(0) });
+
+        for (auto index = track->indexesCbegin(); index != track->indexesCend(); ++index) {
+            IndexEntry entry;
+            entry.file = (uint32_t)(&index->file() - &*disc.filesCbegin());
+            entry.begin = _fileBegins[entry.file] + index->begin;
+            entry.track = (uint32_t)(_tracks.size() - 1);
+            entry.index = (uint32_t)(index - track->indexesCbegin());
+            entry.number = index->index;
+
+            if (!_indexes.empty() && entry.begin < _indexes.back().begin && _isOrdered) {
+                _isOrdered = false;
+                _orderingError = "INDEX " + std::to_string(index->index) + " of track " + std::to_string(track->number) + " starts before the preceding INDEX";
+            }
+            _indexes.push_back(entry);
+        }
+    }
+}
+
+Time Timeline::indexBegin(size_t track, size_t index) const {
+    auto& trackEntry = _tracks.at(track);
+    auto end = track + 1 < _tracks.size() ? _tracks[track + 1].firstIndex : (uint32_t)_indexes.size();
+    if (trackEntry.firstIndex + index >= end) {
+        throw std::out_of_range("Track " + std::to_string(trackEntry.number) + " has no INDEX at position " + std::to_string(index));
+    }
+    return _indexes[trackEntry.firstIndex + index].begin;
+}
+
+Timeline::Position Timeline::locate(Time time) const noexcept(false) {
+    if (time < 0 || !(time < duration()) || _indexes.empty()) {
+        throw std::out_of_range(to_string(time) + " is outside of the disc");
+    }
+    if (!_isOrdered) {
+        throw std::runtime_error(_orderingError);
+    }
+
+    Position result;
+    auto file = std::upper_bound(_fileBegins.begin(), _fileBegins.end(), time) - 1;
+    result.file = file - _fileBegins.begin();
+    result.fileOffset = time - *file;
+
+    auto index = std::upper_bound(_indexes.begin(), _indexes.end(), time, [](const Time& time, const IndexEntry& entry) {
+        return time < entry.begin;
+    });
+    if (index != _indexes.begin()) {
+        --index;
+    }
+    result.track = index->track;
+    result.index = index->index;
+    return result;
+}
+
+std::vector<Time> Timeline::trackOffsets() const noexcept(false) {
+    std::vector<Time> result;
+    if (_tracks.empty()) {
+        return result;
+    }
+
+    auto leadIn = _tracks.front().pregap;
+    result.reserve(_tracks.size() + 1);
+    for (auto& track : _tracks) {
+        if (track.pregap > 0 && track.number != 1) {
+            throw std::runtime_error("Non-zero pregap (" + to_string(track.pregap) + ") on track " + std::to_string(track.number));
+        }
+    }
+    for (auto& index : _indexes) {
+        if (index.number == 1) {
+            result.push_back(leadIn + index.begin);
+        }
+    }
+    result.push_back(leadIn + duration());
+    return result;
+}
+
+}
@@ -0,0 +1,81 @@
+//
+//  Timeline.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Timeline_h
+#define Timeline_h
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CueParse.hpp"
+
+namespace cue {
+
+// Maps between disc time and (file, offset, track, index) positions of a disc.
+// Disc time is measured from the first sample of the first file, i.e. the files
+// concatenated in cue sheet order; a pregap on track 1 is only added by trackOffsets().
+// Built once in O(files + indexes), lookups are binary searches.
+class Timeline {
+public:
+    using FileDurationHandler = std::function<Time(const std::string& fileName)>;
+
+    struct Position {
+        size_t file; // position of the file in the cue sheet
+        Time fileOffset;
+        size_t track; // position of the track in the cue sheet, not its number
+        size_t index; // position of the INDEX within the track, not its number
+    };
+
+private:
+    struct IndexEntry {
+        Time begin;
+        uint32_t file;
+        uint32_t track;
+        uint32_t index;
+        int number;
+    };
+
+    struct TrackEntry {
+        uint32_t firstIndex;
+        int number;
+        Time pregap;
+    };
+
+    std::vector<Time> _fileBegins; // one extra entry at the end holding the total duration
+    std::vector<IndexEntry> _indexes;
+    std::vector<TrackEntry> _tracks;
+    bool _isOrdered = true;
+    std::string _orderingError;
+
+public:
+    // Calls `fileDuration` exactly once per FILE command. Durations that contradict the
+    // INDEX times (e.g. unknown ones passed as 0) only make locate() throw.
+    Timeline(const Disc& disc, const FileDurationHandler& fileDuration) noexcept(false);
+
+    size_t numberOfFiles() const { return _fileBegins.size() - 1; }
+    Time fileBegin(size_t file) const { return _fileBegins.at(file); }
+    Time fileDuration(size_t file) const { return _fileBegins.at(file + 1) - _fileBegins[file]; }
+    Time duration() const { return _fileBegins.back(); }
+
+    Time discTime(size_t file, Time fileOffset) const { return fileBegin(file) + fileOffset; }
+    Time indexBegin(size_t track, size_t index) const;
+
+    // Throws std::out_of_range unless 0 <= time < duration(), and std::runtime_error if
+    // the INDEX times go backwards. Samples before the first INDEX are attributed to it.
+    Position locate(Time time) const noexcept(false);
+
+    // The INDEX 01 offsets of every track followed by the lead-out, shifted by the
+    // pregap of track 1, as expected by accuraterip::TableOfContents::CreateFromTrackOffsets.
+    std::vector<Time> trackOffsets() const noexcept(false);
+};
+
+}
+
+#endif /* Timeline_h */
@@ -0,0 +1,183 @@
+//
+//  Trace.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+
+#include "Metrics.hpp"
+
+namespace flaccue {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int64_t start;
+    int64_t duration;
+    char detail[40];
+};
+
+// Written by one thread at a time; `written` counts every event ever recorded into it,
+// so the slot of the next one is `written % events.size()`.
+struct TraceBuffer {
+    int threadID;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> written;
+
+    TraceBuffer(int threadID, size_t capacity)
+    : threadID(threadID)
+    , events(capacity)
+    , written(0) {}
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    std::vector<std::shared_ptr<TraceBuffer>> unused; // of threads that have exited
+    size_t eventsPerThread = DefaultTraceEventsPerThread;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+static TraceRegistry& registry() {
+    static auto instance = new TraceRegistry(); // outlives the thread-locals of late threads
+    return *instance;
+}
+
+// Hands the buffer back when its thread exits.
+struct ThreadTraceBuffer {
+    std::shared_ptr<TraceBuffer> buffer;
+
+    ~ThreadTraceBuffer() {
+        if (buffer) {
+            auto& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.unused.push_back(std::move(buffer));
+        }
+    }
+};
+
+static TraceBuffer& threadBuffer() {
+    thread_local ThreadTraceBuffer local;
+    if (!local.buffer) {
+        auto& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if (!shared.unused.empty()) {
+            local.buffer = std::move(shared.unused.back());
+            shared.unused.pop_back();
+        } else {
+            local.buffer = std::make_shared<TraceBuffer>((int)shared.buffers.size() + 1, shared.eventsPerThread);
+            shared.buffers.push_back(local.buffer);
+        }
+    }
+    return *local.buffer;
+}
+
+std::atomic<bool> trace::isEnabled(false);
+
+int64_t trace::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void trace::record(const char* name, const char* category, int64_t start, const char* detail) {
+    auto end = now();
+    auto& buffer = threadBuffer();
+    auto index = buffer.written.load(std::memory_order_relaxed);
+    auto& event = buffer.events[index % buffer.events.size()];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.duration = end - start;
+    event.detail[0] = 0;
+    if (detail) {
+        auto length = strlen(detail);
+        auto kept = std::min(length, sizeof(event.detail) - 1);
+        // Not starting in the middle of a UTF-8 sequence keeps the JSON valid.
+        while (kept > 0 && kept < length && ((uint8_t)detail[length - kept] & 0xc0) == 0x80) {
+            --kept;
+        }
+        memcpy(event.detail, detail + length - kept, kept);
+        event.detail[kept] = 0;
+    }
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void startTracing(size_t eventsPerThread) {
+    auto& shared = registry();
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.eventsPerThread = std::max<size_t>(eventsPerThread, 1);
+        for (auto& buffer : shared.buffers) {
+            buffer->written.store(0, std::memory_order_relaxed);
+        }
+        shared.epoch = std::chrono::steady_clock::now();
+    }
+    trace::isEnabled.store(true, std::memory_order_release);
+}
+
+void stopTracing() {
+    trace::isEnabled.store(false, std::memory_order_release);
+}
+
+void writeTrace(std::ostream& output) {
+    auto& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    auto processID = (int)getpid();
+    uint64_t dropped = 0;
+
+    output << "{\"traceEvents\":[";
+    output << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << processID << ",\"tid\":0,\"args\":{\"name\":\"FlacCue\"}}";
+    for (auto& buffer : shared.buffers) {
+        auto written = buffer->written.load(std::memory_order_acquire);
+        if (written == 0) {
+            continue;
+        }
+        output << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << processID << ",\"tid\":" << buffer->threadID
+        << ",\"args\":{\"name\":\"thread " << buffer->threadID << "\"}}";
+
+        auto capacity = (uint64_t)buffer->events.size();
+        auto first = written > capacity ? written - capacity : 0;
+        dropped += first;
+        for (auto index = first; index < written; ++index) {
+            auto& event = buffer->events[index % capacity];
+            char times[64];
+            snprintf(times, sizeof(times), "%.3f,\"dur\":%.3f", event.start / 1e3, event.duration / 1e3);
+            output << ",\n{\"ph\":\"X\",\"name\":" << jsonString(event.name)
+            << ",\"cat\":" << jsonString(event.category)
+            << ",\"ts\":" << times
+            << ",\"pid\":" << processID << ",\"tid\":" << buffer->threadID;
+            if (event.detail[0]) {
+                output << ",\"args\":{\"detail\":" << jsonString(event.detail) << "}";
+            }
+            output << "}";
+        }
+    }
+    output << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+}
+
+void writeTrace(const std::string& path) noexcept(false) {
+    std::ofstream output(path, std::ios::trunc);
+    if (!output) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + path + "'");
+    }
+    writeTrace(output);
+    output.flush();
+    if (!output) {
+        throw std::system_error(errno, std::generic_category(), "Failed to write '" + path + "'");
+    }
+}
+
+}
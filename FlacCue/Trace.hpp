@@ -0,0 +1,80 @@
+//
+//  Trace.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Trace_h
+#define Trace_h
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace flaccue {
+
+// A timeline of what each thread did, in the Chrome trace event format that Perfetto and
+// chrome://tracing open. Every thread records into a ring buffer of its own, so recording
+// takes no lock and nothing is shared between threads but the flag turning it on; when
+// full, a buffer overwrites its oldest events. While tracing is off a TraceScope costs a
+// single relaxed load.
+
+namespace trace {
+    extern std::atomic<bool> isEnabled;
+
+    int64_t now();
+    void record(const char* name, const char* category, int64_t start, const char* detail);
+}
+
+constexpr size_t DefaultTraceEventsPerThread = 1 << 15;
+
+inline bool isTracing() {
+    return trace::isEnabled.load(std::memory_order_relaxed);
+}
+
+// Throws away whatever was recorded before and starts recording; call it while nothing
+// records. Threads that record for the first time get a buffer of `eventsPerThread`
+// events. The buffer of a thread that exits goes to the next new thread, so short-lived
+// threads share a track in the timeline instead of piling up buffers.
+void startTracing(size_t eventsPerThread = DefaultTraceEventsPerThread);
+void stopTracing();
+
+// {"traceEvents":[...]} with the events of every thread that recorded since tracing was
+// started. Call it once the traced work is done: the buffers are read without locking.
+void writeTrace(std::ostream& output);
+void writeTrace(const std::string& path) noexcept(false);
+
+// Records the time from its construction to its destruction as one complete ("X") event.
+// Beginning and end go into the same slot, so an overwritten buffer never leaves an
+// unmatched half behind. The name and category must be string literals; the detail has
+// to live as long as the scope, which copies its end (the telling part of a path) into
+// the event's arguments.
+class TraceScope {
+    const char* _name;
+    const char* _category;
+    const char* _detail;
+    int64_t _start;
+
+public:
+    TraceScope(const char* name, const char* category, const char* detail = nullptr)
+    : _name(name)
+    , _category(category)
+    , _detail(detail)
+    , _start(isTracing() ? trace::now() : -1) {}
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() {
+        if (_start >= 0) {
+            trace::record(_name, _category, _start, _detail);
+        }
+    }
+};
+
+}
+
+#endif /* Trace_h */
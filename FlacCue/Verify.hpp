@@ -0,0 +1,218 @@
+//
+//  Verify.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Verify_h
+#define Verify_h
+
+// Needs libFLAC++, see SplitExecutor.hpp.
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <FLAC++/all.h>
+
+#include "MappedDecoder.hpp"
+#include "Metrics.hpp"
+#include "Pipeline.hpp"
+#include "Trace.hpp"
+
+namespace cue {
+
+using SampleHandler = std::function<void(const FLAC__int32* const buffer[], unsigned channels, uint32_t count)>;
+
+// Decodes a whole FLAC file for checksumming only: no MD5 check, no metadata besides
+// STREAMINFO, read straight from a memory mapping.
+class LeanFLACReader : public MappedFLACDecoder {
+    SampleHandler _handler;
+    std::exception_ptr _error;
+
+protected:
+    virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[]) override {
+        try {
+            _handler(buffer, frame->header.channels, frame->header.blocksize);
+            return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+        } catch (...) {
+            _error = std::current_exception();
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+        }
+    }
+
+    virtual void error_callback(::FLAC__StreamDecoderErrorStatus status) override {
+        if (!_error) {
+            _error = std::make_exception_ptr(std::runtime_error(std::string("FLAC decoding error: ") + FLAC__StreamDecoderErrorStatusString[status]));
+        }
+    }
+
+public:
+    explicit LeanFLACReader(SampleHandler handler) : _handler(handler) {}
+
+    void run(const std::string& path) noexcept(false) {
+        set_md5_checking(false);
+        set_metadata_ignore_all();
+
+        if (init(path) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            throw std::runtime_error("Error while opening '" + path + "'");
+        }
+
+        // Frame by frame rather than process_until_end_of_stream(), so that a trace shows
+        // every frame.
+        auto ok = true;
+        while (ok && get_state() != FLAC__STREAM_DECODER_END_OF_STREAM) {
+            flaccue::TraceScope trace("frame", "decode");
+            ok = process_single();
+        }
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        if (readError()) {
+            std::rethrow_exception(readError());
+        }
+        if (!ok) {
+            throw std::runtime_error("Error while decoding '" + path + "'");
+        }
+        finish();
+    }
+};
+
+// Decodes a list of FLAC files and hands their samples to a handler strictly in order, as
+// if they were one stream. With a parallelism above one, that many files are decoded at
+// the same time on their own threads, each into a bounded set of blocks of its own, while
+// the calling thread consumes them one after the other. Nothing has to be written, so
+// decoding ahead is all the ordering costs. The decoding threads' CPU time goes to the
+// calling thread's stage.
+class OrderedFileDecoder {
+    struct File {
+        flaccue::SampleBlockPool pool;
+        flaccue::SPSCQueue<flaccue::SampleBlock*> queue; // nullptr after the last block
+        std::atomic<bool> isCancelled;
+        std::exception_ptr error;
+        std::thread thread;
+
+        File(size_t numberOfBlocks, uint32_t samplesPerBlock)
+        : pool(numberOfBlocks, samplesPerBlock)
+        , queue(numberOfBlocks + 1)
+        , isCancelled(false) {}
+    };
+
+    class Cancelled : public std::exception {};
+
+    std::vector<std::string> _paths;
+    size_t _parallelism;
+    size_t _blocksPerFile;
+    uint32_t _samplesPerBlock;
+
+    static void decode(File& file, const std::string& path, flaccue::StageAccount account) {
+        flaccue::StageCPUTimer timer(account);
+        try {
+            const FLAC__int32* slice[flaccue::SampleBlock::MaxChannels];
+            LeanFLACReader reader([&](const FLAC__int32* const buffer[], unsigned channels, uint32_t count) {
+                for (uint32_t offset = 0; offset < count; ) {
+                    if (file.isCancelled.load(std::memory_order_relaxed)) {
+                        throw Cancelled();
+                    }
+                    auto block = file.pool.acquire(1);
+                    auto blockCount = std::min(count - offset, block->capacity());
+                    for (unsigned channel = 0; channel < channels && channel < flaccue::SampleBlock::MaxChannels; ++channel) {
+                        slice[channel] = buffer[channel] + offset;
+                    }
+                    try {
+                        block->assign(slice, channels, blockCount);
+                    } catch (...) {
+                        file.pool.release(block);
+                        throw;
+                    }
+                    file.queue.push(block);
+                    offset += blockCount;
+                }
+            });
+            reader.run(path);
+        } catch (const Cancelled&) {
+        } catch (...) {
+            file.error = std::current_exception();
+        }
+        file.queue.push(nullptr);
+    }
+
+public:
+    OrderedFileDecoder(const std::vector<std::string>& paths, size_t parallelism = 1, size_t blocksPerFile = 32, uint32_t samplesPerBlock = 4608)
+    : _paths(paths)
+    , _parallelism(std::max<size_t>(parallelism, 1))
+    , _blocksPerFile(blocksPerFile)
+    , _samplesPerBlock(samplesPerBlock) {}
+
+    // Rethrows the first error, of either decoding or the handler, once every thread has
+    // stopped.
+    void execute(const SampleHandler& handler) const noexcept(false) {
+        if (_parallelism == 1) {
+            for (auto& path : _paths) {
+                LeanFLACReader(handler).run(path);
+            }
+            return;
+        }
+
+        std::vector<std::unique_ptr<File>> files(_paths.size());
+        size_t started = 0;
+        std::exception_ptr error;
+
+        auto startNext = [&]() {
+            auto& file = files[started];
+            file = std::make_unique<File>(_blocksPerFile, _samplesPerBlock);
+            file->thread = std::thread(decode, std::ref(*file), std::cref(_paths[started]), flaccue::currentStageAccount());
+            ++started;
+        };
+        auto cancel = [&]() {
+            for (auto& file : files) {
+                if (file) {
+                    file->isCancelled.store(true, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        while (started < std::min(_parallelism, _paths.size())) {
+            startNext();
+        }
+        for (size_t i = 0; i < started; ++i) {
+            auto& file = *files[i];
+            // After a failure the queue is still drained, so the decoder never blocks on it.
+            while (auto block = file.queue.pop()) {
+                if (!error) {
+                    try {
+                        handler(block->channels(), block->numberOfChannels(), block->count());
+                    } catch (...) {
+                        error = std::current_exception();
+                        cancel();
+                    }
+                }
+                file.pool.release(block);
+            }
+            file.thread.join();
+            if (!error && file.error) {
+                error = file.error;
+                cancel();
+            }
+            files[i].reset();
+            if (!error && started < _paths.size()) {
+                startNext();
+            }
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}
+
+#endif /* Verify_h */
@@ -0,0 +1,389 @@
+//
+//  Watch.cpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include "Watch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <stdio.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "DiscSnapshot.hpp"
+#include "MD5.hpp"
+
+namespace flaccue {
+
+struct DirectoryEntry {
+    std::string name;
+    bool isDirectory;
+};
+
+// Hidden entries are skipped: they are where copying tools keep their partial files.
+static std::vector<DirectoryEntry> listDirectory(const std::string& path) {
+    std::vector<DirectoryEntry> entries;
+    auto dir = opendir(path.c_str());
+    if (!dir) {
+        return entries;
+    }
+    while (auto entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.empty() || name[0] == '.') {
+            continue;
+        }
+        bool isDirectory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat entryStat;
+            isDirectory = stat((path + "/" + name).c_str(), &entryStat) == 0 && S_ISDIR(entryStat.st_mode);
+        }
+        entries.push_back(DirectoryEntry { name, isDirectory });
+    }
+    closedir(dir);
+    return entries;
+}
+
+DirectoryWatcher::DirectoryWatcher(const std::vector<std::string>& roots, Clock::duration quietPeriod, Filter filter, bool forcePolling) noexcept(false)
+: _filter(filter ? filter : [](const std::string&, bool) { return true; })
+, _quietPeriod(quietPeriod)
+, _pollInterval(std::max<Clock::duration>(quietPeriod / 2, std::chrono::milliseconds(10)))
+, _nextPoll(Clock::now() + _pollInterval)
+, _inotify(-1)
+, _roots(roots) {
+#ifdef __linux__
+    if (!forcePolling) {
+        _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#endif
+    for (auto& root : _roots) {
+        struct stat rootStat;
+        auto error = stat(root.c_str(), &rootStat) != 0 ? errno : S_ISDIR(rootStat.st_mode) ? 0 : ENOTDIR;
+        if (error != 0) {
+            if (_inotify >= 0) {
+                close(_inotify);
+            }
+            throw std::system_error(error, std::generic_category(), "Can't watch '" + root + "'");
+        }
+        addTree(root);
+    }
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    if (_inotify >= 0) {
+        close(_inotify);
+    }
+}
+
+void DirectoryWatcher::addTree(const std::string& root) {
+    addDirectory(root);
+    for (auto& entry : listDirectory(root)) {
+        auto path = root + "/" + entry.name;
+        if (entry.isDirectory && _filter(path, true) && _directories.count(path) == 0) {
+            addTree(path);
+        }
+    }
+}
+
+void DirectoryWatcher::addDirectory(const std::string& path) {
+#ifdef __linux__
+    if (_inotify >= 0) {
+        // The watch goes first, so that nothing written after the listing below is missed.
+        auto mask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR;
+        auto watch = inotify_add_watch(_inotify, path.c_str(), mask);
+        if (watch < 0) {
+            return;
+        }
+        _watches[watch] = path;
+    }
+#endif
+
+    auto& directory = _directories[path];
+    for (auto& entry : listDirectory(path)) {
+        auto entryPath = path + "/" + entry.name;
+        if (entry.isDirectory || !_filter(entryPath, false)) {
+            continue;
+        }
+        if (isPolling()) {
+            if (auto source = cue::SourceInfo::Stat(entryPath)) {
+                directory.snapshot[entry.name] = std::make_pair((int64_t)source->size, source->modificationTime);
+            }
+        }
+        directory.isChanged = true;
+        directory.lastChange = Clock::now();
+    }
+}
+
+void DirectoryWatcher::removeDirectory(const std::string& path) {
+    auto prefix = path + "/";
+    auto isRemoved = [&](const std::string& directory) {
+        return directory == path || directory.compare(0, prefix.size(), prefix) == 0;
+    };
+    for (auto it = _watches.begin(); it != _watches.end(); ) {
+        if (isRemoved(it->second)) {
+#ifdef __linux__
+            inotify_rm_watch(_inotify, it->first);
+#endif
+            it = _watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = _directories.begin(); it != _directories.end(); ) {
+        it = isRemoved(it->first) ? _directories.erase(it) : std::next(it);
+    }
+}
+
+void DirectoryWatcher::markChanged(const std::string& directory) {
+    auto& entry = _directories[directory];
+    entry.isChanged = true;
+    entry.lastChange = Clock::now();
+}
+
+void DirectoryWatcher::readEvents() {
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (true) {
+        auto size = read(_inotify, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            return;
+        }
+        for (auto position = buffer; position < buffer + size; ) {
+            auto event = (const struct inotify_event*)position;
+            position += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost: every directory is suspect, and nobody knows which files
+                // are still open.
+                for (auto& directory : _directories) {
+                    directory.second.filesBeingWritten.clear();
+                    directory.second.isChanged = true;
+                    directory.second.lastChange = Clock::now();
+                }
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                _watches.erase(event->wd);
+                continue;
+            }
+
+            auto watch = _watches.find(event->wd);
+            if (watch == _watches.end() || event->len == 0 || event->name[0] == '.') {
+                continue;
+            }
+            auto directory = watch->second;
+            std::string name = event->name;
+            auto path = directory + "/" + name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    if (_filter(path, true) && _directories.count(path) == 0) {
+                        addTree(path);
+                    }
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removeDirectory(path);
+                }
+                continue;
+            }
+            if (!_filter(path, false)) {
+                continue;
+            }
+
+            auto& filesBeingWritten = _directories[directory].filesBeingWritten;
+            if (event->mask & IN_MODIFY) {
+                filesBeingWritten.insert(name);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM)) {
+                filesBeingWritten.erase(name);
+            }
+            markChanged(directory);
+        }
+    }
+#endif
+}
+
+void DirectoryWatcher::poll() {
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> stack(_roots.begin(), _roots.end());
+    while (!stack.empty()) {
+        auto path = stack.back();
+        stack.pop_back();
+        if (!seen.insert(path).second) {
+            continue;
+        }
+
+        std::map<std::string, std::pair<int64_t, int64_t>> snapshot;
+        for (auto& entry : listDirectory(path)) {
+            auto entryPath = path + "/" + entry.name;
+            if (entry.isDirectory) {
+                if (_filter(entryPath, true)) {
+                    stack.push_back(entryPath);
+                }
+            } else if (_filter(entryPath, false)) {
+                if (auto source = cue::SourceInfo::Stat(entryPath)) {
+                    snapshot[entry.name] = std::make_pair((int64_t)source->size, source->modificationTime);
+                }
+            }
+        }
+
+        auto directory = _directories.find(path);
+        if (directory == _directories.end()) {
+            directory = _directories.emplace(path, Directory()).first;
+            if (!snapshot.empty()) {
+                markChanged(path);
+            }
+        } else if (directory->second.snapshot != snapshot) {
+            markChanged(path);
+        }
+        directory->second.snapshot = std::move(snapshot);
+    }
+
+    for (auto it = _directories.begin(); it != _directories.end(); ) {
+        it = seen.count(it->first) == 0 ? _directories.erase(it) : std::next(it);
+    }
+}
+
+std::vector<std::string> DirectoryWatcher::settledDirectories() {
+    std::vector<std::string> result;
+    auto now = Clock::now();
+    for (auto& directory : _directories) {
+        auto& state = directory.second;
+        if (state.isChanged && state.filesBeingWritten.empty() && now - state.lastChange >= _quietPeriod) {
+            state.isChanged = false;
+            result.push_back(directory.first);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<std::string> DirectoryWatcher::wait(Clock::duration timeout) noexcept(false) {
+    auto deadline = Clock::now() + timeout;
+    while (true) {
+        auto settled = settledDirectories();
+        auto now = Clock::now();
+        if (!settled.empty() || now >= deadline) {
+            return settled;
+        }
+
+        auto wakeUp = deadline;
+        for (auto& directory : _directories) {
+            auto& state = directory.second;
+            if (state.isChanged && state.filesBeingWritten.empty()) {
+                wakeUp = std::min(wakeUp, state.lastChange + _quietPeriod);
+            }
+        }
+
+        if (isPolling()) {
+            std::this_thread::sleep_until(std::min(wakeUp, _nextPoll));
+            if (Clock::now() >= _nextPoll) {
+                poll();
+                _nextPoll = Clock::now() + _pollInterval;
+            }
+        } else {
+            auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(wakeUp - now).count() + 1;
+            struct pollfd descriptor = { _inotify, POLLIN, 0 };
+            auto result = ::poll(&descriptor, 1, (int)std::min<long long>(milliseconds, INT32_MAX));
+            if (result < 0 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "Failed to wait for file system events");
+            }
+            if (result > 0) {
+                readEvents();
+            }
+        }
+    }
+}
+
+JobQueue::JobQueue(const std::string& directory) noexcept(false)
+: _directory(directory) {
+    if (mkdir(_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + _directory + "'");
+    }
+}
+
+std::string JobQueue::jobPath(const std::string& path) const {
+    MD5 md5;
+    md5.update(path.data(), path.size());
+    return _directory + "/" + MD5::toString(md5.digest()) + ".job";
+}
+
+bool JobQueue::push(const std::string& path) noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto job = jobPath(path);
+    if (access(job.c_str(), F_OK) == 0) {
+        return false;
+    }
+
+    auto slash = job.rfind('/');
+    auto temporaryPath = job.substr(0, slash + 1) + "." + job.substr(slash + 1) + ".tmp";
+    auto fileDescriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create '" + temporaryPath + "'");
+    }
+    auto written = ::write(fileDescriptor, path.data(), path.size());
+    if (written != (ssize_t)path.size() || fsync(fileDescriptor) != 0) {
+        auto error = written < 0 || written == (ssize_t)path.size() ? errno : EIO;
+        close(fileDescriptor);
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to write '" + temporaryPath + "'");
+    }
+    close(fileDescriptor);
+    if (rename(temporaryPath.c_str(), job.c_str()) != 0) {
+        auto error = errno;
+        unlink(temporaryPath.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to rename '" + temporaryPath + "'");
+    }
+    return true;
+}
+
+std::vector<std::string> JobQueue::pending() const noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::pair<int64_t, std::string>> jobs;
+    for (auto& entry : listDirectory(_directory)) {
+        static const std::string JobSuffix = ".job";
+        if (entry.isDirectory || entry.name.size() <= JobSuffix.size() || entry.name.compare(entry.name.size() - JobSuffix.size(), JobSuffix.size(), JobSuffix) != 0) {
+            continue;
+        }
+        auto job = _directory + "/" + entry.name;
+        auto source = cue::SourceInfo::Stat(job);
+        std::ifstream input(job, std::ios::binary);
+        if (!source || !input) {
+            continue; // completed meanwhile
+        }
+        std::stringstream path;
+        path << input.rdbuf();
+        jobs.emplace_back(source->modificationTime, path.str());
+    }
+    std::sort(jobs.begin(), jobs.end());
+
+    std::vector<std::string> result;
+    for (auto& job : jobs) {
+        result.push_back(std::move(job.second));
+    }
+    return result;
+}
+
+void JobQueue::complete(const std::string& path) noexcept(false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto job = jobPath(path);
+    if (unlink(job.c_str()) != 0 && errno != ENOENT) {
+        throw std::system_error(errno, std::generic_category(), "Failed to remove '" + job + "'");
+    }
+}
+
+}
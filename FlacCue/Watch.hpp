@@ -0,0 +1,102 @@
+//
+//  Watch.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef Watch_h
+#define Watch_h
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace flaccue {
+
+// Watches directory trees and reports the directories whose files changed, once nothing
+// has happened in them for a quiet period and no file in them is still open for writing.
+// Uses inotify on Linux, with a watch per directory; subdirectories created later are
+// picked up as they appear. Elsewhere, or if inotify is unavailable, the trees are
+// rescanned every poll interval and compared with the previous scan.
+//
+// Every directory counts as changed when watching starts, so that whatever arrived while
+// nobody was watching gets reported too.
+class DirectoryWatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Decides which entries matter: directories it rejects aren't watched at all, and
+    // changes to files it rejects are ignored. Gets the full path.
+    using Filter = std::function<bool(const std::string& path, bool isDirectory)>;
+
+private:
+    struct Directory {
+        // The files changed in the directory, being written until closed (inotify only).
+        std::unordered_set<std::string> filesBeingWritten;
+        // Name, size and modification time of every relevant file (polling only).
+        std::map<std::string, std::pair<int64_t, int64_t>> snapshot;
+        bool isChanged = false;
+        Clock::time_point lastChange;
+    };
+
+    Filter _filter;
+    Clock::duration _quietPeriod;
+    Clock::duration _pollInterval;
+    Clock::time_point _nextPoll;
+    int _inotify;
+    std::vector<std::string> _roots;
+    std::unordered_map<int, std::string> _watches;
+    std::unordered_map<std::string, Directory> _directories;
+
+    void addTree(const std::string& root);
+    void addDirectory(const std::string& path);
+    void removeDirectory(const std::string& path);
+    void markChanged(const std::string& directory);
+    void readEvents();
+    void poll();
+    std::vector<std::string> settledDirectories();
+
+public:
+    explicit DirectoryWatcher(const std::vector<std::string>& roots, Clock::duration quietPeriod = std::chrono::seconds(2), Filter filter = nullptr, bool forcePolling = false) noexcept(false);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    bool isPolling() const { return _inotify < 0; }
+    size_t numberOfDirectories() const { return _directories.size(); }
+
+    // Blocks until some directories settle or the timeout passes, and returns the settled
+    // ones. Each change is reported once.
+    std::vector<std::string> wait(Clock::duration timeout) noexcept(false);
+};
+
+// Persistent queue of paths, one file per job in a directory of its own, written to a
+// temporary name first so that a crash never leaves half a job behind. Jobs are pending
+// until completed, across restarts too, and come out in the order they were pushed.
+// Thread safe.
+class JobQueue {
+    std::string _directory;
+    mutable std::mutex _mutex;
+
+    std::string jobPath(const std::string& path) const;
+
+public:
+    // Creates the directory if needed.
+    explicit JobQueue(const std::string& directory) noexcept(false);
+
+    // False if the path is already pending.
+    bool push(const std::string& path) noexcept(false);
+    std::vector<std::string> pending() const noexcept(false);
+    void complete(const std::string& path) noexcept(false);
+};
+
+}
+
+#endif /* Watch_h */
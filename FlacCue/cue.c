@@ -10,11 +10,6 @@
 
 #include <stdlib.h>
 
-void CueCommandListInit(struct CueCommandList* commandList) {
-    commandList->head = NULL;
-    commandList->end = NULL;
-}
-
 void CueCommandDestroy(struct CueCommand* command) {
     switch (command->type) {
         case CueCommandTypeCatalog: free(command->catalog); break;
@@ -33,29 +28,3 @@ void CueCommandDestroy(struct CueCommand* command) {
         default: break;
     }
 }
-
-void CueCommandListDestroy(struct CueCommandList* commandList) {
-    struct CueCommandListItem* item = commandList->head;
-    while (item != NULL) {
-        struct CueCommandListItem* next = item->next;
-        CueCommandDestroy(&item->command);
-        free(item);
-        item = next;
-    }
-    commandList->head = NULL;
-    commandList->end = NULL;
-}
-
-void CueCommandListAppend(struct CueCommandList* commandList, struct CueCommand* command) {
-    struct CueCommandListItem* item = malloc(sizeof(*item));
-    item->command = *command;
-    item->next = NULL;
-    
-    if (commandList->head == NULL) {
-        commandList->head = item;
-    } else {
-        commandList->end->next = item;
-    }
-    
-    commandList->end = item;
-}
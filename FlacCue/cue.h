@@ -65,21 +65,15 @@ struct CueCommand {
     };
 };
 
-struct CueCommandListItem {
-    struct CueCommand command;
-    struct CueCommandListItem* next;
-};
+void CueCommandDestroy(struct CueCommand* command);
 
-struct CueCommandList {
-    struct CueCommandListItem* head;
-    struct CueCommandListItem* end;
+/* Invoked for every command in input order. The command's strings are freed after the
+   callback returns. A non-zero return value aborts parsing. */
+struct CueParserCallbacks {
+    int (*commandCallback)(void * context, const struct CueCommand* command, int line);
+    void * context;
 };
 
-void CueCommandListInit(struct CueCommandList* commandList);
-void CueCommandListDestroy(struct CueCommandList* commandList);
-void CueCommandListAppend(struct CueCommandList* commandList, struct CueCommand* command);
-void CueCommandDestroy(struct CueCommand* command);
-
 struct CueParserExtra {
     int (*readCallback)(void * context, void * buffer, int maxSize);
     void * context;
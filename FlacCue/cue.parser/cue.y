@@ -11,7 +11,7 @@
 #include "cue.lex.h"
 extern YY_DECL;
 
-static void yyerror(YYLTYPE* llocp, void* scanner, struct CueCommandList* result, char** error, int* errorLine, const char* errorMessage) {
+static void yyerror(YYLTYPE* llocp, void* scanner, struct CueParserCallbacks* callbacks, char** error, int* errorLine, const char* errorMessage) {
     if (error != NULL) {
         *error = strdup(errorMessage);
         *errorLine = llocp->last_line;
@@ -25,7 +25,7 @@ static void yyerror(YYLTYPE* llocp, void* scanner, struct CueCommandList* result
 %define parse.error verbose
 %lex-param { void* scanner }
 %locations
-%parse-param { void* scanner } { struct CueCommandList* result } { char** error } { int* errorLine }
+%parse-param { void* scanner } { struct CueParserCallbacks* callbacks } { char** error } { int* errorLine }
 
 %union {
     struct CueCommand command;
@@ -55,7 +55,11 @@ static void yyerror(YYLTYPE* llocp, void* scanner, struct CueCommandList* result
 commandList
     : {}
     | commandList command {
-        CueCommandListAppend(result, &$2);
+        int status = callbacks->commandCallback(callbacks->context, &$2, @2.last_line);
+        CueCommandDestroy(&$2);
+        if (status != 0) {
+            YYABORT;
+        }
     }
 ;
 
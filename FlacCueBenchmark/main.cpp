@@ -0,0 +1,196 @@
+//
+//  main.cpp
+//  FlacCueBenchmark
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <boost/format.hpp>
+
+#include "FlacCue.h"
+
+static std::atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    if (void* result = malloc(size == 0 ? 1 : size)) {
+        return result;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// Generates cue sheets resembling the ones found in real libraries: single image and
+// file-per-track layouts, hidden tracks, pregaps, REM heavy headers, both line endings
+// and quoted strings with escapes.
+class CueSheetGenerator {
+    std::mt19937 _random;
+
+    int uniform(int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(_random);
+    }
+
+    bool chance(double probability) {
+        return std::bernoulli_distribution(probability)(_random);
+    }
+
+    std::string word() {
+        static const char* words[] = {
+            "Love", "Night", "Blue", "Song", "Heart", "River", "Dream", "Fire", "Road", "Light",
+            "Moon", "Time", "Rain", "Stone", "Home", "City", "Ghost", "Dance", "Gold", "Sky"
+        };
+        return words[uniform(0, sizeof(words) / sizeof(words[0]) - 1)];
+    }
+
+    std::string phrase() {
+        std::string result = word();
+        for (auto i = uniform(0, 4); i > 0; --i) {
+            result += ' ';
+            result += word();
+        }
+        if (chance(0.1)) {
+            result += " \\\"Live\\\"";
+        }
+        return result;
+    }
+
+    std::string quoted(const std::string& s) {
+        return '"' + s + '"';
+    }
+
+    static std::string msf(const cue::Time& time) {
+        return cue::to_string(time);
+    }
+
+public:
+    explicit CueSheetGenerator(unsigned seed) : _random(seed) {}
+
+    std::string generate() {
+        std::string newline = chance(0.5) ? "\r\n" : "\n";
+        std::ostringstream sheet;
+
+        auto numberOfRems = chance(0.3) ? uniform(10, 40) : uniform(0, 4);
+        sheet << "REM GENRE " << word() << newline;
+        sheet << "REM DATE " << uniform(1950, 2025) << newline;
+        sheet << "REM DISCID " << std::hex << std::setw(8) << std::setfill('0') << (uint32_t)_random() << std::dec << newline;
+        for (auto i = 0; i < numberOfRems; ++i) {
+            sheet << "REM COMMENT \"" << phrase() << "\"" << newline;
+        }
+        if (chance(0.5)) {
+            sheet << "CATALOG " << std::setw(13) << std::setfill('0') << (uint64_t)_random() * 1000 % 10000000000000ULL << newline;
+        }
+        auto albumArtist = phrase();
+        sheet << "PERFORMER " << quoted(albumArtist) << newline;
+        sheet << "TITLE " << quoted(phrase()) << newline;
+
+        auto numberOfTracks = uniform(1, 99);
+        auto filePerTrack = chance(0.4);
+        auto hasHTOA = !filePerTrack && chance(0.2);
+        // Keeps every timestamp below 80 minutes, like a real CD.
+        auto framesPerTrack = 80 * 60 * cue::CdFramesPerSecond / numberOfTracks;
+        cue::Time position = 0;
+
+        if (!filePerTrack) {
+            sheet << "FILE " << quoted(phrase() + ".flac") << " WAVE" << newline;
+        }
+        for (auto track = 1; track <= numberOfTracks; ++track) {
+            if (filePerTrack) {
+                sheet << "FILE " << (chance(0.5) ? quoted(phrase() + ".flac") : word() + ".flac") << " WAVE" << newline;
+                position = 0;
+            }
+            sheet << "  TRACK " << std::setw(2) << std::setfill('0') << track << " AUDIO" << newline;
+            sheet << "    TITLE " << quoted(phrase()) << newline;
+            sheet << "    PERFORMER " << (chance(0.8) ? quoted(albumArtist) : word()) << newline;
+            if (chance(0.3)) {
+                sheet << "    SONGWRITER " << quoted(phrase()) << newline;
+            }
+            if (chance(0.3)) {
+                sheet << "    ISRC USABC" << std::setw(7) << std::setfill('0') << uniform(0, 9999999) << newline;
+            }
+            if (chance(0.1)) {
+                sheet << "    FLAGS DCP" << newline;
+            }
+            for (auto i = chance(0.2) ? uniform(1, 5) : 0; i > 0; --i) {
+                sheet << "    REM REPLAYGAIN_TRACK_GAIN -" << uniform(0, 12) << "." << uniform(10, 99) << " dB" << newline;
+            }
+            if ((track == 1 && hasHTOA) || (!filePerTrack && track > 1 && chance(0.3))) {
+                sheet << "    INDEX 00 " << msf(position) << newline;
+                position = position + cue::Time(0, 0, uniform(0, 5 * cue::CdFramesPerSecond));
+            }
+            sheet << "    INDEX 01 " << msf(position) << newline;
+            position = position + cue::Time(0, 0, uniform(4 * cue::CdFramesPerSecond, framesPerTrack - 6 * cue::CdFramesPerSecond));
+        }
+        return sheet.str();
+    }
+};
+
+class EmptyVisitor : public cue::ParseVisitor {};
+
+template<typename F> static void measure(const std::string& name, const std::vector<std::string>& sheets, size_t totalBytes, F f) {
+    auto allocationsBefore = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    for (auto& sheet : sheets) {
+        std::istringstream stream(sheet);
+        f(stream);
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto allocations = allocationCount.load() - allocationsBefore;
+
+    std::cout << boost::format("%-22s %9.2f MB/s %12.0f sheets/s %10.1f allocations/sheet")
+        % name
+        % (totalBytes / seconds / 1e6)
+        % (sheets.size() / seconds)
+        % ((double)allocations / sheets.size())
+    << std::endl;
+}
+
+int main(int argc, const char * argv[]) {
+    size_t numberOfSheets = argc > 1 ? std::stoul(argv[1]) : 20000;
+    unsigned seed = argc > 2 ? (unsigned)std::stoul(argv[2]) : 1;
+
+    CueSheetGenerator generator(seed);
+    std::vector<std::string> sheets;
+    size_t totalBytes = 0;
+    sheets.reserve(numberOfSheets);
+    for (size_t i = 0; i < numberOfSheets; ++i) {
+        sheets.push_back(generator.generate());
+        totalBytes += sheets.back().size();
+    }
+
+    std::cout << "Corpus: " << numberOfSheets << " sheets, " << totalBytes << " bytes (seed " << seed << ")" << std::endl;
+    std::cout << "Allocations are those made through operator new; the lexer's malloc calls are not counted." << std::endl;
+
+    size_t tokens = 0;
+    measure("lexer", sheets, totalBytes, [&](std::istream& input) {
+        tokens += cue::tokenize(input);
+    });
+    measure("lexer + parser", sheets, totalBytes, [&](std::istream& input) {
+        EmptyVisitor visitor;
+        cue::parse(input, visitor);
+    });
+    measure("cue::Disc", sheets, totalBytes, [&](std::istream& input) {
+        cue::Disc disc(input);
+    });
+    measure("cue::CompactDisc", sheets, totalBytes, [&](std::istream& input) {
+        cue::CompactDisc disc(input);
+    });
+
+    std::cout << "Tokens: " << tokens << std::endl;
+    return 0;
+}
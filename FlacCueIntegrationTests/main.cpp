@@ -23,6 +23,12 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <tuple>
+#include <atomic>
+#include <mutex>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <limits>
 #include <math.h>
 
 extern "C" {
@@ -30,8 +36,13 @@ extern "C" {
 }
 
 #include "FlacCue.h"
+#include "SplitExecutor.hpp"
+#include "FramePassthrough.hpp"
+#include "SplitEncoder.hpp"
+#include "Verify.hpp"
+#include "FLACSampleSink.hpp"
 
-class CURLException : std::runtime_error {
+class CURLException : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
 };
@@ -86,18 +97,54 @@ public:
     }
 };
 
-class FLACLambdaReader : public FLAC::Decoder::File {
+// Feeds audio to the AccurateRip checksum generator, whatever format it was read from.
+class AccurateRipSampleSink : public cue::SampleSink {
+    accuraterip::ChecksumGenerator& _checksumGenerator;
+    flaccue::Metrics* _metrics;
+    // Runs from the first block of an output to its end(): reading the clocks around every
+    // block would cost a noticeable part of checksumming it. The wall time thus includes
+    // waiting for the blocks; the thread's CPU time doesn't.
+    std::optional<flaccue::StageTimer> _timer;
+    
+    flaccue::StageTimer& timer() {
+        if (!_timer) {
+            _timer.emplace(_metrics, flaccue::Stage::Checksum);
+        }
+        return *_timer;
+    }
+    
 public:
-    std::function<::FLAC__StreamDecoderWriteStatus(const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[])> writeCallback;
-    std::function<void(::FLAC__StreamDecoderErrorStatus status)> errorCallback;
+    explicit AccurateRipSampleSink(accuraterip::ChecksumGenerator& checksumGenerator, flaccue::Metrics* metrics = nullptr)
+    : _checksumGenerator(checksumGenerator)
+    , _metrics(metrics) {}
+    
+    virtual void begin(const cue::StreamFormat& format) override {
+        if (format.channels != 2 || format.bitsPerSample != 16) {
+            throw std::runtime_error("AccurateRip needs 16-bit stereo audio");
+        }
+    }
+    
+    // Without begin() and end() when decoded straight from whole files, so the channels
+    // are checked here too.
+    virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) override {
+        if (channels != 2) {
+            throw std::runtime_error("AccurateRip needs stereo audio");
+        }
+        flaccue::TraceScope trace("batch", "checksum");
+        timer().addSamples(count);
+        _checksumGenerator.processSamples(buffer, count);
+    }
     
-protected:
-    virtual ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[]) override {
-        return writeCallback(frame, buffer);
+    // CD audio as stored in WAV files and images is exactly what the checksums work on.
+    virtual void processInterleaved(const uint8_t* data, const cue::StreamFormat& format, bool isBigEndian, uint32_t count) override {
+        flaccue::TraceScope trace("batch", "checksum");
+        timer().addSamples(count);
+        timer().addBytes((uint64_t)count * 4);
+        _checksumGenerator.processInterleavedSamples(data, count, isBigEndian);
     }
     
-    virtual void error_callback(::FLAC__StreamDecoderErrorStatus status) override {
-        return errorCallback(status);
+    virtual void end() override {
+        _timer.reset();
     }
 };
 
@@ -109,18 +156,17 @@ static inline std::string dirname(std::string const path) {
     return result;
 }
 
-static cue::Time readFileLength(const std::string& path) {
-    FLACLambdaReader reader;
-    auto initStatus = reader.init(path);
-    if (initStatus != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
-        std::cerr << "Error while opening " << path << std::endl;
-        abort();
-    }
-    reader.process_until_end_of_metadata();
-    cue::Time result = reader.get_total_samples();
-    reader.finish();
-    return result;
-}
+// Runs a function when leaving a scope, however that happens.
+class ScopeExit {
+    std::function<void()> _action;
+
+public:
+    explicit ScopeExit(std::function<void()> action) : _action(std::move(action)) {}
+    ~ScopeExit() { _action(); }
+
+    ScopeExit(const ScopeExit&) = delete;
+    ScopeExit& operator=(const ScopeExit&) = delete;
+};
 
 template<typename T> T fallback(const T& lastResort) {
     return lastResort;
@@ -150,6 +196,11 @@ template<typename T> static inline T center(const T& t, unsigned width, typename
     return result;
 }
 
+// FLAC, or uncompressed audio that is checksummed in place.
+static inline bool isAudioFile(const std::string& file) {
+    return hasSuffix(file, ".flac") || hasSuffix(file, ".wav") || hasSuffix(file, ".bin");
+}
+
 static inline std::string msfString(const cue::Time& time) {
     auto msf = time.cueTime();
     return (boost::format("%1%:%2%:%3%") %
@@ -178,6 +229,9 @@ public:
 static std::vector<std::string> filesInDir(const std::string& dirPath) {
     std::vector<std::string> result;
     auto dir = opendir(dirPath.c_str());
+    if (!dir) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open '" + dirPath + "'");
+    }
     struct dirent *ent;
     while ((ent = readdir(dir)) != NULL) {
         if (ent->d_type == DT_REG) {
@@ -188,30 +242,6 @@ static std::vector<std::string> filesInDir(const std::string& dirPath) {
     return result;
 }
 
-static std::vector<cue::Time> createTOC(const cue::Disc& disc, const std::unordered_map<std::string, cue::Time>& fileLengths) {
-    std::vector<cue::Time> toc;
-    
-    cue::File const* currentFile = nullptr;
-    cue::Time currentFileBeginTime = disc.tracksCbegin()->pregap.value_or(0);
-    for_each(disc.tracksCbegin(), disc.tracksCend(), [&](const cue::Track& track) {
-        for_each(track.indexesCbegin(), track.indexesCend(), [&](const cue::Index& index) {
-            if (&index.file() != currentFile) {
-                currentFileBeginTime = currentFileBeginTime + (currentFile == nullptr ? 0 : fileLengths.find(currentFile->path)->second);
-                currentFile = &index.file();
-            }
-            if (index.index == 1) {
-                if (track.pregap && *track.pregap > 0 && track.number != 1) {
-                    throw "Non-zero pregap (" + (std::stringstream() << track.pregap.value()).str() + ") on track " + std::to_string(track.number);
-                }
-                toc.push_back(currentFileBeginTime + index.begin);
-            }
-        });
-    });
-    toc.push_back(currentFileBeginTime + fileLengths.find(currentFile->path)->second);
-    
-    return toc;
-}
-
 static std::string filenameSafeString(const std::string& str) {
     std::string result = str;
     std::replace(result.begin(), result.end(), '/', '_');
@@ -240,330 +270,1119 @@ static std::string createOffsetIntervalsString(const std::vector<int32_t>& offse
     return result.str();
 }
 
-int main(int argc, const char * argv[]) {
-    if (argc < 2) {
-        std::cerr << "No path specified!" << std::endl;
+// The directory an album's files are in: the album itself, or where its cue sheet is.
+static std::optional<std::string> albumDirectory(const std::string& path) {
+    struct stat pathStat;
+    if (stat(path.c_str(), &pathStat) != 0) {
+        return std::nullopt;
+    }
+    return S_ISDIR(pathStat.st_mode) ? path : dirname(path);
+}
+
+// The audio files of an album that hasn't been parsed yet: all of the ones next to it.
+static std::vector<std::string> guessAlbumInputPaths(const std::string& path) {
+    auto directory = albumDirectory(path);
+    if (!directory) {
+        return {};
     }
+    auto& dir = *directory;
+    std::vector<std::string> result;
+    for (auto& file : filesInDir(dir)) {
+        if (isAudioFile(file)) {
+            result.push_back(dir + "/" + file);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static int parseTree(const std::string& root) {
+    flaccue::ThreadPool pool;
+    cue::BatchParser parser(pool);
     
-    for (auto i = 1; i < argc; ++i) {
-        std::string path = argv[i];
-        std::cerr << "Processing: " << path << std::endl;
-        
-        struct stat pathStat;
-        stat(path.c_str(), &pathStat);
-        
-        std::string cueDir;
-        std::shared_ptr<cue::Disc> disc = nullptr;
-        if (S_ISREG(pathStat.st_mode)) {
-            cueDir = dirname(path);
-            std::ifstream input(path);
-            disc = std::make_shared<cue::Disc>(input);
-            input.close();
-        } else if (S_ISDIR(pathStat.st_mode)) {
-            std::cout << "Specified directory, synthesising dummy cue sheet." << std::endl;
-            
-            disc = std::make_shared<cue::Disc>();
-            cueDir = path;
-            auto filesInCueDir = filesInDir(cueDir);
-            std::vector<std::string> flacFiles;
-            std::copy_if(filesInCueDir.begin(), filesInCueDir.end(), std::back_inserter(flacFiles), [](const std::string& file) {
-                return hasSuffix(file, ".flac");
-            });
-            
-            std::sort(flacFiles.begin(), flacFiles.end());
-            for (auto fileName : flacFiles) {
-                auto& file = disc->addFile();
-                file.path = fileName;
-                file.fileType = "WAVE";
-                auto& track = disc->addTrack();
-                track.number = (int)(disc->tracksCend() - disc->tracksCbegin());
-                track.dataType = "AUDIO";
-                auto& index = track.addIndex();
-                index.index = 1;
-                index.begin = 0;
-                index.setFile(file);
+    size_t parsed = 0;
+    size_t failed = 0;
+    parser.parseTree(root, [&](const std::string& path, std::shared_ptr<cue::Disc> disc, std::exception_ptr error) {
+        if (error) {
+            ++failed;
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                std::cerr << path << ": " << e.what() << std::endl;
             }
         } else {
-            throw std::runtime_error("Unknown file: " + path);
+            ++parsed;
+            std::cout << path << ": " << (disc->tracksCend() - disc->tracksCbegin()) << " tracks" << std::endl;
         }
-        
-        std::vector<std::string> flacFilesInCueDir;
-        {
-            auto filesInCueDir = filesInDir(cueDir);
-            std::copy_if(filesInCueDir.begin(), filesInCueDir.end(), std::back_inserter(flacFilesInCueDir), [](const std::string& file) {
-                return hasSuffix(file, ".flac");
-            });
+    });
+    
+    std::cerr << "Parsed " << parsed << " cue sheets, " << failed << " failed." << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+struct Options {
+    // By default split outputs copy the input frames and only re-encode around the split
+    // points; --reencode encodes everything from scratch, one output per thread. FLAC
+    // inputs are then decoded twice: once in disc order for the checksums, and once more
+    // by the encoding tasks, each seeking to its own output.
+    bool reencode = false;
+    // --verify-only computes the checksums without writing a canonicalized disc.
+    bool verifyOnly = false;
+    // --compression-level, and --encoder-threads: threads libFLAC may use within a single
+    // output (libFLAC 1.5 and later), on top of --threads.
+    cue::EncoderSettings encoderSettings;
+    size_t numberOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    // Albums processed at the same time (--jobs, at most numberOfThreads); their tasks
+    // share one pool of numberOfThreads workers.
+    size_t numberOfJobs = 0;
+    // Decoding threads an album may start outside the pool.
+    size_t threadsPerAlbum = 1;
+    // Inputs of the current and the next album are read ahead, up to this many MiB.
+    size_t prefetchBudget = flaccue::Prefetcher::DefaultBudget >> 20;
+    // --manifest: albums recorded there with unchanged inputs are skipped. Watching always
+    // keeps one, inside the first watched directory by default, or every restart would
+    // process the whole tree again.
+    std::string manifestPath;
+    // --watch: runs until interrupted, processing the albums that land in these directories.
+    std::vector<std::string> watchDirectories;
+    // --queue: where the albums waiting to be processed are kept; inside the first watched
+    // directory by default.
+    std::string queueDirectory;
+    // --quiet-period: seconds a directory has to stay unchanged before its albums are queued.
+    unsigned quietPeriod = 2;
+    // --shard-dir: shares the albums with other processes using the same directory, each
+    // recording its results in a manifest of its own there, unless --manifest is given.
+    std::string shardDirectory;
+    // --worker: this process's name among them; host name and PID by default.
+    std::string workerName;
+    // --run: the run the workers share. Which albums are done is kept per run, so running
+    // again with another ID processes everything again (subject to --manifest). The UTC
+    // date by default, which suits nightly runs; workers started on different days have to
+    // be given the same ID.
+    std::string runID;
+    // --lease: seconds after which the albums of a worker that stopped renewing its leases
+    // are taken over.
+    unsigned leaseDuration = (unsigned)flaccue::LeaseDirectory::DefaultDuration.count();
+    // --merge: merges the manifests in --shard-dir into this one, and does nothing else.
+    std::string mergedManifestPath;
+    // --metrics: JSON lines with the time spent in each stage, per album and for the run.
+    // CPU time includes the album's decoding threads and pool tasks, but not the threads
+    // libFLAC starts itself for --encoder-threads.
+    std::string metricsPath;
+    // --trace: a Chrome trace of what each thread did, for Perfetto or chrome://tracing.
+    std::string tracePath;
+    // --prometheus: a .prom file for node_exporter's textfile collector, rewritten every
+    // --prometheus-interval seconds.
+    std::string prometheusPath;
+    unsigned prometheusInterval = 15;
+    
+    // What the results of an album depend on besides its files.
+    std::string settings() const {
+        if (verifyOnly) {
+            return "verify-only";
         }
-        
-        std::vector<std::string> filesInCueSheet;
-        {
-            std::for_each(disc->filesCbegin(), disc->filesCend(), [&](const cue::File& file) {
-                filesInCueSheet.push_back(file.path);
-            });
+        return (reencode ? "reencode " : "passthrough ") + std::to_string(encoderSettings.compressionLevel);
+    }
+};
+
+// What the albums of a run share.
+struct Runtime {
+    flaccue::ThreadPool& pool;
+    flaccue::Prefetcher& prefetcher;
+    cue::Manifest* manifest;
+    flaccue::MetricsReport* metricsReport;
+    flaccue::PrometheusMetrics* prometheus;
+    std::mutex outputMutex;
+};
+
+static void declarePrometheusMetrics(flaccue::PrometheusMetrics& prometheus) {
+    prometheus.declareCounter("flaccue_albums_total", "Albums processed, by result.");
+    prometheus.declareGauge("flaccue_albums_in_progress", "Albums being processed.");
+    prometheus.declareGauge("flaccue_queue_depth", "Albums waiting to be processed, including the ones in progress in watch mode.");
+    prometheus.declareGauge("flaccue_last_album_timestamp_seconds", "Unix time at which the last album finished.");
+    prometheus.declareHistogram("flaccue_album_duration_seconds", "Wall time per album.", flaccue::exponentialBuckets(1, 2, 12));
+    prometheus.declareCounter("flaccue_manifest_lookups_total", "Albums looked up in the manifest, by whether their verification could be reused.");
+    prometheus.declareCounter("flaccue_decoded_samples_total", "Samples decoded.");
+    prometheus.declareHistogram("flaccue_decode_samples_per_second", "Decoding throughput per album.", flaccue::exponentialBuckets(1e5, 2, 12));
+    prometheus.declareCounter("flaccue_checksummed_samples_total", "Samples checksummed for AccurateRip.");
+    prometheus.declareHistogram("flaccue_checksum_samples_per_second", "Checksumming throughput per album.", flaccue::exponentialBuckets(1e5, 2, 12));
+    prometheus.declareCounter("flaccue_encoded_bytes_total", "Bytes of split files written.");
+    prometheus.declareHistogram("flaccue_encode_bytes_per_second", "Encoding throughput per album.", flaccue::exponentialBuckets(1 << 20, 2, 12));
+    prometheus.declareCounter("flaccue_accuraterip_lookups_total", "AccurateRip database lookups, by result.");
+    prometheus.declareCounter("flaccue_accuraterip_tracks_total", "Tracks compared against AccurateRip data, by result.");
+}
+
+// Totals and throughputs of a finished album; throughput only for stages that ran.
+static void recordAlbum(flaccue::PrometheusMetrics& prometheus, bool succeeded, std::chrono::steady_clock::duration wallTime, const flaccue::Metrics& metrics) {
+    prometheus.increment("flaccue_albums_total", 1, {{ "result", succeeded ? "succeeded" : "failed" }});
+    prometheus.set("flaccue_last_album_timestamp_seconds", (double)time(nullptr));
+    prometheus.observe("flaccue_album_duration_seconds", std::chrono::duration<double>(wallTime).count());
+    
+    auto addStage = [&](flaccue::Stage stage, bool inSamples, const char* total, const char* perSecond) {
+        auto totals = metrics.totals(stage);
+        auto amount = inSamples ? totals.samples : totals.bytes;
+        prometheus.increment(total, (double)amount);
+        if (amount > 0 && totals.wallNanoseconds > 0) {
+            prometheus.observe(perSecond, amount / (totals.wallNanoseconds / 1e9));
         }
-        
-        std::unordered_map<std::string, std::string> cueSheetFilenameMap;
-        bool needGuessing = !std::all_of(filesInCueSheet.cbegin(), filesInCueSheet.cend(), [&](const std::string& fileInCueSheet) {
-            return std::find(flacFilesInCueDir.cbegin(), flacFilesInCueDir.cend(), fileInCueSheet) != flacFilesInCueDir.cend();
-        });
-        if (needGuessing) {
-            if (flacFilesInCueDir.size() != filesInCueSheet.size()) {
-                throw std::runtime_error(
-                    "Can't guess filenames because the number of files in the directory (" + std::to_string(flacFilesInCueDir.size()) + ")"
-                    "is not the same as the number of files in the cue sheet (" + std::to_string(filesInCueSheet.size()) + ")");
-            }
-            
-            std::sort(flacFilesInCueDir.begin(), flacFilesInCueDir.end());
-            std::sort(filesInCueSheet.begin(), filesInCueSheet.end());
-            
-            std::cout << "Filenames in the cue sheet are incorrect. Guessing filenames:" << std::endl;
-            auto flacFileInCueDir = flacFilesInCueDir.cbegin();
-            for (auto fileInCueSheet : filesInCueSheet) {
-                cueSheetFilenameMap[fileInCueSheet] = *flacFileInCueDir;
-                std::cout << "'" << fileInCueSheet <<  "' is '" << *flacFileInCueDir << "'" << std::endl;
-                ++flacFileInCueDir;
-            }
+    };
+    addStage(flaccue::Stage::Decode, true, "flaccue_decoded_samples_total", "flaccue_decode_samples_per_second");
+    addStage(flaccue::Stage::Checksum, true, "flaccue_checksummed_samples_total", "flaccue_checksum_samples_per_second");
+    addStage(flaccue::Stage::Encode, false, "flaccue_encoded_bytes_total", "flaccue_encode_bytes_per_second");
+}
+
+// Hash of the cue sheet (none for a directory) and of the names of the audio files next to
+// it, which decide how the cue sheet's file names are resolved.
+static flaccue::MD5::Digest cueSheetDigest(const std::string& path, const std::string& cueDir) {
+    flaccue::MD5 md5;
+    if (path != cueDir) {
+        std::ifstream input(path, std::ios::binary);
+        char buffer[4096];
+        while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0) {
+            md5.update(buffer, (size_t)input.gcount());
+        }
+    }
+    auto files = filesInDir(cueDir);
+    std::sort(files.begin(), files.end());
+    for (auto& file : files) {
+        if (isAudioFile(file)) {
+            md5.update(file.c_str(), file.size() + 1);
+        }
+    }
+    return md5.digest();
+}
+
+static void printVerification(const cue::AlbumVerification& verification, std::ostream& output) {
+    output << " #     V1    V1_Fr450    V2    AccurateRip" << std::endl;
+    for (size_t i = 0; i < verification.tracks.size(); ++i) {
+        auto& track = verification.tracks[i];
+        output << (boost::format("%1%: %2% ") % boost::io::group(std::setw(2), std::setfill('0'), i + 1) % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.v1Checksum));
+        if (track.v1Frame450Checksum) {
+            output << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), *track.v1Frame450Checksum));
         } else {
-            std::cout << "Filenames in the cue sheet are correct." << std::endl;
-            for (auto fileInCueSheet : filesInCueSheet) {
-                cueSheetFilenameMap[fileInCueSheet] = fileInCueSheet;
-            }
+            output << "-------- ";
+        }
+        output << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.v2Checksum));
+        if (track.accurateRipConfidence > 0) {
+            output << "matched (" << track.accurateRipConfidence << ")";
+        } else {
+            output << "no match";
+        }
+        output << std::endl;
+    }
+}
+
+// Everything an album prints goes to albumLog, so that albums processed side by side don't
+// interleave their output. Errors are thrown and leave the other albums alone.
+static void processAlbum(const std::string& path, const std::optional<std::string>& nextAlbum, const Options& options, Runtime& runtime, flaccue::Metrics* metrics, std::ostream& albumLog) noexcept(false) {
+    auto& pool = runtime.pool;
+    auto& prefetcher = runtime.prefetcher;
+    auto manifest = runtime.manifest;
+    auto prometheus = runtime.prometheus;
+    // Gives back the prefetch budget of what the album before guessed for this one, and of
+    // whatever this one reads, however it ends.
+    flaccue::PrefetchRelease prefetched(prefetcher);
+    
+    struct stat pathStat;
+    if (stat(path.c_str(), &pathStat) != 0) {
+        auto error = errno;
+        prefetched.addDirectory(path);
+        prefetched.addDirectory(dirname(path));
+        throw std::system_error(error, std::generic_category(), "Failed to stat '" + path + "'");
+    }
+    
+    std::string cueDir = S_ISREG(pathStat.st_mode) ? dirname(path) : path;
+    prefetched.addDirectory(cueDir);
+    flaccue::MD5::Digest digest = {};
+    if (manifest) {
+        digest = cueSheetDigest(path, cueDir);
+        auto verification = manifest->findUnchanged(path, digest, options.settings());
+        if (prometheus) {
+            prometheus->increment("flaccue_manifest_lookups_total", 1, {{ "result", verification ? "hit" : "miss" }});
+        }
+        if (verification) {
+            albumLog << "Unchanged since it was last verified, skipping." << std::endl;
+            printVerification(*verification, albumLog);
+            return;
         }
+    }
+    
+    std::shared_ptr<cue::Disc> disc = nullptr;
+    if (S_ISREG(pathStat.st_mode)) {
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Parse);
+        timer.addBytes((uint64_t)pathStat.st_size);
+        std::ifstream input(path);
+        disc = std::make_shared<cue::Disc>(input);
+        input.close();
+    } else if (S_ISDIR(pathStat.st_mode)) {
+        albumLog << "Specified directory, synthesising dummy cue sheet." << std::endl;
         
-        int maxTrackNumber = max_element(disc->tracksCbegin(), disc->tracksCend(), [](const cue::Track& a, const cue::Track& b) {
-            return a.number < b.number;
-        })->number;
-        int trackNumberDigits = (int)ceil(log10(maxTrackNumber));
+        disc = std::make_shared<cue::Disc>();
+        auto filesInCueDir = filesInDir(cueDir);
+        std::vector<std::string> flacFiles;
+        std::copy_if(filesInCueDir.begin(), filesInCueDir.end(), std::back_inserter(flacFiles), [](const std::string& file) {
+            return hasSuffix(file, ".flac");
+        });
         
-        std::unordered_map<std::string, cue::Time> inputFileLengths;
-        for_each(disc->filesCbegin(), disc->filesCend(), [&](const cue::File& file) {
-            auto realFilename = cueSheetFilenameMap[file.path];
-            inputFileLengths[file.path] = readFileLength(cueDir + "/" + realFilename);
+        std::sort(flacFiles.begin(), flacFiles.end());
+        for (auto fileName : flacFiles) {
+            auto& file = disc->addFile();
+            file.path = fileName;
+            file.fileType = "WAVE";
+            auto& track = disc->addTrack();
+            track.number = (int)(disc->tracksCend() - disc->tracksCbegin());
+            track.dataType = "AUDIO";
+            auto& index = track.addIndex();
+            index.index = 1;
+            index.begin = 0;
+            index.setFile(file);
+        }
+    } else {
+        throw std::runtime_error("Unknown file: " + path);
+    }
+    
+    std::vector<std::string> audioFilesInCueDir;
+    {
+        auto filesInCueDir = filesInDir(cueDir);
+        std::copy_if(filesInCueDir.begin(), filesInCueDir.end(), std::back_inserter(audioFilesInCueDir), isAudioFile);
+    }
+    
+    std::vector<std::string> filesInCueSheet;
+    {
+        std::for_each(disc->filesCbegin(), disc->filesCend(), [&](const cue::File& file) {
+            filesInCueSheet.push_back(file.path);
         });
+    }
+    
+    std::unordered_map<std::string, std::string> cueSheetFilenameMap;
+    bool needGuessing = !std::all_of(filesInCueSheet.cbegin(), filesInCueSheet.cend(), [&](const std::string& fileInCueSheet) {
+        return std::find(audioFilesInCueDir.cbegin(), audioFilesInCueDir.cend(), fileInCueSheet) != audioFilesInCueDir.cend();
+    });
+    if (needGuessing) {
+        if (audioFilesInCueDir.size() != filesInCueSheet.size()) {
+            throw std::runtime_error(
+                "Can't guess filenames because the number of files in the directory (" + std::to_string(audioFilesInCueDir.size()) + ")"
+                "is not the same as the number of files in the cue sheet (" + std::to_string(filesInCueSheet.size()) + ")");
+        }
         
-        std::vector<cue::Time> trackOffsets = createTOC(*disc, inputFileLengths);
-        auto toc = accuraterip::TableOfContents::CreateFromTrackOffsets(trackOffsets);
-        accuraterip::ChecksumGenerator checksumGenerator(toc);
+        std::sort(audioFilesInCueDir.begin(), audioFilesInCueDir.end());
+        std::sort(filesInCueSheet.begin(), filesInCueSheet.end());
         
-        cue::GapsAppendedSplitGenerator splitter([&](const cue::Track* track) -> std::string {
-            if (!track) {
-                return (boost::format("%1% - HTOA.flac") % boost::io::group(std::setw(trackNumberDigits), std::setfill('0'), 0)).str();
+        albumLog << "Filenames in the cue sheet are incorrect. Guessing filenames:" << std::endl;
+        auto audioFileInCueDir = audioFilesInCueDir.cbegin();
+        for (auto fileInCueSheet : filesInCueSheet) {
+            cueSheetFilenameMap[fileInCueSheet] = *audioFileInCueDir;
+            albumLog << "'" << fileInCueSheet <<  "' is '" << *audioFileInCueDir << "'" << std::endl;
+            ++audioFileInCueDir;
+        }
+    } else {
+        albumLog << "Filenames in the cue sheet are correct." << std::endl;
+        for (auto fileInCueSheet : filesInCueSheet) {
+            cueSheetFilenameMap[fileInCueSheet] = fileInCueSheet;
+        }
+    }
+    
+    int maxTrackNumber = max_element(disc->tracksCbegin(), disc->tracksCend(), [](const cue::Track& a, const cue::Track& b) {
+        return a.number < b.number;
+    })->number;
+    int trackNumberDigits = (int)ceil(log10(maxTrackNumber));
+    
+    std::unordered_map<std::string, cue::Time> inputFileLengths;
+    // Uncompressed inputs, mapped once and checksummed in place; keyed like the lengths.
+    std::unordered_map<std::string, std::unique_ptr<flaccue::PCMImage>> pcmImages;
+    {
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Probe);
+        std::vector<std::string> probedFiles;
+        std::vector<std::string> probedPaths;
+        std::for_each(disc->filesCbegin(), disc->filesCend(), [&](const cue::File& file) {
+            auto path = cueDir + "/" + cueSheetFilenameMap[file.path];
+            if (hasSuffix(path, ".flac")) {
+                probedFiles.push_back(file.path);
+                probedPaths.push_back(path);
             } else {
-                auto artist = fallback(track->performer, track->songwriter, disc->performer, disc->songwriter, std::string(""));
-                auto title = track->title.value_or("");
-                return (boost::format("%1% - %2% - %3%.flac")
-                        % boost::io::group(std::setw(trackNumberDigits), std::setfill('0'), track->number)
-                        % filenameSafeString(artist)
-                        % filenameSafeString(title)).str();
+                auto image = std::make_unique<flaccue::PCMImage>(path, flaccue::PCMImage::kindForFileType(file.fileType));
+                if (!image->isCDDA()) {
+                    throw std::runtime_error("'" + path + "' is not 44.1 kHz 16-bit stereo audio");
+                }
+                inputFileLengths[file.path] = (long long)image->numberOfSamples();
+                pcmImages[file.path] = std::move(image);
             }
-        }, [&](const std::string& fileName) -> cue::Time {
-            return inputFileLengths[fileName];
         });
+        if (!pcmImages.empty() && !probedPaths.empty()) {
+            throw std::runtime_error("Mixing FLAC and uncompressed inputs isn't supported");
+        }
+        auto streamInfos = flaccue::probeStreamInfos(probedPaths, pool);
+        for (size_t i = 0; i < probedFiles.size(); ++i) {
+            inputFileLengths[probedFiles[i]] = (long long)streamInfos[i].totalSamples;
+        }
+        for (auto& length : inputFileLengths) {
+            timer.addSamples((uint64_t)length.second.samples);
+        }
+    }
+    bool inputsArePCM = !pcmImages.empty();
+    // Uncompressed inputs are split into WAV files by copying their bytes, which only
+    // works if they are little-endian, or encoded into FLAC files with --reencode.
+    bool canSplit = options.reencode || std::none_of(pcmImages.cbegin(), pcmImages.cend(), [](const auto& image) {
+        return image.second->isBigEndian();
+    });
+    std::string outputExtension = inputsArePCM && !options.reencode ? "wav" : "flac";
+    
+    cue::Timeline timeline(*disc, [&](const std::string& fileName) {
+        return inputFileLengths[fileName];
+    });
+    std::vector<cue::Time> trackOffsets = timeline.trackOffsets();
+    auto toc = accuraterip::TableOfContents::CreateFromTrackOffsets(trackOffsets);
+    accuraterip::ChecksumGenerator checksumGenerator(toc);
+    
+    cue::GapsAppendedSplitGenerator splitter([&](const cue::Track* track) -> std::string {
+        if (!track) {
+            return (boost::format("%1% - HTOA.%2%") % boost::io::group(std::setw(trackNumberDigits), std::setfill('0'), 0) % outputExtension).str();
+        } else {
+            auto artist = fallback(track->performer, track->songwriter, disc->performer, disc->songwriter, std::string(""));
+            auto title = track->title.value_or("");
+            return (boost::format("%1% - %2% - %3%.%4%")
+                    % boost::io::group(std::setw(trackNumberDigits), std::setfill('0'), track->number)
+                    % filenameSafeString(artist)
+                    % filenameSafeString(title)
+                    % outputExtension).str();
+        }
+    }, [&](const std::string& fileName) -> cue::Time {
+        return inputFileLengths[fileName];
+    });
+    
+    auto split = splitter.split(*disc);
+    
+    std::vector<std::string> albumInputPaths;
+    for (auto& inputFile : cue::splitInputFiles(split)) {
+        albumInputPaths.push_back(cueDir + "/" + cueSheetFilenameMap.at(inputFile));
+    }
+    prefetched.add(albumInputPaths);
+    prefetcher.enqueue(albumInputPaths);
+    // Captured before reading, so a file changed meanwhile doesn't get the results of the
+    // old one.
+    std::vector<cue::ManifestInput> manifestInputs;
+    if (manifest) {
+        for (auto& albumInputPath : albumInputPaths) {
+            manifestInputs.push_back(cue::ManifestInput::Capture(albumInputPath));
+        }
+    }
+    if (nextAlbum) {
+        prefetcher.enqueue(guessAlbumInputPaths(*nextAlbum));
+    }
+    
+    bool isSplittedDifferent = false;
+    for (auto outputSegment : split.outputFiles) {
+        if (outputSegment.inputSegments.size() != 1) {
+            isSplittedDifferent = true;
+            break;
+        }
         
-        auto split = splitter.split(*disc);
+        auto inputSegment = outputSegment.inputSegments[0];
+        if (inputSegment.begin != cue::Time(0)) {
+            isSplittedDifferent = true;
+            break;
+        }
         
-        bool isSplittedDifferent = false;
-        for (auto outputSegment : split.outputFiles) {
-            if (outputSegment.inputSegments.size() != 1) {
-                isSplittedDifferent = true;
-                break;
+        if (inputSegment.end && inputSegment.end != inputFileLengths[inputSegment.inputFile]) {
+            isSplittedDifferent = true;
+            break;
+        }
+    }
+    
+    bool writesOutputs = isSplittedDifferent && !options.verifyOnly && canSplit;
+    
+    auto outputDir = cueDir;
+    if (writesOutputs) {
+        outputDir = outputDir + "/converted";
+        albumLog << "Creating canonicalized disc in '" << outputDir << "'"<< std::endl;
+        struct stat outputDirStat;
+        if (stat(outputDir.c_str(), &outputDirStat) != 0 && errno == ENOENT) {
+            if (mkdir(outputDir.c_str(), 0700) != 0) {
+                throw std::system_error(errno, std::generic_category(), "Failed to create '" + outputDir + "'");
             }
-            
-            auto inputSegment = outputSegment.inputSegments[0];
-            if (inputSegment.begin != cue::Time(0)) {
-                isSplittedDifferent = true;
-                break;
+        } else if (!S_ISDIR(outputDirStat.st_mode)) {
+            throw std::runtime_error("'" + outputDir + "' already exists and it's a file");
+        }
+    } else if (isSplittedDifferent) {
+        albumLog << "Verifying only, not creating a canonicalized disc" << (inputsArePCM && !options.verifyOnly ? " from big-endian images" : "") << std::endl;
+    } else {
+        albumLog << "Input is already in canonical format" << std::endl;
+    }
+    
+    bool hasHTOA = disc->tracksCbegin()->indexesCbegin()->index == 0;
+    AccurateRipSampleSink checksumSink(checksumGenerator, metrics);
+    auto inputPath = [&](const std::string& inputFile) {
+        auto path = cueDir + "/" + cueSheetFilenameMap.at(inputFile);
+        prefetcher.release(path);
+        return path;
+    };
+    auto inputFileLength = [&](const std::string& fileName) {
+        return inputFileLengths.at(fileName);
+    };
+    auto outputPath = [&](const std::string& outputFile) {
+        return outputDir + "/" + outputFile;
+    };
+    // Input bytes and samples read by decoding, and output bytes written by encoding.
+    auto addInputs = [&](flaccue::StageTimer& timer) {
+        for (auto& albumInputPath : albumInputPaths) {
+            if (auto source = cue::SourceInfo::Stat(albumInputPath)) {
+                timer.addBytes(source->size);
             }
-            
-            if (inputSegment.end && inputSegment.end != inputFileLengths[inputSegment.inputFile]) {
-                isSplittedDifferent = true;
-                break;
+        }
+        for (auto& length : inputFileLengths) {
+            timer.addSamples((uint64_t)length.second.samples);
+        }
+    };
+    auto addOutputs = [&](flaccue::StageTimer& timer) {
+        for (auto& outputFile : split.outputFiles) {
+            if (auto source = cue::SourceInfo::Stat(outputPath(outputFile.outputFile))) {
+                timer.addBytes(source->size);
             }
         }
-        
-        auto outputDir = cueDir;
-        if (isSplittedDifferent) {
-            outputDir = outputDir + "/converted";
-            std::cerr << "Creating canonicalized disc in '" << outputDir << "'"<< std::endl;
-            struct stat outputDirStat;
-            if (stat(outputDir.c_str(), &outputDirStat) != 0 && errno == ENOENT) {
-                if (mkdir(outputDir.c_str(), 0700) != 0) {
-                    std::cerr << "Failed to create '" << outputDir << "'!" << std::endl;
-                    abort();
+    };
+    
+    if (inputsArePCM) {
+        // Borrowed blocks point into the mapped images, so they can be as large as it
+        // gets; the checksums read them in place, guarded against truncated inputs.
+        const uint32_t blockSize = 1 << 20;
+        auto pcmSources = [&](std::unordered_map<std::string, std::unique_ptr<cue::PCMSampleSource>>& sources) {
+            return [&pcmImages, sources = &sources](const std::string& inputFile) -> cue::SampleSource& {
+                auto& source = (*sources)[inputFile];
+                if (!source) {
+                    source = std::make_unique<cue::PCMSampleSource>(*pcmImages.at(inputFile));
                 }
-            } else if (!S_ISDIR(outputDirStat.st_mode)) {
-                std::cerr << "'" << outputDir << "' already exists and it's a file!" << std::endl;
-                abort();
+                return *source;
+            };
+        };
+        
+        std::unordered_map<std::string, std::unique_ptr<cue::PCMSampleSource>> checksumSources;
+        {
+            flaccue::StageTimer timer(metrics, flaccue::Stage::Decode);
+            addInputs(timer);
+            for (auto& image : pcmImages) {
+                image.second->adviseSequential();
+            }
+            for (size_t output = hasHTOA ? 1 : 0; output < split.outputFiles.size(); ++output) {
+                cue::copySplitOutput(split, output, pcmSources(checksumSources), checksumSink, blockSize);
             }
-        } else {
-            std::cerr << "Input is already in canonical format" << std::endl;
         }
         
-        bool hasHTOA = disc->tracksCbegin()->indexesCbegin()->index == 0;
-        for (auto i = 0; i < split.outputFiles.size(); ++i) {
-            auto outputFile = split.outputFiles[i];
+        flaccue::StageTimer timer(writesOutputs ? metrics : nullptr, flaccue::Stage::Encode);
+        if (writesOutputs && options.reencode) {
+            flaccue::TaskGroup tasks(pool);
+            for (size_t output = 0; output < split.outputFiles.size(); ++output) {
+                tasks.run([&, output]() {
+                    std::unordered_map<std::string, std::unique_ptr<cue::PCMSampleSource>> sources;
+                    cue::FLACSampleSink sink(outputPath(split.outputFiles[output].outputFile), options.encoderSettings);
+                    cue::copySplitOutput(split, output, pcmSources(sources), sink);
+                });
+            }
+            tasks.wait();
+        } else if (writesOutputs) {
+            cue::PCMSplitWriter(split, [&](const std::string& inputFile) -> const flaccue::PCMImage& {
+                return *pcmImages.at(inputFile);
+            }, outputPath).writeAll();
+        }
+        if (writesOutputs) {
+            addOutputs(timer);
+        }
+    } else if (isSplittedDifferent) {
+        // Copied frames are written on the way, so they count as decoding.
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Decode);
+        addInputs(timer);
+        cue::SampleSinkSplitSink checksumSplitSink(checksumSink, hasHTOA ? 1 : 0);
+        cue::FLACPassthroughSplitSink passthroughSink(split, inputFileLength, outputPath, options.encoderSettings.compressionLevel);
+        std::vector<cue::SplitSink*> stages = { &checksumSplitSink };
+        if (writesOutputs && !options.reencode) {
+            stages.push_back(&passthroughSink);
+        }
+        cue::SequentialSplitExecutor splitExecutor(split, inputPath);
+        cue::PipelinedSplitExecutor(splitExecutor).execute(stages);
+    } else {
+        // Every output is a whole input file and nothing gets written: the files are
+        // just decoded into the checksum generator, several of them ahead at once.
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Decode);
+        addInputs(timer);
+        std::vector<std::string> inputPaths;
+        for (size_t output = hasHTOA ? 1 : 0; output < split.outputFiles.size(); ++output) {
+            inputPaths.push_back(inputPath(split.outputFiles[output].inputSegments[0].inputFile));
+        }
+        cue::OrderedFileDecoder(inputPaths, options.threadsPerAlbum).execute([&](const FLAC__int32* const buffer[], unsigned channels, uint32_t count) {
+            checksumSink.process(buffer, channels, count);
+        });
+        checksumSink.end();
+    }
+    
+    if (writesOutputs && options.reencode && !inputsArePCM) {
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Encode);
+        cue::ParallelSplitExecutor(split, inputPath, inputFileLength).execute(pool, [&](size_t output) {
+            return std::make_unique<cue::FLACEncodingSplitSink>(split, outputPath, options.encoderSettings);
+        });
+        addOutputs(timer);
+    }
+    
+    // Done reading this album; the next one gets the whole budget while the AccurateRip
+    // data downloads.
+    prefetched.release();
+
+    auto album = split.outputSheet->title.value_or("");
+    auto albumArtist = fallback(split.outputSheet->performer,
+                                split.outputSheet->songwriter,
+                                split.outputSheet->tracksCbegin()->performer,
+                                split.outputSheet->tracksCbegin()->songwriter,
+                                std::string(""));
+    
+    std::optional<flaccue::StageTimer> reportTimer;
+    reportTimer.emplace(metrics, flaccue::Stage::Report);
+    if (writesOutputs) {
+        auto cueFile = outputDir + "/" + filenameSafeString(albumArtist) + " - " + filenameSafeString(album) + ".cue";
+        albumLog << "Writing canonical cuesheet to '" << cueFile << "'" << std::endl;
+        std::ofstream cueOutput(cueFile);
+        cueOutput << *split.outputSheet;
+        cueOutput.close();
+    }
+    
+    auto numberOfTracks = trackOffsets.size() - 1;
+    
+    auto accurateRipLogFile = outputDir + "/" + filenameSafeString(albumArtist) + " - " + filenameSafeString(album) + ".arlog";
+    albumLog << "Writing AccurateRip log to '" << accurateRipLogFile << "'" << std::endl;
+    std::ofstream accurateRipLogFileStream(accurateRipLogFile);
+    MultiplexedOutputStream<decltype(albumLog), decltype(accurateRipLogFileStream)>accurateRipLogStream(albumLog, accurateRipLogFileStream);
+    
+    accurateRipLogStream << "Audio checksums:" << std::endl;
+    accurateRipLogStream << " #         TOC           V1    V1_Fr450    V2" << std::endl;
+    for (auto i = 0; i < numberOfTracks; ++i) {
+        accurateRipLogStream << (boost::format("%1%: ") % boost::io::group(std::setw(2), std::setfill('0'), i + 1));
+        accurateRipLogStream << (msfString(toc[i].startOffset) + '-' + msfString(toc[i+1].startOffset - cue::Time(0,0,1))) << " ";
+        accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v1ChecksumWithOffset(i, 0)));
+        if (checksumGenerator.hasV1Frame450Checksum(i)) {
+            accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v1Frame450ChecksumWithOffset(i, 0)));
+        } else {
+            accurateRipLogStream << "-------- ";
+        }
+        accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v2Checksum(i)));
+        accurateRipLogStream << std::endl;
+    }
+    accurateRipLogStream << std::endl;
+    
+    accurateRipLogStream << "AccurateRip data URL: " << checksumGenerator.accurateRipDataURL << std::endl;
+    
+    std::unique_ptr<accuraterip::Data> arData = nullptr;
+    reportTimer.reset();
+    
+    std::stringstream downloadedData(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+    std::stringstream downloadedHeaders(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
+    CURLDownloader downloader(checksumGenerator.accurateRipDataURL, [&](void const * buffer, size_t size, size_t count) -> size_t {
+        downloadedData.write((const char*)buffer, size * count);
+        return downloadedData.bad() ? 0 : count;
+    }, [&](void const * buffer, size_t size, size_t count) -> size_t {
+        downloadedHeaders.write((const char*)buffer, size * count);
+        return downloadedHeaders.bad() ? 0 : count;
+    });
+    CURLDownloader::StatusCode statusCode;
+    {
+        flaccue::StageTimer timer(metrics, flaccue::Stage::Fetch);
+        flaccue::TraceScope trace("fetch", "accuraterip", checksumGenerator.accurateRipDataURL.c_str());
+        statusCode = downloader.perform();
+        timer.addBytes(downloadedData.tellp() > 0 ? (uint64_t)downloadedData.tellp() : 0);
+    }
+    reportTimer.emplace(metrics, flaccue::Stage::Report);
+    if (prometheus) {
+        prometheus->increment("flaccue_accuraterip_lookups_total", 1, {{ "result", statusCode == 200 ? "found" : statusCode == 404 ? "not_found" : "error" }});
+    }
+    
+    if (statusCode != 200) {
+        albumLog
+        << "Failed to download AccurateRip data!"
+        << std::endl
+        << downloadedHeaders.str()
+        << std::endl;
+    } else {
+        albumLog << "Downloaded AccurateRip data." << std::endl;
+        arData.reset(new accuraterip::Data(downloadedData));
+    }
+    
+    // Without AccurateRip data the album is left out of the manifest and tried again next
+    // time.
+    if (!arData) {
+        return;
+    }
+    std::vector<uint32_t> accurateRipConfidence(numberOfTracks, 0);
+    accurateRipLogStream << "AccurateRip data contains " << arData->discs.size() << " discs." << std::endl << std::endl;
+    for (auto i = 0; i < arData->discs.size(); ++i) {
+        accurateRipLogStream << "Data from AccurateRip disc " << (i + 1) << ":" << std::endl;
+        accurateRipLogStream << " #  Checksum  Fr450   Count Matches" << std::endl;
+        auto disc = arData->discs[i];
+        for (auto i = 0; i < disc.tracks.size(); ++i) {
+            auto track = disc.tracks[i];
+            accurateRipLogStream
+            << (boost::format("%1%: %2% %3% %4%") %
+                boost::io::group(std::setw(2), std::setfill('0'), i + 1) %
+                boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.crc) %
+                boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.frame450CRC) %
+                center(std::to_string(track.count), 5, ' ')).str();
             
-            FLAC::Encoder::File currentDestinationWriter;
-            if (isSplittedDifferent) {
-                currentDestinationWriter.set_channels(2);
-                currentDestinationWriter.set_sample_rate(44100);
-                currentDestinationWriter.set_bits_per_sample(16);
-                currentDestinationWriter.init(outputDir + "/" + outputFile.outputFile);
+            if (checksumGenerator.hasV1Frame450Checksum(i) &&
+                checksumGenerator.v1Frame450ChecksumWithOffset(i, 0) == track.frame450CRC) {
+                accurateRipLogStream << " V1_Fr450";
+            }
+            if (checksumGenerator.v1ChecksumWithOffset(i, 0) == track.crc) {
+                accurateRipLogStream << " V1";
+            }
+            if (checksumGenerator.v2Checksum(i) == track.crc) {
+                accurateRipLogStream << " V2";
+            }
+            if (i < numberOfTracks && (checksumGenerator.v1ChecksumWithOffset(i, 0) == track.crc || checksumGenerator.v2Checksum(i) == track.crc)) {
+                accurateRipConfidence[i] += track.count;
             }
             
-            for (auto inputSegment : outputFile.inputSegments) {
-                FLACLambdaReader reader;
-                auto realFilename = cueSheetFilenameMap[inputSegment.inputFile];
-                reader.init(cueDir + "/" + realFilename);
-                reader.process_until_end_of_metadata();
-                
-                long remainingSamples = (inputSegment.end.value_or(inputFileLengths[inputSegment.inputFile]) - inputSegment.begin).samples;
-                
-                reader.writeCallback = [&](const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[]) {
-                    auto samplesToBeWritten = std::min<long>(remainingSamples, frame->header.blocksize);
-                    if (isSplittedDifferent) {
-                        currentDestinationWriter.process(buffer, (unsigned int)samplesToBeWritten);
-                    }
-                    
-                    if (!hasHTOA || i > 0) {
-                        checksumGenerator.processSamples(buffer, (uint32_t)samplesToBeWritten);
-                    }
-                    
-                    static_assert(sizeof(FLAC__int32) == sizeof(int32_t), "");
-                    
-                    remainingSamples -= samplesToBeWritten;
-                    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
-                };
-                
-                reader.seek_absolute(inputSegment.begin.samples);
-                while (remainingSamples != 0) {
-                    assert(remainingSamples > 0);
-                    reader.process_single();
+            std::vector<int32_t> v1MatchingOffsets;
+            std::vector<int32_t> v1Frame450MatchingOffsets;
+            
+            for (auto offset = checksumGenerator.minimumOffset(); offset <= checksumGenerator.maximumOffset(); ++offset) {
+                if (checksumGenerator.v1ChecksumWithOffset(i, offset) == track.crc) {
+                    v1MatchingOffsets.push_back(offset);
+                }
+                if (checksumGenerator.hasV1Frame450Checksum(i) &&
+                    checksumGenerator.v1Frame450ChecksumWithOffset(i, offset) == track.frame450CRC) {
+                    v1Frame450MatchingOffsets.push_back(offset);
                 }
-                
-                reader.finish();
             }
             
-            if (isSplittedDifferent) {
-                currentDestinationWriter.finish();
+            if (v1MatchingOffsets.size() > 0 && (v1MatchingOffsets.size() > 1 || v1MatchingOffsets[0] != 0)) {
+                accurateRipLogStream << " V1(offsets: " << createOffsetIntervalsString(v1MatchingOffsets) << ")";
             }
-        }
-
-        auto album = split.outputSheet->title.value_or("");
-        auto albumArtist = fallback(split.outputSheet->performer,
-                                    split.outputSheet->songwriter,
-                                    split.outputSheet->tracksCbegin()->performer,
-                                    split.outputSheet->tracksCbegin()->songwriter,
-                                    std::string(""));
-        
-        if (isSplittedDifferent) {
-            auto cueFile = outputDir + "/" + filenameSafeString(albumArtist) + " - " + filenameSafeString(album) + ".cue";
-            std::cerr << "Writing canonical cuesheet to '" << cueFile << "'" << std::endl;
-            std::ofstream cueOutput(cueFile);
-            cueOutput << *split.outputSheet;
-            cueOutput.close();
-        }
-        
-        auto numberOfTracks = trackOffsets.size() - 1;
-        
-        auto accurateRipLogFile = outputDir + "/" + filenameSafeString(albumArtist) + " - " + filenameSafeString(album) + ".arlog";
-        std::cerr << "Writing AccurateRip log to '" << accurateRipLogFile << "'" << std::endl;
-        std::ofstream accurateRipLogFileStream(accurateRipLogFile);
-        MultiplexedOutputStream<decltype(std::cout), decltype(accurateRipLogFileStream)>accurateRipLogStream(std::cout, accurateRipLogFileStream);
-        
-        accurateRipLogStream << "Audio checksums:" << std::endl;
-        accurateRipLogStream << " #         TOC           V1    V1_Fr450    V2" << std::endl;
-        for (auto i = 0; i < numberOfTracks; ++i) {
-            accurateRipLogStream << (boost::format("%1%: ") % boost::io::group(std::setw(2), std::setfill('0'), i + 1));
-            accurateRipLogStream << (msfString(toc[i].startOffset) + '-' + msfString(toc[i+1].startOffset - cue::Time(0,0,1))) << " ";
-            accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v1ChecksumWithOffset(i, 0)));
-            if (checksumGenerator.hasV1Frame450Checksum(i)) {
-                accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v1Frame450ChecksumWithOffset(i, 0)));
-            } else {
-                accurateRipLogStream << "-------- ";
+            if (v1Frame450MatchingOffsets.size() > 0 && (v1Frame450MatchingOffsets.size() > 1 || v1Frame450MatchingOffsets[0] != 0)) {
+                accurateRipLogStream << " V1_Fr450(offsets: " << createOffsetIntervalsString(v1Frame450MatchingOffsets) << ")";
             }
-            accurateRipLogStream << (boost::format("%1% ") % boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), checksumGenerator.v2Checksum(i)));
+            
             accurateRipLogStream << std::endl;
         }
         accurateRipLogStream << std::endl;
-        
-        accurateRipLogStream << "AccurateRip data URL: " << checksumGenerator.accurateRipDataURL << std::endl;
-        
-        std::unique_ptr<accuraterip::Data> arData = nullptr;
-        
-        std::stringstream downloadedData(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
-        std::stringstream downloadedHeaders(std::stringstream::in | std::stringstream::out | std::stringstream::binary);
-        CURLDownloader downloader(checksumGenerator.accurateRipDataURL, [&](void const * buffer, size_t size, size_t count) -> size_t {
-            downloadedData.write((const char*)buffer, size * count);
-            return downloadedData.bad() ? 0 : count;
-        }, [&](void const * buffer, size_t size, size_t count) -> size_t {
-            downloadedHeaders.write((const char*)buffer, size * count);
-            return downloadedHeaders.bad() ? 0 : count;
-        });
-        auto statusCode = downloader.perform();
-        
-        if (statusCode != 200) {
-            std::cerr
-            << "Failed to download AccurateRip data!"
-            << std::endl
-            << downloadedHeaders.str()
-            << std::endl;
-        } else {
-            std::cerr << "Downloaded AccurateRip data." << std::endl;
-            arData.reset(new accuraterip::Data(downloadedData));
+    }
+    accurateRipLogFileStream.close();
+    if (prometheus) {
+        auto matched = std::count_if(accurateRipConfidence.begin(), accurateRipConfidence.end(), [](uint32_t confidence) { return confidence > 0; });
+        prometheus->increment("flaccue_accuraterip_tracks_total", (double)matched, {{ "result", "match" }});
+        prometheus->increment("flaccue_accuraterip_tracks_total", (double)(numberOfTracks - matched), {{ "result", "mismatch" }});
+    }
+    
+    if (manifest) {
+        cue::AlbumVerification verification;
+        verification.album = path;
+        verification.cueSheetDigest = digest;
+        verification.settings = options.settings();
+        verification.inputs = std::move(manifestInputs);
+        for (auto i = 0; i < numberOfTracks; ++i) {
+            verification.tracks.push_back(cue::TrackVerification {
+                checksumGenerator.v1ChecksumWithOffset(i, 0),
+                checksumGenerator.hasV1Frame450Checksum(i) ? std::optional<uint32_t>(checksumGenerator.v1Frame450ChecksumWithOffset(i, 0)) : std::nullopt,
+                checksumGenerator.v2Checksum(i),
+                accurateRipConfidence[i]
+            });
         }
+        manifest->record(verification);
+    }
+}
+
+// Prints the log of the album in one piece; false if the album failed.
+static bool runAlbum(const std::string& path, const std::optional<std::string>& nextAlbum, const Options& options, Runtime& runtime) {
+    std::ostringstream albumLog;
+    std::string error;
+    flaccue::Metrics metrics;
+    auto start = std::chrono::steady_clock::now();
+    if (runtime.prometheus) {
+        runtime.prometheus->add("flaccue_albums_in_progress", 1);
+    }
+    try {
+        flaccue::TraceScope trace("album", "album", path.c_str());
+        processAlbum(path, nextAlbum, options, runtime, runtime.metricsReport || runtime.prometheus ? &metrics : nullptr, albumLog);
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "Unknown error";
+    }
+    
+    if (runtime.metricsReport) {
+        runtime.metricsReport->addAlbum(path, error.empty(), std::chrono::steady_clock::now() - start, metrics);
+    }
+    if (runtime.prometheus) {
+        runtime.prometheus->add("flaccue_albums_in_progress", -1);
+        recordAlbum(*runtime.prometheus, error.empty(), std::chrono::steady_clock::now() - start, metrics);
+    }
+    
+    std::lock_guard<std::mutex> lock(runtime.outputMutex);
+    std::cerr << "Processing: " << path << std::endl;
+    std::cout << albumLog.str() << std::flush;
+    if (!error.empty()) {
+        std::cerr << path << ": " << error << std::endl;
+    }
+    return error.empty();
+}
+
+// The albums of a directory: its cue sheets, or the directory itself if it has FLAC files
+// but no cue sheet.
+static std::vector<std::string> albumsInDirectory(const std::string& directory) {
+    auto files = filesInDir(directory);
+    std::sort(files.begin(), files.end());
+    std::vector<std::string> albums;
+    for (auto& file : files) {
+        if (hasSuffix(file, ".cue")) {
+            albums.push_back(directory + "/" + file);
+        }
+    }
+    if (albums.empty() && std::any_of(files.cbegin(), files.cend(), [](const std::string& file) { return hasSuffix(file, ".flac"); })) {
+        albums.push_back(directory);
+    }
+    return albums;
+}
+
+static std::atomic<bool> isStopping(false);
+
+static void stopWatching(int) {
+    isStopping = true;
+}
+
+// Queues the albums of every directory that settles after a change, and keeps at most
+// numberOfJobs of them in progress. The queue survives restarts; on startup every album
+// under the watched directories is queued once more, which the manifest makes cheap for
+// the ones already verified.
+static int watchDirectories(const Options& options, Runtime& runtime) {
+    flaccue::JobQueue queue(options.queueDirectory.empty() ? options.watchDirectories[0] + "/.flaccue-queue" : options.queueDirectory);
+    // Outputs go to "converted" directories, which must not be taken for new albums.
+    flaccue::DirectoryWatcher watcher(options.watchDirectories, std::chrono::seconds(options.quietPeriod), [](const std::string& path, bool isDirectory) {
+        return isDirectory ? !hasSuffix(path, "/converted") : hasSuffix(path, ".cue") || isAudioFile(path);
+    });
+    std::cerr << "Watching " << watcher.numberOfDirectories() << " directories" << (watcher.isPolling() ? " by polling" : "") << std::endl;
+    
+    signal(SIGINT, stopWatching);
+    signal(SIGTERM, stopWatching);
+    
+    std::mutex runningMutex;
+    std::unordered_set<std::string> running;
+    // Albums that changed while they were being processed; they go again when done.
+    std::unordered_set<std::string> changedWhileRunning;
+    flaccue::TaskGroup jobs(runtime.pool);
+    while (!isStopping) {
+        auto settled = watcher.wait(std::chrono::seconds(1));
         
-        accurateRipLogStream << "AccurateRip data contains " << arData->discs.size() << " discs." << std::endl << std::endl;
-        for (auto i = 0; i < arData->discs.size(); ++i) {
-            accurateRipLogStream << "Data from AccurateRip disc " << (i + 1) << ":" << std::endl;
-            accurateRipLogStream << " #  Checksum  Fr450   Count Matches" << std::endl;
-            auto disc = arData->discs[i];
-            for (auto i = 0; i < disc.tracks.size(); ++i) {
-                auto track = disc.tracks[i];
-                accurateRipLogStream
-                << (boost::format("%1%: %2% %3% %4%") %
-                    boost::io::group(std::setw(2), std::setfill('0'), i + 1) %
-                    boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.crc) %
-                    boost::io::group(std::setw(8), std::setfill('0'), std::setbase(16), track.frame450CRC) %
-                    center(std::to_string(track.count), 5, ' ')).str();
-                
-                if (checksumGenerator.hasV1Frame450Checksum(i) &&
-                    checksumGenerator.v1Frame450ChecksumWithOffset(i, 0) == track.frame450CRC) {
-                    accurateRipLogStream << " V1_Fr450";
-                }
-                if (checksumGenerator.v1ChecksumWithOffset(i, 0) == track.crc) {
-                    accurateRipLogStream << " V1";
+        std::lock_guard<std::mutex> lock(runningMutex);
+        for (auto& directory : settled) {
+            for (auto& album : albumsInDirectory(directory)) {
+                if (running.count(album) > 0) {
+                    changedWhileRunning.insert(album);
+                } else {
+                    queue.push(album);
                 }
-                if (checksumGenerator.v2Checksum(i) == track.crc) {
-                    accurateRipLogStream << " V2";
+            }
+        }
+        auto pending = queue.pending();
+        if (runtime.prometheus) {
+            runtime.prometheus->set("flaccue_queue_depth", (double)pending.size());
+        }
+        for (auto& album : pending) {
+            if (running.size() >= options.numberOfJobs) {
+                break;
+            }
+            if (!running.insert(album).second) {
+                continue;
+            }
+            jobs.run([&, album]() {
+                // Even if updating the queue fails: an album that stayed in `running` would
+                // never be started again.
+                ScopeExit stopRunning([&]() {
+                    std::lock_guard<std::mutex> lock(runningMutex);
+                    running.erase(album);
+                });
+                // A failed album stays failed until its files change again.
+                runAlbum(album, std::nullopt, options, runtime);
+                std::lock_guard<std::mutex> lock(runningMutex);
+                queue.complete(album);
+                if (changedWhileRunning.erase(album) > 0) {
+                    queue.push(album);
                 }
-                
-                std::vector<int32_t> v1MatchingOffsets;
-                std::vector<int32_t> v1Frame450MatchingOffsets;
-                
-                for (auto offset = checksumGenerator.minimumOffset(); offset <= checksumGenerator.maximumOffset(); ++offset) {
-                    if (checksumGenerator.v1ChecksumWithOffset(i, offset) == track.crc) {
-                        v1MatchingOffsets.push_back(offset);
+            });
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(runningMutex);
+        std::cerr << "Stopping, waiting for " << running.size() << " albums in progress." << std::endl;
+    }
+    jobs.wait();
+    return 0;
+}
+
+// Parses the value of a numeric option into `result`, or tells what's wrong with it.
+template<typename T> static bool parseNumber(const std::string& option, const std::string& value, T minimum, T maximum, T& result) {
+    char* end = nullptr;
+    errno = 0;
+    auto number = isdigit((unsigned char)value[0]) ? strtoull(value.c_str(), &end, 10) : 0;
+    if (end == nullptr || *end != '\0' || errno == ERANGE || number < minimum || number > maximum) {
+        std::cerr << "Invalid " << option << ": '" << value << "', expected a number from " << minimum << " to " << maximum << std::endl;
+        return false;
+    }
+    result = (T)number;
+    return true;
+}
+
+static int mergeShards(const std::string& shardDirectory, const std::string& mergedManifestPath) {
+    cue::Manifest merged(mergedManifestPath);
+    size_t numberOfShards = 0;
+    size_t numberOfAlbums = 0;
+    for (auto& file : filesInDir(shardDirectory)) {
+        auto path = shardDirectory + "/" + file;
+        if (hasSuffix(file, ".manifest") && path != mergedManifestPath) {
+            // Workers might still be appending to their manifests.
+            numberOfAlbums += merged.merge(cue::Manifest::OpenReadOnly(path));
+            ++numberOfShards;
+        }
+    }
+    std::cerr << "Merged " << numberOfAlbums << " albums from " << numberOfShards << " shards into '" << mergedManifestPath << "'." << std::endl;
+    return 0;
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc < 2) {
+        std::cerr << "No path specified!" << std::endl;
+    }
+    
+    if (argc == 3 && std::string(argv[1]) == "--parse-tree") {
+        return parseTree(argv[2]);
+    }
+    
+    Options options;
+    std::vector<std::string> albums;
+    bool areNumbersValid = true;
+    for (auto i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--reencode") {
+            options.reencode = true;
+        } else if (argument == "--verify-only") {
+            options.verifyOnly = true;
+        } else if (argument == "--compression-level" && i + 1 < argc) {
+            areNumbersValid &= parseNumber(argument, argv[++i], 0u, 8u, options.encoderSettings.compressionLevel);
+        } else if (argument == "--encoder-threads" && i + 1 < argc) {
+            // libFLAC refuses more than 64.
+            areNumbersValid &= parseNumber(argument, argv[++i], 1u, 64u, options.encoderSettings.numberOfThreads);
+        } else if (argument == "--threads" && i + 1 < argc) {
+            areNumbersValid &= parseNumber<size_t>(argument, argv[++i], 1, 4096, options.numberOfThreads);
+        } else if (argument == "--jobs" && i + 1 < argc) {
+            areNumbersValid &= parseNumber<size_t>(argument, argv[++i], 0, 4096, options.numberOfJobs);
+        } else if (argument == "--prefetch-budget" && i + 1 < argc) {
+            areNumbersValid &= parseNumber<size_t>(argument, argv[++i], 0, std::numeric_limits<size_t>::max() >> 20, options.prefetchBudget);
+        } else if (argument == "--manifest" && i + 1 < argc) {
+            options.manifestPath = argv[++i];
+        } else if (argument == "--watch" && i + 1 < argc) {
+            options.watchDirectories.push_back(argv[++i]);
+        } else if (argument == "--queue" && i + 1 < argc) {
+            options.queueDirectory = argv[++i];
+        } else if (argument == "--quiet-period" && i + 1 < argc) {
+            areNumbersValid &= parseNumber(argument, argv[++i], 0u, std::numeric_limits<unsigned>::max(), options.quietPeriod);
+        } else if (argument == "--shard-dir" && i + 1 < argc) {
+            options.shardDirectory = argv[++i];
+        } else if (argument == "--run" && i + 1 < argc) {
+            options.runID = argv[++i];
+        } else if (argument == "--worker" && i + 1 < argc) {
+            options.workerName = argv[++i];
+        } else if (argument == "--lease" && i + 1 < argc) {
+            areNumbersValid &= parseNumber(argument, argv[++i], 1u, std::numeric_limits<unsigned>::max(), options.leaseDuration);
+        } else if (argument == "--merge" && i + 1 < argc) {
+            options.mergedManifestPath = argv[++i];
+        } else if (argument == "--metrics" && i + 1 < argc) {
+            options.metricsPath = argv[++i];
+        } else if (argument == "--trace" && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (argument == "--prometheus" && i + 1 < argc) {
+            options.prometheusPath = argv[++i];
+        } else if (argument == "--prometheus-interval" && i + 1 < argc) {
+            areNumbersValid &= parseNumber(argument, argv[++i], 1u, std::numeric_limits<unsigned>::max(), options.prometheusInterval);
+        } else {
+            albums.push_back(argument);
+        }
+    }
+    if (!areNumbersValid) {
+        return 1;
+    }
+    if (options.numberOfJobs == 0 || options.numberOfJobs > options.numberOfThreads) {
+        options.numberOfJobs = options.numberOfThreads;
+    }
+    if (options.watchDirectories.empty()) {
+        options.numberOfJobs = std::max<size_t>(std::min(options.numberOfJobs, albums.size()), 1);
+    }
+    options.threadsPerAlbum = std::max<size_t>(options.numberOfThreads / options.numberOfJobs, 1);
+    
+    if (!options.mergedManifestPath.empty()) {
+        if (options.shardDirectory.empty()) {
+            std::cerr << "--merge needs --shard-dir!" << std::endl;
+            return 1;
+        }
+        return mergeShards(options.shardDirectory, options.mergedManifestPath);
+    }
+    std::unique_ptr<flaccue::LeaseDirectory> leases;
+    if (!options.shardDirectory.empty()) {
+        if (options.runID.empty()) {
+            char date[16];
+            auto now = time(nullptr);
+            struct tm utc;
+            strftime(date, sizeof(date), "%Y-%m-%d", gmtime_r(&now, &utc));
+            options.runID = date;
+        }
+        if (options.runID.find('/') != std::string::npos || options.runID[0] == '.') {
+            std::cerr << "Invalid --run: '" << options.runID << "'" << std::endl;
+            return 1;
+        }
+        if (mkdir(options.shardDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr << "Failed to create '" << options.shardDirectory << "': " << strerror(errno) << std::endl;
+            return 1;
+        }
+        auto workerName = options.workerName.empty() ? flaccue::LeaseDirectory::DefaultWorkerName() : options.workerName;
+        leases = std::make_unique<flaccue::LeaseDirectory>(options.shardDirectory + "/run-" + options.runID, workerName, std::chrono::seconds(options.leaseDuration));
+        if (options.manifestPath.empty()) {
+            options.manifestPath = options.shardDirectory + "/" + workerName + ".manifest";
+        }
+    }
+    if (!options.watchDirectories.empty() && options.manifestPath.empty()) {
+        options.manifestPath = options.watchDirectories[0] + "/.flaccue.manifest";
+    }
+    
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    flaccue::ThreadPool pool(options.numberOfThreads);
+    flaccue::Prefetcher prefetcher(options.prefetchBudget << 20);
+    std::unique_ptr<cue::Manifest> manifest;
+    if (!options.manifestPath.empty()) {
+        manifest = std::make_unique<cue::Manifest>(options.manifestPath);
+    }
+    std::unique_ptr<flaccue::MetricsReport> metricsReport;
+    if (!options.metricsPath.empty()) {
+        metricsReport = std::make_unique<flaccue::MetricsReport>(options.metricsPath);
+    }
+    flaccue::PrometheusMetrics prometheus;
+    std::unique_ptr<flaccue::PrometheusTextfile> prometheusTextfile;
+    if (!options.prometheusPath.empty()) {
+        declarePrometheusMetrics(prometheus);
+        prometheus.set("flaccue_queue_depth", options.watchDirectories.empty() ? (double)albums.size() : 0);
+        prometheusTextfile = std::make_unique<flaccue::PrometheusTextfile>(options.prometheusPath, prometheus, std::chrono::seconds(options.prometheusInterval));
+    }
+    if (!options.tracePath.empty()) {
+        flaccue::startTracing();
+    }
+    auto finishRun = [&]() {
+        if (metricsReport) {
+            metricsReport->finish();
+        }
+        // Writes the final values.
+        prometheusTextfile.reset();
+        if (!options.tracePath.empty()) {
+            flaccue::stopTracing();
+            try {
+                flaccue::writeTrace(options.tracePath);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+        curl_global_cleanup();
+    };
+    Runtime runtime { pool, prefetcher, manifest.get(), metricsReport.get(), prometheusTextfile ? &prometheus : nullptr };
+    if (!options.watchDirectories.empty()) {
+        auto result = watchDirectories(options, runtime);
+        finishRun();
+        return result;
+    }
+    
+    std::atomic<size_t> nextAlbum(0);
+    std::atomic<size_t> processedAlbums(0);
+    std::atomic<size_t> failedAlbums(0);
+    std::atomic<size_t> leasedElsewhere(0);
+    // Albums that failed here are left to other workers rather than retried every pass.
+    std::mutex failedHereMutex;
+    std::unordered_set<std::string> failedHere;
+    // Workers of a sharded scan start at different places in the list, so they rarely
+    // race for the same album.
+    auto firstAlbum = leases && !albums.empty() ? std::hash<std::string>()(leases->worker()) % albums.size() : 0;
+    auto albumAt = [&](size_t position) -> const std::string& {
+        return albums[(firstAlbum + position) % albums.size()];
+    };
+    
+    while (true) {
+        // Each job keeps taking the next album in line until none are left, so a few large
+        // albums don't hold up the rest. The tasks of the albums themselves go to the same
+        // pool, and a job waiting for them runs them too, but never another job.
+        nextAlbum = 0;
+        leasedElsewhere = 0;
+        flaccue::TaskGroup jobs(pool);
+        for (size_t job = 0; job < options.numberOfJobs; ++job) {
+            jobs.run([&]() {
+                for (auto position = nextAlbum++; position < albums.size(); position = nextAlbum++) {
+                    auto& path = albumAt(position);
+                    if (runtime.prometheus) {
+                        runtime.prometheus->set("flaccue_queue_depth", (double)(albums.size() - position - 1));
                     }
-                    if (checksumGenerator.hasV1Frame450Checksum(i) &&
-                        checksumGenerator.v1Frame450ChecksumWithOffset(i, offset) == track.frame450CRC) {
-                        v1Frame450MatchingOffsets.push_back(offset);
+                    if (leases) {
+                        {
+                            std::lock_guard<std::mutex> lock(failedHereMutex);
+                            if (failedHere.count(path) > 0) {
+                                continue;
+                            }
+                        }
+                        try {
+                            auto claim = leases->tryClaim(path);
+                            if (claim == flaccue::LeaseDirectory::Claim::HeldElsewhere) {
+                                ++leasedElsewhere;
+                            }
+                            if (claim != flaccue::LeaseDirectory::Claim::Claimed) {
+                                // Another job may have guessed it would be next.
+                                if (auto directory = albumDirectory(path)) {
+                                    prefetcher.releaseDirectory(*directory);
+                                }
+                                continue;
+                            }
+                        } catch (const std::exception& e) {
+                            std::lock_guard<std::mutex> lock(runtime.outputMutex);
+                            std::cerr << path << ": " << e.what() << std::endl;
+                            ++failedAlbums;
+                            continue;
+                        }
+                    }
+                    
+                    ++processedAlbums;
+                    // The album this job probably takes next, read ahead while this one is done.
+                    auto following = position + options.numberOfJobs;
+                    auto succeeded = runAlbum(path, following < albums.size() ? std::optional<std::string>(albumAt(following)) : std::nullopt, options, runtime);
+                    if (!succeeded) {
+                        ++failedAlbums;
+                    }
+                    if (leases) {
+                        // A failed album is only released: the error might be transient,
+                        // like a failed AccurateRip download, and another worker or the
+                        // next run can try again.
+                        try {
+                            if (succeeded) {
+                                leases->complete(path);
+                            } else {
+                                std::lock_guard<std::mutex> lock(failedHereMutex);
+                                failedHere.insert(path);
+                                leases->release(path);
+                            }
+                        } catch (const std::exception& e) {
+                            std::lock_guard<std::mutex> lock(runtime.outputMutex);
+                            std::cerr << path << ": " << e.what() << std::endl;
+                        }
                     }
                 }
-                
-                if (v1MatchingOffsets.size() > 0 && (v1MatchingOffsets.size() > 1 || v1MatchingOffsets[0] != 0)) {
-                    accurateRipLogStream << " V1(offsets: " << createOffsetIntervalsString(v1MatchingOffsets) << ")";
-                }
-                if (v1Frame450MatchingOffsets.size() > 0 && (v1Frame450MatchingOffsets.size() > 1 || v1Frame450MatchingOffsets[0] != 0)) {
-                    accurateRipLogStream << " V1_Fr450(offsets: " << createOffsetIntervalsString(v1Frame450MatchingOffsets) << ")";
-                }
-                
-                accurateRipLogStream << std::endl;
-            }
-            accurateRipLogStream << std::endl;
+            });
+        }
+        jobs.wait();
+        if (leasedElsewhere == 0) {
+            break;
         }
-        accurateRipLogFileStream.close();
+        // Whatever other workers are still holding gets taken over if they die.
+        std::this_thread::sleep_for(std::chrono::seconds(std::min(std::max(options.leaseDuration / 4, 1u), 30u)));
     }
+    finishRun();
     
-    return 0;
+    if (processedAlbums > 1) {
+        std::cerr << "Processed " << processedAlbums << " albums, " << failedAlbums << " failed." << std::endl;
+    }
+    return failedAlbums == 0 ? 0 : 1;
 }
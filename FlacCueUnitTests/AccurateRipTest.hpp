@@ -217,6 +217,40 @@ BOOST_AUTO_TEST_CASE(ChecksumCalculation) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(InterleavedChecksumCalculation) {
+    auto testDisc = TestDisc::Create(3, 2 * cue::CdSamplesPerFrame);
+    std::vector<uint8_t> littleEndian, bigEndian;
+    for (size_t i = 0; i < testDisc.channel0.size(); ++i) {
+        for (auto sample : { (uint16_t)testDisc.channel0[i], (uint16_t)testDisc.channel1[i] }) {
+            littleEndian.push_back(sample & 0xFF);
+            littleEndian.push_back(sample >> 8);
+            bigEndian.push_back(sample >> 8);
+            bigEndian.push_back(sample & 0xFF);
+        }
+    }
+    
+    accuraterip::ChecksumGenerator planar(testDisc.toc);
+    int32_t* buffers[2] = { &testDisc.channel0[0], &testDisc.channel1[0] };
+    planar.processSamples(buffers, (uint32_t)testDisc.discLength().samples);
+    
+    accuraterip::ChecksumGenerator interleaved(testDisc.toc);
+    auto half = (uint32_t)testDisc.discLength().samples / 2;
+    interleaved.processInterleavedSamples(littleEndian.data(), half);
+    interleaved.processInterleavedSamples(littleEndian.data() + 4 * half, (uint32_t)testDisc.discLength().samples - half);
+    
+    accuraterip::ChecksumGenerator interleavedBigEndian(testDisc.toc);
+    interleavedBigEndian.processInterleavedSamples(bigEndian.data(), (uint32_t)testDisc.discLength().samples, true);
+    
+    for (auto track = 0; track < testDisc.numberOfTracks(); ++track) {
+        for (auto offset : { planar.minimumOffset(), 0, planar.maximumOffset() }) {
+            BOOST_CHECK_EQUAL(interleaved.v1ChecksumWithOffset(track, offset), planar.v1ChecksumWithOffset(track, offset));
+            BOOST_CHECK_EQUAL(interleavedBigEndian.v1ChecksumWithOffset(track, offset), planar.v1ChecksumWithOffset(track, offset));
+        }
+        BOOST_CHECK_EQUAL(interleaved.v2Checksum(track), planar.v2Checksum(track));
+        BOOST_CHECK_EQUAL(interleavedBigEndian.v2Checksum(track), planar.v2Checksum(track));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif /* AccurateRipTest_h */
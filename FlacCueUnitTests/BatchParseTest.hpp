@@ -0,0 +1,133 @@
+//
+//  BatchParseTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef BatchParseTest_h
+#define BatchParseTest_h
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <sys/stat.h>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+struct BatchParseTestFixture {
+    TemporaryDirectory directory { "FlacCueBatchParseTest" };
+    std::string root = directory.path();
+
+    std::string createDirectory(const std::string& relativePath) {
+        auto path = root + "/" + relativePath;
+        mkdir(path.c_str(), 0700);
+        return path;
+    }
+
+    std::string createFile(const std::string& relativePath, const std::string& contents) {
+        return directory.write(relativePath, contents);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(BatchParseTest, BatchParseTestFixture)
+
+BOOST_AUTO_TEST_CASE(TaskGroupRunsNestedTasks) {
+    flaccue::ThreadPool pool(4);
+    flaccue::TaskGroup tasks(pool);
+    std::atomic<int> counter(0);
+    for (auto i = 0; i < 100; ++i) {
+        tasks.run([&]() {
+            for (auto j = 0; j < 10; ++j) {
+                tasks.run([&]() { ++counter; });
+            }
+        });
+    }
+    tasks.wait();
+    BOOST_CHECK_EQUAL(counter, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(TaskGroupWaitRunsOnlyItsOwnTasks) {
+    flaccue::ThreadPool pool(2);
+    flaccue::TaskGroup jobs(pool);
+    static thread_local bool isInsideJob = false;
+    std::atomic<int> nestedJobs(0);
+    std::atomic<int> innerTasks(0);
+    for (auto i = 0; i < 16; ++i) {
+        jobs.run([&]() {
+            if (isInsideJob) {
+                ++nestedJobs;
+            }
+            isInsideJob = true;
+            flaccue::TaskGroup tasks(pool);
+            for (auto j = 0; j < 4; ++j) {
+                tasks.run([&]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++innerTasks;
+                });
+            }
+            tasks.wait();
+            isInsideJob = false;
+        });
+    }
+    jobs.wait();
+    BOOST_CHECK_EQUAL(nestedJobs, 0);
+    BOOST_CHECK_EQUAL(innerTasks, 64);
+}
+
+BOOST_AUTO_TEST_CASE(TaskGroupRethrowsErrors) {
+    flaccue::ThreadPool pool(2);
+    flaccue::TaskGroup tasks(pool);
+    tasks.run([]() { throw std::runtime_error("failure"); });
+    BOOST_CHECK_THROW(tasks.wait(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ParsesNestedTree) {
+    createDirectory("artist");
+    createDirectory("artist/album1");
+    createDirectory("artist/album2");
+    auto album1 = createFile("artist/album1/album.cue",
+                             "FILE \"a.flac\" WAVE\n"
+                             "  TRACK 01 AUDIO\n"
+                             "    INDEX 01 00:00:00\n");
+    auto album2 = createFile("artist/album2/ALBUM.CUE",
+                             "FILE \"b.flac\" WAVE\n"
+                             "  TRACK 01 AUDIO\n"
+                             "    INDEX 01 00:00:00\n"
+                             "  TRACK 02 AUDIO\n"
+                             "    INDEX 01 01:00:00\n");
+    auto broken = createFile("broken.cue",
+                             "FILE \"c.flac\" WAVE\n"
+                             "  TRACK 01 AUDIO\n"
+                             "    BOGUS\n");
+    createFile("artist/album1/a.flac", "");
+
+    std::map<std::string, long> trackCounts;
+    std::map<std::string, std::string> errors;
+
+    flaccue::ThreadPool pool(4);
+    cue::BatchParser parser(pool);
+    parser.parseTree(root, [&](const std::string& path, std::shared_ptr<cue::Disc> disc, std::exception_ptr error) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const cue::ParseError& e) {
+                errors[path] = e.what();
+            }
+        } else {
+            trackCounts[path] = disc->tracksCend() - disc->tracksCbegin();
+        }
+    });
+
+    BOOST_CHECK_EQUAL(trackCounts.size(), 2);
+    BOOST_CHECK_EQUAL(trackCounts[album1], 1);
+    BOOST_CHECK_EQUAL(trackCounts[album2], 2);
+    BOOST_CHECK_EQUAL(errors.size(), 1);
+    BOOST_CHECK_EQUAL(errors[broken].find("Line 3"), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* BatchParseTest_h */
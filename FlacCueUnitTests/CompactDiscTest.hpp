@@ -0,0 +1,114 @@
+//
+//  CompactDiscTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef CompactDiscTest_h
+#define CompactDiscTest_h
+
+#include <iostream>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(CompactDiscTest)
+
+static const std::string compactDiscTestSheet =
+"REM GENRE Rock\n"
+"REM DATE 1999\n"
+"PERFORMER \"The Band\"\n"
+"TITLE \"The Album\"\n"
+"FILE \"image.flac\" WAVE\n"
+"  TRACK 01 AUDIO\n"
+"    TITLE \"First\"\n"
+"    PERFORMER \"The Band\"\n"
+"    INDEX 00 00:00:00\n"
+"    INDEX 01 00:02:00\n"
+"      REM after index\n"
+"  TRACK 02 AUDIO\n"
+"    REM DATE 1999\n"
+"    TITLE \"Second\"\n"
+"    PERFORMER \"The Band\"\n"
+"    ISRC ABCDE1234567\n"
+"    PREGAP 00:01:00\n"
+"    INDEX 01 03:00:00\n";
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+    std::istringstream stream(compactDiscTestSheet);
+    cue::Disc disc(stream);
+    cue::CompactDisc compactDisc(disc);
+
+    checkDiscsAreEqual(disc, *compactDisc.toDisc());
+}
+
+BOOST_AUTO_TEST_CASE(ParsedDirectly) {
+    std::istringstream discStream(compactDiscTestSheet);
+    cue::Disc disc(discStream);
+    std::istringstream compactDiscStream(compactDiscTestSheet);
+    cue::CompactDisc compactDisc(compactDiscStream);
+
+    checkDiscsAreEqual(disc, *compactDisc.toDisc());
+}
+
+BOOST_AUTO_TEST_CASE(Accessors) {
+    std::istringstream stream(compactDiscTestSheet);
+    cue::CompactDisc disc(stream);
+
+    BOOST_CHECK_EQUAL(disc.comments().size(), 2);
+    BOOST_CHECK_EQUAL(disc.string(disc.comments()[1]), "DATE 1999");
+    BOOST_CHECK(disc.performer() == std::string_view("The Band"));
+    BOOST_CHECK(!disc.catalog());
+
+    BOOST_CHECK_EQUAL(disc.tracks().size(), 2);
+    auto& track1 = disc.tracks()[0];
+    BOOST_CHECK_EQUAL(track1.number, 1);
+    BOOST_CHECK_EQUAL(track1.pregap, -1);
+    BOOST_CHECK_EQUAL(disc.indexes(track1).size(), 2);
+    BOOST_CHECK_EQUAL(disc.indexes(track1)[1].begin, cue::Time(0,2,0));
+    BOOST_CHECK_EQUAL(disc.comments(disc.indexes(track1)[1]).size(), 1);
+    BOOST_CHECK_EQUAL(disc.string(disc.file(disc.indexes(track1)[0]).path), "image.flac");
+
+    auto& track2 = disc.tracks()[1];
+    BOOST_CHECK_EQUAL(track2.pregap, cue::Time(0,1,0).samples);
+    BOOST_CHECK(disc.optionalString(track2.isrc) == std::string_view("ABCDE1234567"));
+}
+
+BOOST_AUTO_TEST_CASE(StringsAreInterned) {
+    std::istringstream stream(compactDiscTestSheet);
+    cue::CompactDisc disc(stream);
+
+    auto& track1 = disc.tracks()[0];
+    auto& track2 = disc.tracks()[1];
+    BOOST_CHECK_EQUAL(track1.performer.offset, track2.performer.offset);
+    BOOST_CHECK_EQUAL(track1.dataType.offset, track2.dataType.offset);
+    BOOST_CHECK_EQUAL(disc.comments()[1].offset, disc.comments(track2)[0].offset);
+}
+
+BOOST_AUTO_TEST_CASE(RejectsValuesThatDoNotFit) {
+    // The parser only reads two digits, but Disc itself keeps any number.
+    std::istringstream discStream(compactDiscTestSheet);
+    cue::Disc disc(discStream);
+    disc.tracksBegin()->number = 300;
+    BOOST_CHECK_THROW(cue::CompactDisc compactDisc(disc), cue::ParseError);
+
+    std::string tooManyComments =
+    "FILE \"image.flac\" WAVE\n"
+    "  TRACK 01 AUDIO\n";
+    for (int i = 0; i <= UINT16_MAX; ++i) {
+        tooManyComments += "    REM X\n";
+    }
+    tooManyComments += "    INDEX 01 00:00:00\n";
+    std::istringstream manyCommentsDiscStream(tooManyComments);
+    cue::Disc manyCommentsDisc(manyCommentsDiscStream);
+    BOOST_CHECK_THROW(cue::CompactDisc compactDisc(manyCommentsDisc), std::length_error);
+    std::istringstream manyCommentsStream(tooManyComments);
+    BOOST_CHECK_THROW(cue::CompactDisc compactDisc(manyCommentsStream), std::length_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* CompactDiscTest_h */
@@ -327,6 +327,97 @@ BOOST_AUTO_TEST_CASE(Serialization) {
     BOOST_CHECK_EQUAL((std::stringstream() << disc).str(), cueSheet);
 }
 
+BOOST_AUTO_TEST_CASE(SerializationToBufferAndFileDescriptor) {
+    std::string cueSheet =
+    "REM GENRE Rock\n"
+    "CATALOG 1234567890123\n"
+    "PERFORMER \"The \\\"Band\\\"\"\n"
+    "TITLE \"Album\"\n"
+    "FILE \"testFile1\" WAVE\n"
+    "  TRACK 01 AUDIO\n"
+    "    TITLE \"Intro\"\n"
+    "    ISRC ABCDE1234567\n"
+    "    FLAGS DCP\n"
+    "    INDEX 00 00:00:00\n"
+    "    INDEX 01 00:02:00\n"
+    "      REM index comment\n"
+    "  TRACK 02 AUDIO\n"
+    "    INDEX 01 79:59:74\n";
+    
+    std::istringstream stream(cueSheet);
+    cue::Disc disc(stream);
+    
+    std::string buffer = "prefix";
+    cue::serialize(disc, buffer);
+    BOOST_CHECK_EQUAL(buffer, "prefix" + cueSheet);
+    
+    FILE* file = tmpfile();
+    cue::write(disc, fileno(file));
+    rewind(file);
+    std::string written(cueSheet.size() + 1, '\0');
+    written.resize(fread(&written[0], 1, written.size(), file));
+    fclose(file);
+    BOOST_CHECK_EQUAL(written, cueSheet);
+}
+
+struct FileAndIndexCollector : public cue::ParseVisitor {
+    std::vector<std::string> files;
+    std::vector<std::pair<int, cue::Time>> indexes;
+    int numberOfRems = 0;
+    
+    virtual void onFile(std::string_view path, std::string_view fileType) override {
+        files.emplace_back(path);
+    }
+    
+    virtual void onIndex(int index, cue::Time begin) override {
+        indexes.emplace_back(index, begin);
+    }
+    
+    virtual void onRem(std::string_view comment) override {
+        ++numberOfRems;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(Visitor) {
+    std::string cueSheet =
+    "REM COMMENT one\n"
+    "TITLE \"Album\"\n"
+    "FILE \"testFile1\" WAVE\n"
+    "  TRACK 01 AUDIO\n"
+    "    INDEX 01 00:00:00\n"
+    "      REM two\n"
+    "FILE \"testFile2\" WAVE\n"
+    "  TRACK 02 AUDIO\n"
+    "    INDEX 00 00:00:00\n"
+    "    INDEX 01 00:01:00\n";
+    
+    std::istringstream stream(cueSheet);
+    FileAndIndexCollector collector;
+    cue::parse(stream, collector);
+    
+    BOOST_CHECK_EQUAL(collector.files.size(), 2);
+    BOOST_CHECK_EQUAL(collector.files[1], "testFile2");
+    BOOST_CHECK_EQUAL(collector.indexes.size(), 3);
+    BOOST_CHECK_EQUAL(collector.indexes[2].first, 1);
+    BOOST_CHECK_EQUAL(collector.indexes[2].second, cue::Time(0,1,0));
+    BOOST_CHECK_EQUAL(collector.numberOfRems, 2);
+}
+
+BOOST_AUTO_TEST_CASE(SemanticErrorsHaveLineNumbers) {
+    std::string cueSheet =
+    "REM COMMENT\n"
+    "FILE \"testFile1\" WAVE\n"
+    "    FLAGS DCP\n";
+    
+    std::istringstream stream(cueSheet);
+    try {
+        cue::Disc disc(stream);
+        BOOST_FAIL("ParseError expected");
+    } catch (const cue::ParseError& e) {
+        BOOST_CHECK_EQUAL(std::string(e.what()), "Line 3: FLAGS must be used within a TRACK!");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif /* CueParseTest_h */
@@ -0,0 +1,141 @@
+//
+//  DiscSnapshotTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef DiscSnapshotTest_h
+#define DiscSnapshotTest_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+struct DiscSnapshotTestFixture {
+    TemporaryDirectory directory { "FlacCueDiscSnapshotTest" };
+    std::string snapshotPath = directory.path("snapshot");
+    std::string copyPath = directory.path("snapshot.copy");
+    std::string sourcePath = directory.path("disc.cue");
+};
+
+BOOST_FIXTURE_TEST_SUITE(DiscSnapshotTest, DiscSnapshotTestFixture)
+
+static const std::string discSnapshotTestSheet1 =
+"REM DATE 2001\n"
+"PERFORMER \"Artist\"\n"
+"FILE \"a.flac\" WAVE\n"
+"  TRACK 01 AUDIO\n"
+"    INDEX 00 00:00:00\n"
+"    INDEX 01 00:02:00\n"
+"FILE \"b.flac\" WAVE\n"
+"  TRACK 02 AUDIO\n"
+"    PREGAP 00:02:00\n"
+"    INDEX 01 00:00:00\n"
+"      REM after\n";
+
+static const std::string discSnapshotTestSheet2 =
+"FILE \"c.flac\" WAVE\n"
+"  TRACK 01 AUDIO\n"
+"    TITLE \"Only\"\n"
+"    INDEX 01 00:00:00\n";
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+    std::istringstream stream1(discSnapshotTestSheet1);
+    cue::Disc disc1(stream1);
+    std::istringstream stream2(discSnapshotTestSheet2);
+    cue::Disc disc2(stream2);
+
+    cue::SnapshotWriter writer;
+    writer.add("/music/1.cue", cue::SourceInfo { 1234567890, 42 }, disc1);
+    writer.add("/music/2.cue", cue::SourceInfo { 987654321, 7 }, disc2);
+    writer.write(snapshotPath);
+
+    cue::Snapshot snapshot(snapshotPath);
+    BOOST_CHECK_EQUAL(snapshot.numberOfEntries(), 2);
+    BOOST_CHECK_EQUAL(snapshot.path(0), "/music/1.cue");
+    BOOST_CHECK_EQUAL(snapshot.path(1), "/music/2.cue");
+    BOOST_CHECK(snapshot.source(0) == (cue::SourceInfo { 1234567890, 42 }));
+    BOOST_CHECK_EQUAL(snapshot.find("/music/2.cue").value_or(99), 1);
+    BOOST_CHECK(!snapshot.find("/music/3.cue"));
+
+    checkDiscsAreEqual(disc1, *snapshot.disc(0)->toDisc());
+    checkDiscsAreEqual(disc2, *snapshot.disc(1)->toDisc());
+    BOOST_CHECK_EQUAL(snapshot.disc(0).get(), snapshot.disc(0).get());
+}
+
+BOOST_AUTO_TEST_CASE(CopiesEntriesWithoutDecoding) {
+    std::istringstream stream(discSnapshotTestSheet1);
+    cue::Disc disc(stream);
+
+    cue::SnapshotWriter writer;
+    writer.add("/music/1.cue", cue::SourceInfo { 1, 2 }, disc);
+    writer.write(snapshotPath);
+
+    cue::Snapshot snapshot(snapshotPath);
+    cue::SnapshotWriter copyWriter;
+    copyWriter.add(snapshot, 0);
+    copyWriter.write(copyPath);
+
+    cue::Snapshot copy(copyPath);
+    BOOST_CHECK_EQUAL(copy.path(0), "/music/1.cue");
+    checkDiscsAreEqual(disc, *copy.disc(0)->toDisc());
+}
+
+BOOST_AUTO_TEST_CASE(DetectsStaleEntries) {
+    std::ofstream(sourcePath) << discSnapshotTestSheet2;
+    std::ifstream input(sourcePath);
+    cue::Disc disc(input);
+
+    cue::SnapshotWriter writer;
+    writer.add(sourcePath, cue::SourceInfo::Stat(sourcePath).value(), disc);
+    writer.add("/nonexistent.cue", cue::SourceInfo { 0, 0 }, disc);
+    writer.write(snapshotPath);
+
+    cue::Snapshot snapshot(snapshotPath);
+    BOOST_CHECK(!snapshot.isStale(0));
+    BOOST_CHECK(snapshot.isStale(1));
+
+    std::ofstream(sourcePath, std::ios::app) << "REM changed\n";
+    BOOST_CHECK(snapshot.isStale(0));
+}
+
+BOOST_AUTO_TEST_CASE(RejectsGarbage) {
+    std::ofstream(snapshotPath) << "definitely not a snapshot file";
+    BOOST_CHECK_THROW(cue::Snapshot snapshot(snapshotPath), cue::SnapshotError);
+}
+
+BOOST_AUTO_TEST_CASE(RejectsCorruptCountsAndOffsets) {
+    std::istringstream stream(discSnapshotTestSheet1);
+    cue::Disc disc(stream);
+    cue::SnapshotWriter writer;
+    writer.add("/music/1.cue", cue::SourceInfo { 1, 2 }, disc);
+    writer.write(snapshotPath);
+
+    std::ifstream input(snapshotPath, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    auto corrupt = [&](size_t offset, size_t size) {
+        auto copy = contents;
+        copy.replace(offset, size, std::string(size, '\xFF'));
+        std::ofstream(copyPath, std::ios::binary) << copy;
+    };
+
+    // A comment count of 4G in the blob, right after the header: nothing is allocated for
+    // records that can't be there.
+    corrupt(24 + 4, 4);
+    cue::Snapshot hugeCount(copyPath);
+    BOOST_CHECK_THROW(hugeCount.disc(0), cue::SnapshotError);
+
+    // A blob offset that wraps around when the size is added to it.
+    auto entryTableOffset = contents.size() - 40;
+    corrupt(entryTableOffset, 8);
+    BOOST_CHECK_THROW(cue::Snapshot wrappedOffset(copyPath), cue::SnapshotError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* DiscSnapshotTest_h */
@@ -0,0 +1,118 @@
+//
+//  FlacFrameTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef FlacFrameTest_h
+#define FlacFrameTest_h
+
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(FlacFrameTest)
+
+static std::string md5String(const std::string& data) {
+    flaccue::MD5 md5;
+    md5.update(data.data(), data.size());
+    return flaccue::MD5::toString(md5.digest());
+}
+
+// A fixed-blocksize frame of 4096 samples of 44.1 kHz 16 bit stereo; the "subframes" are
+// just filler, nothing here looks into them.
+static std::vector<uint8_t> makeFrame(uint8_t frameNumber, const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> frame = { 0xFF, 0xF8, 0xC9, 0x18, frameNumber };
+    frame.push_back(flaccue::crc8(frame.data(), frame.size()));
+    frame.insert(frame.end(), body.begin(), body.end());
+    auto crc = flaccue::crc16(frame.data(), frame.size());
+    frame.push_back((uint8_t)(crc >> 8));
+    frame.push_back((uint8_t)crc);
+    return frame;
+}
+
+BOOST_AUTO_TEST_CASE(MD5MatchesReferenceDigests) {
+    BOOST_CHECK_EQUAL(md5String(""), "d41d8cd98f00b204e9800998ecf8427e");
+    BOOST_CHECK_EQUAL(md5String("abc"), "900150983cd24fb0d6963f7d28e17f72");
+    BOOST_CHECK_EQUAL(md5String("The quick brown fox jumps over the lazy dog"), "9e107d9d372bb6826bd81d3542a419d6");
+
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += (char)(i * 7);
+    }
+    flaccue::MD5 pieces;
+    for (size_t i = 0; i < data.size(); i += 37) {
+        pieces.update(data.data() + i, std::min<size_t>(37, data.size() - i));
+    }
+    BOOST_CHECK_EQUAL(flaccue::MD5::toString(pieces.digest()), md5String(data));
+}
+
+BOOST_AUTO_TEST_CASE(CRCsMatchCheckValues) {
+    const std::string check = "123456789";
+    BOOST_CHECK_EQUAL(flaccue::crc8((const uint8_t*)check.data(), check.size()), 0xF4);
+    BOOST_CHECK_EQUAL(flaccue::crc16((const uint8_t*)check.data(), check.size()), 0xFEE8);
+}
+
+BOOST_AUTO_TEST_CASE(FrameHeaderIsValidated) {
+    auto frame = makeFrame(3, { 1, 2, 3, 4 });
+    BOOST_CHECK_EQUAL(flaccue::frameHeaderSize(frame.data(), frame.size()), 6);
+
+    frame[3] ^= 0x02;
+    BOOST_CHECK_THROW(flaccue::frameHeaderSize(frame.data(), frame.size()), flaccue::FrameError);
+    frame[0] = 0;
+    BOOST_CHECK_THROW(flaccue::frameHeaderSize(frame.data(), frame.size()), flaccue::FrameError);
+}
+
+BOOST_AUTO_TEST_CASE(RenumberedFrameKeepsSubframes) {
+    std::vector<uint8_t> body = { 0x10, 0x20, 0x30, 0x40, 0x50 };
+    auto frame = makeFrame(3, body);
+
+    std::string output = "xx";
+    flaccue::appendRenumberedFrame(frame.data(), frame.size(), 3 * 4096, output);
+    auto renumbered = (const uint8_t*)output.data() + 2;
+    auto size = output.size() - 2;
+
+    std::vector<uint8_t> header(renumbered, renumbered + 7);
+    std::vector<uint8_t> expectedHeader = { 0xFF, 0xF9, 0xC9, 0x18, 0xE3, 0x80, 0x80 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(header.begin(), header.end(), expectedHeader.begin(), expectedHeader.end());
+    BOOST_REQUIRE_EQUAL(flaccue::frameHeaderSize(renumbered, size), 8);
+    BOOST_CHECK_EQUAL_COLLECTIONS(renumbered + 8, renumbered + size - 2, body.begin(), body.end());
+    BOOST_CHECK_EQUAL(flaccue::crc16(renumbered, size - 2), (renumbered[size - 2] << 8) | renumbered[size - 1]);
+
+    output.clear();
+    flaccue::appendRenumberedFrame(frame.data(), frame.size(), 1ULL << 35, output);
+    BOOST_CHECK_EQUAL((uint8_t)output[4], 0xFE);
+    BOOST_CHECK_EQUAL(flaccue::frameHeaderSize((const uint8_t*)output.data(), output.size()), 12);
+    BOOST_CHECK_THROW(flaccue::appendRenumberedFrame(frame.data(), frame.size(), 1ULL << 36, output), flaccue::FrameError);
+}
+
+BOOST_AUTO_TEST_CASE(StreamHeaderHasFixedSize) {
+    flaccue::StreamInfo streamInfo;
+    streamInfo.sampleRate = 44100;
+    streamInfo.channels = 2;
+    streamInfo.bitsPerSample = 16;
+    streamInfo.totalSamples = 0x123456789ULL;
+
+    std::string header;
+    flaccue::appendStreamHeader(streamInfo, { flaccue::SeekPoint { 0, 0, 4096 } }, 2, header);
+    BOOST_REQUIRE_EQUAL(header.size(), flaccue::streamHeaderSize(2));
+    BOOST_CHECK_EQUAL(header.substr(0, 4), "fLaC");
+    BOOST_CHECK_EQUAL((uint8_t)header[4], 0x00);
+    BOOST_CHECK_EQUAL((uint8_t)header[18], 0x0A);
+    BOOST_CHECK_EQUAL((uint8_t)header[19], 0xC4);
+    BOOST_CHECK_EQUAL((uint8_t)header[20], 0x42);
+    BOOST_CHECK_EQUAL((uint8_t)header[21], 0xF1);
+    BOOST_CHECK_EQUAL((uint8_t)header[25], 0x89);
+    BOOST_CHECK_EQUAL((uint8_t)header[42], 0x83);
+    BOOST_CHECK_EQUAL((uint8_t)header[46 + 18], 0xFF); // placeholder point
+
+    BOOST_CHECK_THROW(flaccue::appendStreamHeader(streamInfo, { {}, {}, {} }, 2, header), flaccue::FrameError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* FlacFrameTest_h */
@@ -395,6 +395,34 @@ BOOST_AUTO_TEST_CASE(MultipleFilesGapsPrepended) {
     BOOST_CHECK(track3 + 1 == split.outputSheet->tracksCend());
 }
 
+BOOST_AUTO_TEST_CASE(SplitPassesKeepDiscOrder) {
+    // Track 2 is in file B between two parts of file A, and track 4 starts in A and
+    // runs on into B.
+    cue::Split split;
+    split.outputFiles = {
+        { "1", { { "A", cue::Time(0,0,0), cue::Time(1,0,0) } } },
+        { "2", { { "B", cue::Time(0,0,0), std::nullopt } } },
+        { "3", { { "A", cue::Time(1,0,0), cue::Time(2,0,0) } } },
+        { "4", { { "A", cue::Time(2,0,0), std::nullopt }, { "B", cue::Time(0,0,0), cue::Time(0,1,0) } } },
+        { "5", { { "B", cue::Time(0,1,0), std::nullopt } } },
+    };
+
+    auto passes = cue::planSplitPasses(split, { 4, 0, 1, 2, 3 });
+    std::vector<std::pair<std::string, std::vector<std::pair<size_t, size_t>>>> expected = {
+        { "A", { { 0, 0 } } },
+        { "B", { { 1, 0 } } },
+        { "A", { { 2, 0 }, { 3, 0 } } },
+        { "B", { { 3, 1 }, { 4, 0 } } },
+    };
+    BOOST_REQUIRE_EQUAL(passes.size(), expected.size());
+    for (size_t i = 0; i < passes.size(); ++i) {
+        BOOST_CHECK_EQUAL(passes[i].inputFile, expected[i].first);
+        BOOST_CHECK(passes[i].segments == expected[i].second);
+    }
+
+    BOOST_CHECK_EQUAL(cue::planSplitPasses(split, { 2 }).size(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif /* GapsAppendedSplitTest_h */
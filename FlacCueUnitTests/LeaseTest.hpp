@@ -0,0 +1,72 @@
+//
+//  LeaseTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef LeaseTest_h
+#define LeaseTest_h
+
+#include <chrono>
+#include <string>
+#include <dirent.h>
+#include <sys/time.h>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(LeaseTest)
+
+BOOST_AUTO_TEST_CASE(WorkersShareItemsAndTakeOverStaleLeases) {
+    using Claim = flaccue::LeaseDirectory::Claim;
+    TemporaryDirectory root("FlacCueLeaseTest");
+    auto directory = root.path("leases");
+
+    {
+        flaccue::LeaseDirectory first(directory, "first", std::chrono::seconds(60));
+        flaccue::LeaseDirectory second(directory, "second", std::chrono::seconds(60));
+
+        BOOST_CHECK(first.tryClaim("/music/a.cue") == Claim::Claimed);
+        BOOST_CHECK(second.tryClaim("/music/a.cue") == Claim::HeldElsewhere);
+        first.complete("/music/a.cue");
+        BOOST_CHECK(second.tryClaim("/music/a.cue") == Claim::Done);
+
+        BOOST_CHECK(first.tryClaim("/music/b.cue") == Claim::Claimed);
+        first.release("/music/b.cue");
+        BOOST_CHECK(second.tryClaim("/music/b.cue") == Claim::Claimed);
+
+        // A worker that died an hour ago.
+        BOOST_CHECK(first.tryClaim("/music/c.cue") == Claim::Claimed);
+        auto dir = opendir(directory.c_str());
+        while (auto entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 6 && name.compare(name.size() - 6, 6, ".lease") == 0) {
+                struct timeval times[2] = { { time(nullptr) - 3600, 0 }, { time(nullptr) - 3600, 0 } };
+                utimes((directory + "/" + name).c_str(), times);
+            }
+        }
+        closedir(dir);
+        BOOST_CHECK(second.tryClaim("/music/c.cue") == Claim::Claimed);
+        BOOST_CHECK(first.tryClaim("/music/c.cue") == Claim::HeldElsewhere);
+        second.complete("/music/c.cue");
+        second.complete("/music/b.cue");
+    }
+
+    auto dir = opendir(directory.c_str());
+    size_t numberOfFiles = 0;
+    while (auto entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != ".." && name != "takeover.lock") {
+            BOOST_CHECK(name.compare(name.size() - 5, 5, ".done") == 0);
+            ++numberOfFiles;
+        }
+    }
+    closedir(dir);
+    BOOST_CHECK_EQUAL(numberOfFiles, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* LeaseTest_h */
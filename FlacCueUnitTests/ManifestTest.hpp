@@ -0,0 +1,87 @@
+//
+//  ManifestTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef ManifestTest_h
+#define ManifestTest_h
+
+#include <fstream>
+#include <string>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(ManifestTest)
+
+static cue::AlbumVerification makeVerification(const std::string& album, const std::string& input) {
+    cue::AlbumVerification verification;
+    verification.album = album;
+    verification.cueSheetDigest[0] = 0x42;
+    verification.settings = "verify-only";
+    verification.inputs.push_back(cue::ManifestInput::Capture(input));
+    verification.tracks.push_back(cue::TrackVerification { 0x12345678, std::nullopt, 0x9abcdef0, 0 });
+    verification.tracks.push_back(cue::TrackVerification { 0xdeadbeef, 0x0badf00d, 0x00c0ffee, 7 });
+    return verification;
+}
+
+BOOST_AUTO_TEST_CASE(RecordsSurviveReopeningAndTornLines) {
+    TemporaryDirectory directory("FlacCueManifestTest");
+    auto inputPath = directory.write("input", std::string(1000, 'x'));
+    auto manifestPath = directory.path("albums.manifest");
+
+    auto verification = makeVerification("Album\twith \\ tab", inputPath);
+    {
+        cue::Manifest manifest(manifestPath);
+        BOOST_CHECK_EQUAL(manifest.numberOfAlbums(), 0);
+        manifest.record(makeVerification("Other", inputPath));
+        manifest.record(verification);
+    }
+    // A crash in the middle of appending a record.
+    std::ofstream(manifestPath, std::ios::binary | std::ios::app) << "0123456789abcdef Torn";
+
+    cue::Manifest manifest(manifestPath);
+    BOOST_CHECK_EQUAL(manifest.numberOfAlbums(), 2);
+    auto found = manifest.findUnchanged(verification.album, verification.cueSheetDigest, "verify-only");
+    BOOST_REQUIRE(found);
+    BOOST_CHECK(found->inputs == verification.inputs);
+    BOOST_CHECK(found->tracks == verification.tracks);
+
+    BOOST_CHECK(!manifest.findUnchanged(verification.album, verification.cueSheetDigest, "reencode"));
+    BOOST_CHECK(!manifest.findUnchanged(verification.album, flaccue::MD5::Digest(), "verify-only"));
+
+    std::ofstream(inputPath, std::ios::binary | std::ios::app) << "y";
+    BOOST_CHECK(!manifest.findUnchanged(verification.album, verification.cueSheetDigest, "verify-only"));
+}
+
+BOOST_AUTO_TEST_CASE(MergeTakesTheRecordsOfShards) {
+    TemporaryDirectory directory("FlacCueManifestMergeTest");
+    auto inputPath = directory.write("input", std::string(1000, 'x'));
+
+    {
+        cue::Manifest shard(inputPath + ".shard");
+        shard.record(makeVerification("A", inputPath));
+        shard.record(makeVerification("B", inputPath));
+        cue::Manifest merged(inputPath + ".merged");
+        merged.record(makeVerification("C", inputPath));
+        BOOST_CHECK_EQUAL(merged.merge(cue::Manifest::OpenReadOnly(inputPath + ".shard")), 2);
+        merged.record(makeVerification("D", inputPath));
+
+        // The shard's journal is still the file on disk.
+        shard.record(makeVerification("E", inputPath));
+        auto readOnly = cue::Manifest::OpenReadOnly(inputPath + ".shard");
+        BOOST_CHECK_EQUAL(readOnly.numberOfAlbums(), 3);
+        BOOST_CHECK_THROW(readOnly.record(makeVerification("F", inputPath)), std::logic_error);
+    }
+
+    cue::Manifest merged(inputPath + ".merged");
+    BOOST_CHECK_EQUAL(merged.numberOfAlbums(), 4);
+    BOOST_CHECK(merged.find("A"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* ManifestTest_h */
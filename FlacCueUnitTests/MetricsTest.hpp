@@ -0,0 +1,108 @@
+//
+//  MetricsTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef MetricsTest_h
+#define MetricsTest_h
+
+#include <optional>
+#include <sstream>
+#include <string>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(MetricsTest)
+
+BOOST_AUTO_TEST_CASE(TimersAddUpPerStage) {
+    flaccue::Metrics metrics;
+    for (int i = 0; i < 3; ++i) {
+        flaccue::StageTimer timer(&metrics, flaccue::Stage::Checksum);
+        timer.addSamples(588);
+        timer.addBytes(2352);
+    }
+    {
+        flaccue::StageTimer timer(nullptr, flaccue::Stage::Decode);
+        timer.addSamples(1);
+    }
+
+    auto checksum = metrics.totals(flaccue::Stage::Checksum);
+    BOOST_CHECK_EQUAL(checksum.calls, 3);
+    BOOST_CHECK_EQUAL(checksum.samples, 3 * 588);
+    BOOST_CHECK_EQUAL(checksum.bytes, 3 * 2352);
+    BOOST_CHECK(checksum.wallNanoseconds >= 0);
+    BOOST_CHECK_EQUAL(metrics.totals(flaccue::Stage::Decode).calls, 0);
+
+    flaccue::Metrics batch;
+    batch.add(metrics);
+    batch.add(metrics);
+    BOOST_CHECK_EQUAL(batch.totals(flaccue::Stage::Checksum).samples, 6 * 588);
+
+    std::ostringstream json;
+    metrics.writeJSON(json);
+    BOOST_CHECK_EQUAL(json.str().compare(0, 13, "{\"checksum\":{"), 0);
+    BOOST_CHECK(json.str().find("\"samples\":1764,\"calls\":3}}") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TasksAddTheirCPUTimeToTheStage) {
+    const int64_t millisecond = 1000000;
+    auto spin = [&]() {
+        auto start = flaccue::threadCPUNanoseconds();
+        while (flaccue::threadCPUNanoseconds() - start < 20 * millisecond) {
+        }
+    };
+
+    flaccue::Metrics metrics;
+    flaccue::ThreadPool pool(2);
+    {
+        flaccue::StageTimer timer(&metrics, flaccue::Stage::Decode);
+        BOOST_CHECK(flaccue::currentStageAccount().metrics == &metrics);
+        flaccue::TaskGroup tasks(pool);
+        for (int i = 0; i < 4; ++i) {
+            tasks.run(spin);
+        }
+        tasks.wait();
+    }
+    BOOST_CHECK(flaccue::currentStageAccount().metrics == nullptr);
+
+    // Tasks the waiting thread ran itself are only counted once.
+    auto decode = metrics.totals(flaccue::Stage::Decode);
+    BOOST_CHECK_EQUAL(decode.calls, 1);
+    BOOST_CHECK_GE(decode.cpuNanoseconds, 80 * millisecond);
+    BOOST_CHECK_LT(decode.cpuNanoseconds, 100 * millisecond);
+}
+
+BOOST_AUTO_TEST_CASE(StageScopesEndInAnyOrder) {
+    flaccue::Metrics metrics;
+    std::optional<flaccue::StageTimer> checksum;
+    {
+        flaccue::StageTimer decode(&metrics, flaccue::Stage::Decode);
+        checksum.emplace(&metrics, flaccue::Stage::Checksum);
+        BOOST_CHECK(flaccue::currentStageAccount().stage == flaccue::Stage::Checksum);
+    }
+    BOOST_CHECK(flaccue::currentStageAccount().stage == flaccue::Stage::Checksum);
+    BOOST_CHECK(!flaccue::isInStage(flaccue::StageAccount { &metrics, flaccue::Stage::Decode }));
+    checksum.reset();
+    BOOST_CHECK(flaccue::currentStageAccount().metrics == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(JSONStringsAreEscaped) {
+    BOOST_CHECK_EQUAL(flaccue::jsonString("a\"b\\c\nd\x01"), "\"a\\\"b\\\\c\\nd\\u0001\"");
+}
+
+BOOST_AUTO_TEST_CASE(JSONStringsAreValidUTF8) {
+    // Valid sequences of every length are kept.
+    BOOST_CHECK_EQUAL(flaccue::jsonString("\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8E\xB5"), "\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8E\xB5\"");
+    // Latin-1, a stray continuation byte, an overlong slash, a surrogate and a truncated
+    // sequence at the end.
+    BOOST_CHECK_EQUAL(flaccue::jsonString("caf\xE9 \x80 \xC0\xAF \xED\xA0\x80 \xE2\x82"),
+                      "\"caf\\ufffd \\ufffd \\ufffd\\ufffd \\ufffd\\ufffd\\ufffd \\ufffd\\ufffd\"");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* MetricsTest_h */
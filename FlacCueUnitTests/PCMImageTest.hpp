@@ -0,0 +1,193 @@
+//
+//  PCMImageTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PCMImageTest_h
+#define PCMImageTest_h
+
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <unistd.h>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+struct PCMImageTestFixture : TemporaryDirectory {
+    PCMImageTestFixture() : TemporaryDirectory("FlacCuePCMImageTest") {}
+
+    static std::string littleEndian(uint32_t value, int bytes) {
+        std::string result;
+        for (auto i = 0; i < bytes; ++i) {
+            result += (char)((value >> (8 * i)) & 0xFF);
+        }
+        return result;
+    }
+
+    static std::string chunk(const std::string& id, const std::string& body) {
+        return id + littleEndian((uint32_t)body.size(), 4) + body + (body.size() % 2 ? std::string(1, '\0') : "");
+    }
+
+    static std::string formatChunk(uint16_t format, uint16_t channels, uint32_t sampleRate, uint16_t bitsPerSample, bool isExtensible) {
+        auto blockAlign = channels * ((bitsPerSample + 7) / 8);
+        auto body = littleEndian(isExtensible ? 0xFFFE : format, 2) + littleEndian(channels, 2) + littleEndian(sampleRate, 4) +
+            littleEndian(sampleRate * blockAlign, 4) + littleEndian(blockAlign, 2) + littleEndian(bitsPerSample, 2);
+        if (isExtensible) {
+            body += littleEndian(22, 2) + littleEndian(bitsPerSample, 2) + littleEndian(3, 4) +
+                littleEndian(format, 2) + std::string("\x00\x00\x00\x00\x10\x00\x80\x00\x00\xAA\x00\x38\x9B\x71", 14);
+        }
+        return chunk("fmt ", body);
+    }
+
+    static std::string wave(const std::string& chunks) {
+        return "RIFF" + littleEndian((uint32_t)(4 + chunks.size()), 4) + "WAVE" + chunks;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(PCMImageTest, PCMImageTestFixture)
+
+BOOST_AUTO_TEST_CASE(WaveData) {
+    auto path = write("wav", wave(formatChunk(1, 2, 44100, 16, false) + chunk("LIST", "odd") + chunk("data", "abcdefghij")));
+    flaccue::PCMImage image(path, flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK(image.isCDDA());
+    BOOST_CHECK(!image.isBigEndian());
+    BOOST_CHECK_EQUAL(image.numberOfSamples(), 2);
+    BOOST_CHECK_EQUAL(std::string((const char*)image.data(), 8), "abcdefgh");
+}
+
+BOOST_AUTO_TEST_CASE(StreamedAndEmptyWaveData) {
+    auto header = wave(formatChunk(1, 2, 44100, 16, false));
+    std::string audio("\x01\x00\x02\x00\x03\x00\x04\x00", 8);
+
+    flaccue::PCMImage unknownSize(write("unknown.wav", header + "data" + littleEndian(0xFFFFFFFF, 4) + audio), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK_EQUAL(unknownSize.numberOfSamples(), 2);
+    flaccue::PCMImage zeroSize(write("zero.wav", header + "data" + littleEndian(0, 4) + audio), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK_EQUAL(zeroSize.numberOfSamples(), 2);
+
+    // Followed by a chunk, a size of 0 means no audio at all.
+    flaccue::PCMImage empty(write("empty.wav", header + chunk("data", "") + chunk("LIST", "INFOtags")), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK_EQUAL(empty.numberOfSamples(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ExtensibleWaveData) {
+    auto path = write("wav", wave(formatChunk(1, 6, 48000, 24, true) + chunk("data", std::string(36, 'x'))));
+    flaccue::PCMImage image(path, flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK(!image.isCDDA());
+    BOOST_CHECK_EQUAL(image.channels(), 6);
+    BOOST_CHECK_EQUAL(image.sampleRate(), 48000);
+    BOOST_CHECK_EQUAL(image.bitsPerSample(), 24);
+    BOOST_CHECK_EQUAL(image.numberOfSamples(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(RawImages) {
+    auto path = write("bin", std::string(4 * 588 + 3, 'x'));
+    flaccue::PCMImage littleEndianImage(path, flaccue::PCMImage::kindForFileType("BINARY"));
+    BOOST_CHECK(littleEndianImage.isCDDA());
+    BOOST_CHECK(!littleEndianImage.isBigEndian());
+    BOOST_CHECK_EQUAL(littleEndianImage.numberOfSamples(), 588);
+
+    flaccue::PCMImage bigEndianImage(path, flaccue::PCMImage::kindForFileType("MOTOROLA"));
+    BOOST_CHECK(bigEndianImage.isBigEndian());
+    BOOST_CHECK_EQUAL(bigEndianImage.numberOfSamples(), 588);
+
+    BOOST_CHECK_THROW(flaccue::PCMImage::kindForFileType("AIFF"), flaccue::PCMImageError);
+}
+
+BOOST_AUTO_TEST_CASE(Errors) {
+    auto floatingPoint = write("float.wav", wave(formatChunk(3, 2, 44100, 32, true) + chunk("data", std::string(16, 'x'))));
+    BOOST_CHECK_THROW(flaccue::PCMImage(floatingPoint, flaccue::PCMImage::Kind::WAVE), flaccue::PCMImageError);
+
+    auto noData = write("nodata.wav", wave(formatChunk(1, 2, 44100, 16, false)));
+    BOOST_CHECK_THROW(flaccue::PCMImage(noData, flaccue::PCMImage::Kind::WAVE), flaccue::PCMImageError);
+
+    auto notWave = write("raw.wav", std::string(64, 'x'));
+    BOOST_CHECK_THROW(flaccue::PCMImage(notWave, flaccue::PCMImage::Kind::WAVE), flaccue::PCMImageError);
+}
+
+BOOST_AUTO_TEST_CASE(SplitIntoWaveFiles) {
+    std::string audio;
+    for (auto i = 0; i < 40000; ++i) {
+        audio += PCMImageTestFixture::littleEndian((uint32_t)i * 2654435761u, 4);
+    }
+    auto first = write("first.wav", wave(formatChunk(1, 2, 44100, 16, false) + chunk("data", audio.substr(0, 120000))));
+    auto second = write("second.bin", audio.substr(120000));
+    flaccue::PCMImage firstImage(first, flaccue::PCMImage::Kind::WAVE);
+    flaccue::PCMImage secondImage(second, flaccue::PCMImage::Kind::RawLittleEndianCDDA);
+
+    cue::Split split;
+    split.outputFiles.push_back(cue::SplitOutput { "1.wav", { cue::SplitInputSegment { "first", 10, cue::Time(25000) } } });
+    split.outputFiles.push_back(cue::SplitOutput { "2.wav", {
+        cue::SplitInputSegment { "first", 25000, std::nullopt },
+        cue::SplitInputSegment { "second", 0, cue::Time(100) },
+    } });
+    cue::PCMSplitWriter writer(split, [&](const std::string& inputFile) -> const flaccue::PCMImage& {
+        return inputFile == "first" ? firstImage : secondImage;
+    }, [&](const std::string& outputFile) {
+        return path(outputFile);
+    });
+    writer.writeAll();
+
+    flaccue::PCMImage output1(path("1.wav"), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK(output1.isCDDA());
+    BOOST_CHECK_EQUAL(output1.numberOfSamples(), 24990);
+    BOOST_CHECK(std::string((const char*)output1.data(), 4 * 24990) == audio.substr(40, 4 * 24990));
+
+    flaccue::PCMImage output2(path("2.wav"), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK_EQUAL(output2.numberOfSamples(), 5100);
+    BOOST_CHECK(std::string((const char*)output2.data(), 4 * 5100) == audio.substr(100000, 4 * 5100));
+
+    cue::Split tooLong;
+    tooLong.outputFiles.push_back(cue::SplitOutput { "3.wav", { cue::SplitInputSegment { "second", 0, cue::Time(20000) } } });
+    BOOST_CHECK_THROW(cue::PCMSplitWriter(tooLong, [&](const std::string&) -> const flaccue::PCMImage& {
+        return secondImage;
+    }, [&](const std::string& outputFile) {
+        return path(outputFile);
+    }).writeAll(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TruncatedWhileRead) {
+    // Boost.Test puts its own SIGBUS handler back after every test case, while ours is only
+    // installed once per process: everything faulting has to happen in this one.
+    struct SummingSink : public cue::SampleSink {
+        uint64_t sum = 0;
+
+        virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) override {}
+        virtual void processInterleaved(const uint8_t* data, const cue::StreamFormat& format, bool isBigEndian, uint32_t count) override {
+            sum = std::accumulate(data, data + count * 4, sum);
+        }
+    };
+
+    auto pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    auto path = write("bin", std::string(4 * pageSize, 'x'));
+    flaccue::PCMImage image(path, flaccue::PCMImage::Kind::RawLittleEndianCDDA);
+    BOOST_REQUIRE_EQUAL(truncate(path.c_str(), 0), 0);
+
+    // The last page is gone from the file: a plain read of the mapping would be a SIGBUS.
+    std::vector<uint8_t> samples(pageSize);
+    BOOST_CHECK_THROW(image.copySamples(image.numberOfSamples() - pageSize / 4, (uint32_t)(pageSize / 4), samples.data()), std::system_error);
+    // The handler stays in place for the next copy.
+    BOOST_CHECK_THROW(image.copySamples(0, 1, samples.data()), std::system_error);
+
+    auto borrowedPath = write("borrowed.bin", std::string(4 * pageSize, 'x'));
+    flaccue::PCMImage borrowedImage(borrowedPath, flaccue::PCMImage::Kind::RawLittleEndianCDDA);
+    cue::PCMSampleSource source(borrowedImage);
+    SummingSink sink;
+    BOOST_CHECK_EQUAL(cue::copySamples(source, sink, pageSize / 4), pageSize / 4);
+    BOOST_CHECK_EQUAL(sink.sum, pageSize * 'x');
+
+    // The sink reads the mapping itself, and gets to finish before the error is thrown: the
+    // pages the file lost read as zeros.
+    BOOST_REQUIRE_EQUAL(truncate(borrowedPath.c_str(), 2 * pageSize), 0);
+    BOOST_CHECK_THROW(cue::copySamples(source, sink, UINT64_MAX, (uint32_t)(3 * pageSize / 4)), std::system_error);
+    BOOST_CHECK_EQUAL(sink.sum, pageSize * 'x' * 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* PCMImageTest_h */
@@ -0,0 +1,74 @@
+//
+//  PipelineTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PipelineTest_h
+#define PipelineTest_h
+
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(PipelineTest)
+
+BOOST_AUTO_TEST_CASE(QueueIsBounded) {
+    flaccue::SPSCQueue<int> queue(2);
+    BOOST_CHECK(queue.tryPush(1));
+    BOOST_CHECK(queue.tryPush(2));
+    BOOST_CHECK(!queue.tryPush(3));
+
+    int value;
+    BOOST_CHECK(queue.tryPop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(queue.tryPush(3));
+    BOOST_CHECK_EQUAL(queue.pop(), 2);
+    BOOST_CHECK_EQUAL(queue.pop(), 3);
+    BOOST_CHECK(!queue.tryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(QueuePreservesOrderAcrossThreads) {
+    const int count = 100000;
+    flaccue::SPSCQueue<int> queue(16);
+    std::thread producer([&]() {
+        for (int i = 0; i < count; ++i) {
+            queue.push(i);
+        }
+    });
+
+    bool isInOrder = true;
+    for (int i = 0; i < count; ++i) {
+        isInOrder = isInOrder && queue.pop() == i;
+    }
+    producer.join();
+    BOOST_CHECK(isInOrder);
+}
+
+BOOST_AUTO_TEST_CASE(BlocksReturnAfterLastRelease) {
+    flaccue::SampleBlockPool pool(1, 4);
+    int32_t left[] = { 1, 2, 3 };
+    int32_t right[] = { -1, -2, -3 };
+    const int32_t* buffer[] = { left, right };
+
+    auto block = pool.acquire(2);
+    block->assign(buffer, 2, 3);
+    BOOST_CHECK_EQUAL(block->count(), 3);
+    BOOST_CHECK_EQUAL(block->channels()[1][2], -3);
+    BOOST_CHECK_THROW(block->assign(buffer, 2, 5), std::length_error);
+
+    std::thread consumer([&]() {
+        pool.release(block);
+        pool.release(block);
+    });
+    BOOST_CHECK_EQUAL(pool.acquire(1), block);
+    consumer.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* PipelineTest_h */
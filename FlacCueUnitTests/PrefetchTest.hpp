@@ -0,0 +1,79 @@
+//
+//  PrefetchTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PrefetchTest_h
+#define PrefetchTest_h
+
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(PrefetchTest)
+
+BOOST_AUTO_TEST_CASE(SplitInputFilesAreInReadOrder) {
+    cue::Split split;
+    split.outputFiles.push_back(cue::SplitOutput { "1.flac", { cue::SplitInputSegment { "b.flac", 0, cue::Time(100) } } });
+    split.outputFiles.push_back(cue::SplitOutput { "2.flac", {
+        cue::SplitInputSegment { "b.flac", 100, std::nullopt },
+        cue::SplitInputSegment { "a.flac", 0, cue::Time(50) },
+    } });
+    split.outputFiles.push_back(cue::SplitOutput { "3.flac", { cue::SplitInputSegment { "a.flac", 50, std::nullopt } } });
+
+    std::vector<std::string> expected = { "b.flac", "a.flac" };
+    auto files = cue::splitInputFiles(split);
+    BOOST_CHECK_EQUAL_COLLECTIONS(files.begin(), files.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(PrefetchStaysWithinBudget) {
+    TemporaryDirectory directory("FlacCuePrefetchTest");
+    std::vector<std::string> paths;
+    for (auto name : { "a", "b", "c" }) {
+        paths.push_back(directory.write(name, std::string(4096, 'x')));
+    }
+
+    flaccue::Prefetcher prefetcher(10240);
+    prefetcher.enqueue(paths);
+    prefetcher.enqueue(directory.path("missing"));
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 10240);
+
+    prefetcher.release(paths[0]);
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 8192);
+
+    prefetcher.release(paths[1]);
+    prefetcher.release(paths[2]);
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(SkippedAlbumReleasesItsBudget) {
+    TemporaryDirectory album("FlacCuePrefetchTest");
+    auto& directory = album.path();
+    std::vector<std::string> paths = { album.write("a.flac", std::string(4096, 'x')), album.write("b.flac", std::string(4096, 'x')) };
+
+    flaccue::Prefetcher prefetcher(4096);
+    {
+        // The album was guessed to be next, but is skipped without reading any of it.
+        flaccue::PrefetchRelease prefetched(prefetcher);
+        prefetched.addDirectory(directory);
+        prefetcher.enqueue(paths);
+        BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 4096);
+    }
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 0);
+
+    // Nothing left queued either, and files outside the directory are left alone.
+    prefetcher.enqueue(paths[0]);
+    prefetcher.releaseDirectory("/tmp");
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 4096);
+    prefetcher.releaseDirectory(directory);
+    BOOST_CHECK_EQUAL(prefetcher.outstandingBytes(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* PrefetchTest_h */
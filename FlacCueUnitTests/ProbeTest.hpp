@@ -0,0 +1,74 @@
+//
+//  ProbeTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef ProbeTest_h
+#define ProbeTest_h
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+struct ProbeTestFixture : TemporaryDirectory {
+    ProbeTestFixture() : TemporaryDirectory("FlacCueProbeTest") {}
+
+    static std::string streamHeader(uint64_t totalSamples) {
+        flaccue::StreamInfo streamInfo;
+        streamInfo.minimumBlocksize = streamInfo.maximumBlocksize = 4096;
+        streamInfo.sampleRate = 44100;
+        streamInfo.channels = 2;
+        streamInfo.bitsPerSample = 16;
+        streamInfo.totalSamples = totalSamples;
+        streamInfo.md5[15] = 0x5A;
+        std::string header;
+        flaccue::appendStreamHeader(streamInfo, {}, 4, header);
+        return header;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ProbeTest, ProbeTestFixture)
+
+BOOST_AUTO_TEST_CASE(StreamInfoRoundTrips) {
+    auto header = streamHeader(0x987654321ULL);
+    auto streamInfo = flaccue::parseStreamInfoHeader((const uint8_t*)header.data(), header.size());
+    BOOST_CHECK_EQUAL(streamInfo.minimumBlocksize, 4096);
+    BOOST_CHECK_EQUAL(streamInfo.maximumBlocksize, 4096);
+    BOOST_CHECK_EQUAL(streamInfo.sampleRate, 44100);
+    BOOST_CHECK_EQUAL(streamInfo.channels, 2);
+    BOOST_CHECK_EQUAL(streamInfo.bitsPerSample, 16);
+    BOOST_CHECK_EQUAL(streamInfo.totalSamples, 0x987654321ULL);
+    BOOST_CHECK_EQUAL(streamInfo.md5[15], 0x5A);
+
+    BOOST_CHECK_THROW(flaccue::parseStreamInfoHeader((const uint8_t*)header.data(), 41), flaccue::FrameError);
+    header[4] = 3;
+    BOOST_CHECK_THROW(flaccue::parseStreamInfoHeader((const uint8_t*)header.data(), header.size()), flaccue::FrameError);
+}
+
+BOOST_AUTO_TEST_CASE(ProbesFilesInParallel) {
+    std::string id3 = { 'I', 'D', '3', 4, 0, 0x10, 0, 0, 1, 2 }; // 130 bytes of tag, plus a footer
+    std::vector<std::string> probed = {
+        write("a.flac", streamHeader(588) + std::string(100000, 'p')),
+        write("b.flac", id3 + std::string(130 + 10, 't') + streamHeader(1176)),
+    };
+
+    flaccue::ThreadPool pool(2);
+    auto streamInfos = flaccue::probeStreamInfos(probed, pool);
+    BOOST_REQUIRE_EQUAL(streamInfos.size(), 2);
+    BOOST_CHECK_EQUAL(streamInfos[0].totalSamples, 588);
+    BOOST_CHECK_EQUAL(streamInfos[1].totalSamples, 1176);
+
+    probed.push_back(write("c.flac", "RIFF"));
+    BOOST_CHECK_THROW(flaccue::probeStreamInfos(probed, pool), flaccue::FrameError);
+    BOOST_CHECK_THROW(flaccue::probeStreamInfo(path("missing")), std::system_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* ProbeTest_h */
@@ -0,0 +1,78 @@
+//
+//  PrometheusTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef PrometheusTest_h
+#define PrometheusTest_h
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(PrometheusTest)
+
+BOOST_AUTO_TEST_CASE(WritesTheTextExpositionFormat) {
+    flaccue::PrometheusMetrics metrics;
+    metrics.declareCounter("albums_total", "Albums processed.");
+    metrics.declareGauge("queue_depth", "Albums waiting.");
+    metrics.declareHistogram("duration_seconds", "Wall time per album.", flaccue::exponentialBuckets(1, 2, 3));
+
+    metrics.increment("albums_total", 1, {{ "result", "failed \"badly\"" }});
+    metrics.increment("albums_total", 2, {{ "result", "succeeded" }});
+    metrics.increment("albums_total", 1, {{ "result", "succeeded" }});
+    metrics.set("queue_depth", 5);
+    metrics.add("queue_depth", -1);
+    for (auto seconds : { 0.5, 2.0, 3.0, 100.0 }) {
+        metrics.observe("duration_seconds", seconds);
+    }
+    BOOST_CHECK_THROW(metrics.increment("queue_depth"), flaccue::PrometheusError);
+    BOOST_CHECK_THROW(metrics.set("missing", 1), flaccue::PrometheusError);
+    BOOST_CHECK_THROW(metrics.declareGauge("queue_depth", ""), flaccue::PrometheusError);
+
+    std::ostringstream output;
+    metrics.write(output);
+    BOOST_CHECK_EQUAL(output.str(),
+        "# HELP albums_total Albums processed.\n"
+        "# TYPE albums_total counter\n"
+        "albums_total{result=\"failed \\\"badly\\\"\"} 1\n"
+        "albums_total{result=\"succeeded\"} 3\n"
+        "# HELP duration_seconds Wall time per album.\n"
+        "# TYPE duration_seconds histogram\n"
+        "duration_seconds_bucket{le=\"1\"} 1\n"
+        "duration_seconds_bucket{le=\"2\"} 2\n"
+        "duration_seconds_bucket{le=\"4\"} 3\n"
+        "duration_seconds_bucket{le=\"+Inf\"} 4\n"
+        "duration_seconds_sum 105.5\n"
+        "duration_seconds_count 4\n"
+        "# HELP queue_depth Albums waiting.\n"
+        "# TYPE queue_depth gauge\n"
+        "queue_depth 4\n");
+}
+
+BOOST_AUTO_TEST_CASE(TextfileIsReplacedAsAWhole) {
+    TemporaryDirectory directory("FlacCuePrometheusTest");
+    auto path = directory.path("flaccue.prom");
+
+    flaccue::PrometheusMetrics metrics;
+    metrics.declareGauge("up", "Whether the worker runs.");
+    {
+        flaccue::PrometheusTextfile textfile(path, metrics, std::chrono::hours(1));
+        std::ifstream written(path);
+        BOOST_CHECK_EQUAL(std::string(std::istreambuf_iterator<char>(written), {}), "# HELP up Whether the worker runs.\n# TYPE up gauge\n");
+        metrics.set("up", 1);
+    }
+    std::ifstream written(path);
+    std::string contents(std::istreambuf_iterator<char>(written), {});
+    BOOST_CHECK(contents.find("\nup 1\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* PrometheusTest_h */
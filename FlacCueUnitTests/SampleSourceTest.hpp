@@ -0,0 +1,122 @@
+//
+//  SampleSourceTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef SampleSourceTest_h
+#define SampleSourceTest_h
+
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+class CollectingSampleSink : public cue::SampleSink {
+public:
+    std::vector<int32_t> left, right;
+    size_t interleavedBlocks = 0;
+    size_t begins = 0, ends = 0;
+
+    virtual void begin(const cue::StreamFormat& format) override { ++begins; }
+    virtual void end() override { ++ends; }
+
+    virtual void process(const int32_t* const buffer[], unsigned channels, uint32_t count) override {
+        left.insert(left.end(), buffer[0], buffer[0] + count);
+        right.insert(right.end(), buffer[1], buffer[1] + count);
+    }
+
+    virtual void processInterleaved(const uint8_t* data, const cue::StreamFormat& format, bool isBigEndian, uint32_t count) override {
+        ++interleavedBlocks;
+        cue::SampleSink::processInterleaved(data, format, isBigEndian, count);
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(SampleSourceTest)
+
+BOOST_AUTO_TEST_CASE(Deinterleave) {
+    int32_t left[2], right[2];
+    int32_t* buffer[2] = { left, right };
+
+    const uint8_t sixteenBit[] = { 0x01, 0x00, 0xFF, 0xFF, 0x00, 0x80, 0xFF, 0x7F };
+    cue::deinterleave(sixteenBit, { 44100, 2, 16 }, false, 2, buffer);
+    BOOST_CHECK_EQUAL(left[0], 1);
+    BOOST_CHECK_EQUAL(right[0], -1);
+    BOOST_CHECK_EQUAL(left[1], -32768);
+    BOOST_CHECK_EQUAL(right[1], 32767);
+
+    const uint8_t bigEndian[] = { 0x00, 0x01, 0xFF, 0xFE };
+    cue::deinterleave(bigEndian, { 44100, 2, 16 }, true, 1, buffer);
+    BOOST_CHECK_EQUAL(left[0], 1);
+    BOOST_CHECK_EQUAL(right[0], -2);
+
+    const uint8_t twentyFourBit[] = { 0x00, 0x00, 0x80, 0x01, 0x02, 0x03 };
+    cue::deinterleave(twentyFourBit, { 96000, 2, 24 }, false, 1, buffer);
+    BOOST_CHECK_EQUAL(left[0], -8388608);
+    BOOST_CHECK_EQUAL(right[0], 0x030201);
+
+    const uint8_t eightBit[] = { 0x00, 0xFF };
+    cue::deinterleave(eightBit, { 8000, 2, 8 }, false, 1, buffer);
+    BOOST_CHECK_EQUAL(left[0], -128);
+    BOOST_CHECK_EQUAL(right[0], 127);
+}
+
+BOOST_AUTO_TEST_CASE(SplitThroughSourcesAndSinks) {
+    TemporaryDirectory directory("FlacCueSampleSourceTest");
+
+    std::string audio;
+    for (int16_t i = 0; i < 1000; ++i) {
+        for (int16_t sample : { i, (int16_t)-i }) {
+            audio += (char)(sample & 0xFF);
+            audio += (char)((sample >> 8) & 0xFF);
+        }
+    }
+    flaccue::PCMImage image(directory.write("image.bin", audio), flaccue::PCMImage::Kind::RawLittleEndianCDDA);
+    cue::PCMSampleSource source(image);
+
+    cue::Split split;
+    split.outputFiles.push_back(cue::SplitOutput { "1", { cue::SplitInputSegment { "image", 100, cue::Time(400) } } });
+    split.outputFiles.push_back(cue::SplitOutput { "2", {
+        cue::SplitInputSegment { "image", 900, std::nullopt },
+        cue::SplitInputSegment { "image", 0, cue::Time(50) },
+    } });
+    auto sources = [&](const std::string&) -> cue::SampleSource& { return source; };
+
+    CollectingSampleSink collector;
+    cue::copySplitOutput(split, 1, sources, collector, 64);
+    BOOST_CHECK_EQUAL(collector.begins, 1);
+    BOOST_CHECK_EQUAL(collector.ends, 1);
+    BOOST_CHECK_EQUAL(collector.interleavedBlocks, 3);
+    BOOST_REQUIRE_EQUAL(collector.left.size(), 150);
+    BOOST_CHECK_EQUAL(collector.left[0], 900);
+    BOOST_CHECK_EQUAL(collector.right[99], -999);
+    BOOST_CHECK_EQUAL(collector.left[100], 0);
+    BOOST_CHECK_EQUAL(collector.left[149], 49);
+
+    cue::PCMFileSampleSink wave(directory.path("1.wav"), true);
+    cue::copySplitOutput(split, 0, sources, wave);
+    flaccue::PCMImage output(directory.path("1.wav"), flaccue::PCMImage::Kind::WAVE);
+    BOOST_CHECK(output.isCDDA());
+    BOOST_CHECK_EQUAL(output.numberOfSamples(), 300);
+    BOOST_CHECK(std::string((const char*)output.data(), 1200) == audio.substr(400, 1200));
+
+    int32_t left[10], right[10];
+    int32_t* buffer[2] = { left, right };
+    cue::PCMSampleSource outputSource(output);
+    outputSource.seek(295);
+    BOOST_CHECK_EQUAL(outputSource.read(buffer, 10), 5);
+    BOOST_CHECK_EQUAL(left[4], 399);
+    BOOST_CHECK_EQUAL(right[4], -399);
+    BOOST_CHECK_EQUAL(outputSource.read(buffer, 10), 0);
+
+    cue::Split tooLong;
+    tooLong.outputFiles.push_back(cue::SplitOutput { "3", { cue::SplitInputSegment { "image", 900, cue::Time(1100) } } });
+    BOOST_CHECK_THROW(cue::copySplitOutput(tooLong, 0, sources, collector), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* SampleSourceTest_h */
@@ -10,11 +10,55 @@
 #define TestUtils_h
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/iterator/zip_iterator.hpp>
 
 #include "FlacCue.h"
 
+// A directory for the files of a test, removed with everything in it when destroyed, so
+// nothing is left behind by a test that fails halfway.
+class TemporaryDirectory {
+    std::string _path;
+
+    static int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+        remove(path);
+        return 0;
+    }
+
+public:
+    explicit TemporaryDirectory(const std::string& name = "FlacCueTest") {
+        auto pathTemplate = "/tmp/" + name + ".XXXXXX";
+        if (mkdtemp(&pathTemplate[0]) == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "Failed to create '" + pathTemplate + "'");
+        }
+        _path = pathTemplate;
+    }
+
+    ~TemporaryDirectory() {
+        nftw(_path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    const std::string& path() const { return _path; }
+    std::string path(const std::string& name) const { return _path + "/" + name; }
+
+    // Creates or replaces a file in the directory, and returns its path.
+    std::string write(const std::string& name, const std::string& contents) const {
+        auto filePath = path(name);
+        std::ofstream(filePath, std::ios::binary) << contents;
+        return filePath;
+    }
+};
+
 namespace std {
     std::ostream& operator<<(std::ostream& os, const std::nullopt_t& _) {
         return os << "std::nullopt";
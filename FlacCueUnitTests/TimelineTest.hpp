@@ -0,0 +1,123 @@
+//
+//  TimelineTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef TimelineTest_h
+#define TimelineTest_h
+
+#include <sstream>
+#include <unordered_map>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+struct TimelineTestFixture {
+    std::unordered_map<std::string, cue::Time> fileDurations;
+    std::unordered_map<std::string, int> fileDurationCalls;
+    cue::Timeline::FileDurationHandler fileDurationHandler;
+
+    TimelineTestFixture()
+    : fileDurations({
+        {"a.flac", cue::Time(3,0,0)},
+        {"b.flac", cue::Time(2,0,0)}
+    }) {
+        fileDurationHandler = [&](const std::string& fileName) {
+            ++fileDurationCalls[fileName];
+            return fileDurations.at(fileName);
+        };
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(TimelineTest, TimelineTestFixture)
+
+static const std::string timelineTestSheet =
+"FILE \"a.flac\" WAVE\n"
+"  TRACK 01 AUDIO\n"
+"    PREGAP 00:02:00\n"
+"    INDEX 01 00:00:00\n"
+"  TRACK 02 AUDIO\n"
+"    INDEX 00 01:00:00\n"
+"    INDEX 01 01:02:00\n"
+"FILE \"b.flac\" WAVE\n"
+"  TRACK 03 AUDIO\n"
+"    INDEX 01 00:00:00\n"
+"    INDEX 02 01:00:00\n";
+
+BOOST_AUTO_TEST_CASE(FileLayout) {
+    std::istringstream stream(timelineTestSheet);
+    cue::Disc disc(stream);
+    cue::Timeline timeline(disc, fileDurationHandler);
+
+    BOOST_CHECK_EQUAL(timeline.numberOfFiles(), 2);
+    BOOST_CHECK_EQUAL(timeline.fileBegin(1), cue::Time(3,0,0));
+    BOOST_CHECK_EQUAL(timeline.fileDuration(1), cue::Time(2,0,0));
+    BOOST_CHECK_EQUAL(timeline.duration(), cue::Time(5,0,0));
+    BOOST_CHECK_EQUAL(timeline.discTime(1, cue::Time(0,1,0)), cue::Time(3,1,0));
+    BOOST_CHECK_EQUAL(timeline.indexBegin(2, 1), cue::Time(4,0,0));
+    BOOST_CHECK_THROW(timeline.indexBegin(2, 2), std::out_of_range);
+    BOOST_CHECK_EQUAL(fileDurationCalls["a.flac"], 1);
+    BOOST_CHECK_EQUAL(fileDurationCalls["b.flac"], 1);
+}
+
+BOOST_AUTO_TEST_CASE(Locate) {
+    std::istringstream stream(timelineTestSheet);
+    cue::Disc disc(stream);
+    cue::Timeline timeline(disc, fileDurationHandler);
+
+    auto position = timeline.locate(cue::Time(1,1,0));
+    BOOST_CHECK_EQUAL(position.file, 0);
+    BOOST_CHECK_EQUAL(position.fileOffset, cue::Time(1,1,0));
+    BOOST_CHECK_EQUAL(position.track, 1);
+    BOOST_CHECK_EQUAL(position.index, 0);
+
+    position = timeline.locate(cue::Time(3,0,0));
+    BOOST_CHECK_EQUAL(position.file, 1);
+    BOOST_CHECK_EQUAL(position.fileOffset, cue::Time(0));
+    BOOST_CHECK_EQUAL(position.track, 2);
+    BOOST_CHECK_EQUAL(position.index, 0);
+
+    position = timeline.locate(cue::Time(5,0,0) - cue::Time(1));
+    BOOST_CHECK_EQUAL(position.file, 1);
+    BOOST_CHECK_EQUAL(position.fileOffset, cue::Time(2,0,0) - cue::Time(1));
+    BOOST_CHECK_EQUAL(position.track, 2);
+    BOOST_CHECK_EQUAL(position.index, 1);
+
+    BOOST_CHECK_THROW(timeline.locate(cue::Time(5,0,0)), std::out_of_range);
+    BOOST_CHECK_THROW(timeline.locate(cue::Time(-1)), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(TrackOffsets) {
+    std::istringstream stream(timelineTestSheet);
+    cue::Disc disc(stream);
+    cue::Timeline timeline(disc, fileDurationHandler);
+
+    std::vector<cue::Time> expected = {
+        cue::Time(0,2,0),
+        cue::Time(1,4,0),
+        cue::Time(3,2,0),
+        cue::Time(5,2,0)
+    };
+    auto trackOffsets = timeline.trackOffsets();
+    BOOST_CHECK_EQUAL_COLLECTIONS(trackOffsets.begin(), trackOffsets.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(RejectsIndexesGoingBackwards) {
+    std::istringstream stream(
+        "FILE \"a.flac\" WAVE\n"
+        "  TRACK 01 AUDIO\n"
+        "    INDEX 01 00:10:00\n"
+        "  TRACK 02 AUDIO\n"
+        "    INDEX 01 00:05:00\n");
+    cue::Disc disc(stream);
+    cue::Timeline timeline(disc, fileDurationHandler);
+    BOOST_CHECK_THROW(timeline.locate(cue::Time(0)), std::runtime_error);
+    BOOST_CHECK_EQUAL(timeline.trackOffsets().size(), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* TimelineTest_h */
@@ -0,0 +1,62 @@
+//
+//  TraceTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef TraceTest_h
+#define TraceTest_h
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(TraceTest)
+
+static size_t occurrences(const std::string& string, const std::string& pattern) {
+    size_t count = 0;
+    for (auto position = string.find(pattern); position != std::string::npos; position = string.find(pattern, position + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+BOOST_AUTO_TEST_CASE(RingBuffersKeepTheLatestEventsOfEachThread) {
+    {
+        flaccue::TraceScope ignored("ignored", "test");
+    }
+
+    flaccue::startTracing(4);
+    {
+        flaccue::TraceScope trace("album", "album", "/music/Some Album/disc.cue");
+    }
+    std::thread worker([]() {
+        for (int i = 0; i < 10; ++i) {
+            flaccue::TraceScope trace("frame", "decode");
+        }
+    });
+    worker.join();
+    flaccue::stopTracing();
+    {
+        flaccue::TraceScope ignored("ignored", "test");
+    }
+
+    std::ostringstream output;
+    flaccue::writeTrace(output);
+    auto json = output.str();
+    BOOST_CHECK_EQUAL(json.compare(0, 15, "{\"traceEvents\":"), 0);
+    BOOST_CHECK_EQUAL(occurrences(json, "\"name\":\"frame\""), 4);
+    BOOST_CHECK_EQUAL(occurrences(json, "\"name\":\"album\""), 1);
+    BOOST_CHECK_EQUAL(occurrences(json, "\"name\":\"ignored\""), 0);
+    BOOST_CHECK(json.find("\"detail\":\"/music/Some Album/disc.cue\"") != std::string::npos);
+    BOOST_CHECK(json.find("\"droppedEvents\":6") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* TraceTest_h */
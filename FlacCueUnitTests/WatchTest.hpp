@@ -0,0 +1,80 @@
+//
+//  WatchTest.hpp
+//  FlacCue
+//
+//  Created by Tamás Zahola on 18/10/26.
+//  Copyright © 2026 Tamás Zahola. All rights reserved.
+//
+
+#ifndef WatchTest_h
+#define WatchTest_h
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/test/unit_test.hpp>
+
+#include "TestUtils.hpp"
+
+BOOST_AUTO_TEST_SUITE(WatchTest)
+
+static void checkWatcherReportsSettledDirectories(bool forcePolling) {
+    TemporaryDirectory directory("FlacCueWatchTest");
+    auto& root = directory.path();
+    mkdir((root + "/old").c_str(), 0755);
+    std::ofstream(root + "/old/album.cue") << "FILE \"a.flac\" WAVE";
+    std::ofstream(root + "/old/notes.txt") << "ignored";
+
+    flaccue::DirectoryWatcher watcher({ root }, std::chrono::milliseconds(50), [](const std::string& path, bool isDirectory) {
+        return isDirectory || path.compare(path.size() - 4, 4, ".cue") == 0;
+    }, forcePolling);
+    auto settled = watcher.wait(std::chrono::seconds(2));
+    BOOST_REQUIRE_EQUAL(settled.size(), 1);
+    BOOST_CHECK_EQUAL(settled[0], root + "/old");
+
+    mkdir((root + "/new").c_str(), 0755);
+    usleep(100000);
+    std::ofstream(root + "/new/notes.txt") << "ignored";
+    BOOST_CHECK(watcher.wait(std::chrono::milliseconds(200)).empty());
+
+    std::ofstream(root + "/new/album.cue") << "FILE \"a.flac\" WAVE";
+    settled = watcher.wait(std::chrono::seconds(2));
+    BOOST_REQUIRE_EQUAL(settled.size(), 1);
+    BOOST_CHECK_EQUAL(settled[0], root + "/new");
+}
+
+BOOST_AUTO_TEST_CASE(WatcherReportsSettledDirectories) {
+    checkWatcherReportsSettledDirectories(false);
+    checkWatcherReportsSettledDirectories(true);
+}
+
+BOOST_AUTO_TEST_CASE(JobQueueKeepsPendingJobsInOrder) {
+    TemporaryDirectory directory("FlacCueJobQueueTest");
+    auto& root = directory.path();
+    {
+        flaccue::JobQueue queue(root + "/queue");
+        BOOST_CHECK(queue.push("/music/b.cue"));
+        usleep(10000);
+        BOOST_CHECK(queue.push("/music/a.cue"));
+        BOOST_CHECK(!queue.push("/music/b.cue"));
+    }
+
+    flaccue::JobQueue queue(root + "/queue");
+    std::vector<std::string> expected = { "/music/b.cue", "/music/a.cue" };
+    auto pending = queue.pending();
+    BOOST_CHECK_EQUAL_COLLECTIONS(pending.begin(), pending.end(), expected.begin(), expected.end());
+
+    queue.complete("/music/b.cue");
+    queue.complete("/music/b.cue");
+    pending = queue.pending();
+    BOOST_CHECK_EQUAL_COLLECTIONS(pending.begin(), pending.end(), expected.begin() + 1, expected.end());
+
+    queue.complete("/music/a.cue");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif /* WatchTest_h */
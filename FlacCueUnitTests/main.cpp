@@ -12,3 +12,19 @@
 #include "CueParseTest.hpp"
 #include "GapsAppendedSplitTest.hpp"
 #include "AccurateRipTest.hpp"
+#include "BatchParseTest.hpp"
+#include "CompactDiscTest.hpp"
+#include "DiscSnapshotTest.hpp"
+#include "TimelineTest.hpp"
+#include "PipelineTest.hpp"
+#include "FlacFrameTest.hpp"
+#include "ProbeTest.hpp"
+#include "PrefetchTest.hpp"
+#include "PCMImageTest.hpp"
+#include "SampleSourceTest.hpp"
+#include "ManifestTest.hpp"
+#include "WatchTest.hpp"
+#include "LeaseTest.hpp"
+#include "MetricsTest.hpp"
+#include "TraceTest.hpp"
+#include "PrometheusTest.hpp"